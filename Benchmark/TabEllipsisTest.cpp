@@ -0,0 +1,175 @@
+﻿// タイトルの省略 (TabEllipsis) のテスト。Windows API に依存しないので Linux でもそのまま動く。
+//
+//   g++ -std=c++14 -I. Benchmark/TabEllipsisTest.cpp TabEllipsis.cpp -o tab_ellipsis_test
+//   ./tab_ellipsis_test
+//
+// 幅は文字ごとに決めた作り物の送り幅で計る。失敗すると assert で止まる。
+
+#undef NDEBUG
+#include "TabEllipsis.h"
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define ELLIPSIS_WIDTH 5
+
+// 作り物の送り幅。結合文字にも幅を持たせ、切る位置が結合文字の前に来るようにする
+static int GetFakeAdvance(wchar_t c) {
+    if (c >= 0xDC00 && c <= 0xDFFF) {
+        return 0; // 下位サロゲートの幅は上位サロゲートに含める
+    }
+    if (c >= 0xD800 && c <= 0xDBFF) {
+        return 14;
+    }
+    if ((c >= 0x0300 && c <= 0x036F) || (c >= 0x064B && c <= 0x065F) ||
+        (c >= 0x093A && c <= 0x094F) || (c >= 0x0E31 && c <= 0x0E3A) || c == 0x200D) {
+        return 4;
+    }
+    return c < 0x80 ? 7 : 10;
+}
+
+static std::vector<int> MakePrefix(const std::wstring& text) {
+    std::vector<int> prefix(text.length() + 1, 0);
+    for (size_t i = 0; i < text.length(); ++i) {
+        prefix[i + 1] = prefix[i] + GetFakeAdvance(text[i]);
+    }
+    return prefix;
+}
+
+static std::wstring Fit(const std::wstring& text, int maxWidth, TabEllipsisMode mode, bool* isTruncated = nullptr) {
+    std::vector<int> prefix = MakePrefix(text);
+    std::wstring result;
+    bool truncated = FitTitleToWidth(text, prefix.data(), ELLIPSIS_WIDTH, maxWidth, mode, result);
+    if (isTruncated) {
+        *isTruncated = truncated;
+    }
+    return result;
+}
+
+static int MeasureFitted(const std::wstring& text) {
+    int width = 0;
+    for (wchar_t c : text) {
+        width += c == TAB_ELLIPSIS_CHAR ? ELLIPSIS_WIDTH : GetFakeAdvance(c);
+    }
+    return width;
+}
+
+static void TestNoTruncation() {
+    bool isTruncated = true;
+    assert(Fit(L"Hello", 35, TAB_ELLIPSIS_END, &isTruncated) == L"Hello");
+    assert(!isTruncated);
+    assert(Fit(L"", 0, TAB_ELLIPSIS_MIDDLE, &isTruncated) == L"");
+    assert(!isTruncated);
+}
+
+static void TestModes() {
+    // 1 文字 7、省略記号 5。45 に収めると残りは 40 で 5 文字分
+    std::wstring title = L"Hello World";
+    bool isTruncated = false;
+    assert(Fit(title, 45, TAB_ELLIPSIS_END, &isTruncated) == L"Hello\x2026");
+    assert(isTruncated);
+    assert(Fit(title, 45, TAB_ELLIPSIS_START) == L"\x2026World");
+    // 先頭に半分 (20 → 2 文字)、残りの 26 を末尾 (3 文字) に回す
+    assert(Fit(title, 45, TAB_ELLIPSIS_MIDDLE) == L"He\x2026rld");
+
+    // 省略記号しか入らない、または省略記号も入らない
+    assert(Fit(title, ELLIPSIS_WIDTH, TAB_ELLIPSIS_END) == L"\x2026");
+    assert(Fit(title, ELLIPSIS_WIDTH - 1, TAB_ELLIPSIS_END) == L"");
+    assert(Fit(title, ELLIPSIS_WIDTH - 1, TAB_ELLIPSIS_MIDDLE) == L"");
+}
+
+static void TestClusterBoundaries() {
+    assert(IsTitleClusterBoundary(L"ab", 1));
+    assert(IsTitleClusterBoundary(L"ab", 0));
+    assert(IsTitleClusterBoundary(L"ab", 2));
+    // ラテン文字の結合アクセント
+    assert(!IsTitleClusterBoundary(L"e\x0301", 1));
+    // アラビア文字の母音記号 (U+064B..U+065F)
+    std::wstring arabic = L"\x0628\x064E\x0628\x0650";
+    assert(!IsTitleClusterBoundary(arabic, 1));
+    assert(IsTitleClusterBoundary(arabic, 2));
+    assert(!IsTitleClusterBoundary(arabic, 3));
+    // デーヴァナーガリーのヴィラーマ (Mn) と母音記号 (Mc)
+    assert(!IsTitleClusterBoundary(L"\x0915\x094D\x0937", 1));
+    assert(!IsTitleClusterBoundary(L"\x0915\x093E", 1));
+    // タイ文字の上に付く母音記号
+    assert(!IsTitleClusterBoundary(L"\x0E01\x0E31", 1));
+    // BMP の外の結合文字 (U+1D167) はサロゲートペアで来る
+    std::wstring supplementary = L"a\xD834\xDD67" L"b";
+    assert(!IsTitleClusterBoundary(supplementary, 1));
+    assert(!IsTitleClusterBoundary(supplementary, 2));
+    assert(IsTitleClusterBoundary(supplementary, 3));
+    // サロゲートペア、ZWJ でつながった絵文字、肌の色の修飾子
+    std::wstring family = L"\xD83D\xDC68\x200D\xD83D\xDC69";
+    assert(!IsTitleClusterBoundary(family, 1));
+    assert(!IsTitleClusterBoundary(family, 2));
+    assert(!IsTitleClusterBoundary(family, 3));
+    assert(!IsTitleClusterBoundary(L"\xD83D\xDC4D\xD83C\xDFFD", 2));
+    assert(IsTitleClusterBoundary(L"\xD83D\xDC4D\xD83D\xDC4D", 2));
+}
+
+static void TestComplexScript() {
+    assert(!IsComplexScriptChar(L'a'));
+    assert(!IsComplexScriptChar(L'\x65E5')); // 日本語は整形しない (フォントリンクだけ)
+    assert(IsComplexScriptChar(L'\x0628'));
+    assert(IsComplexScriptChar(L'\x0915'));
+    assert(IsComplexScriptChar(L'\x0E01'));
+    assert(IsComplexScriptChar(L'\x200F'));
+}
+
+static void TestFitKeepsClusters() {
+    // 幅は 10, 14, 24, 28, 38, 42。残り 25 で切ると 3 文字目の母音記号の前に来るので 1 つ戻す
+    std::wstring arabic = L"\x0628\x064E\x0628\x064E\x0628\x064E";
+    assert(Fit(arabic, 30, TAB_ELLIPSIS_END) == arabic.substr(0, 2) + L"\x2026");
+    assert(Fit(arabic, 30, TAB_ELLIPSIS_START) == L"\x2026" + arabic.substr(4));
+}
+
+// 幅を 0 から全体まで変えて、すべてのモードで幅に収まり、クラスタの途中で切っていないことを確かめる
+static void TestFitSweep(const std::wstring& text) {
+    std::vector<int> prefix = MakePrefix(text);
+    static const TabEllipsisMode s_modes[] = { TAB_ELLIPSIS_END, TAB_ELLIPSIS_MIDDLE, TAB_ELLIPSIS_START };
+    for (TabEllipsisMode mode : s_modes) {
+        for (int maxWidth = 0; maxWidth <= prefix.back(); ++maxWidth) {
+            std::wstring result;
+            bool isTruncated = FitTitleToWidth(text, prefix.data(), ELLIPSIS_WIDTH, maxWidth, mode, result);
+            assert(MeasureFitted(result) <= maxWidth);
+            if (!isTruncated) {
+                assert(result == text);
+                continue;
+            }
+            if (result.empty()) {
+                continue;
+            }
+            size_t ellipsis = result.find(TAB_ELLIPSIS_CHAR);
+            assert(ellipsis != std::wstring::npos);
+            int headLength = (int)ellipsis;
+            int tailLength = (int)(result.length() - ellipsis - 1);
+            assert(result.compare(0, headLength, text, 0, headLength) == 0);
+            assert(result.compare(ellipsis + 1, tailLength, text, text.length() - tailLength, tailLength) == 0);
+            assert(IsTitleClusterBoundary(text, headLength));
+            assert(IsTitleClusterBoundary(text, (int)text.length() - tailLength));
+            if (mode == TAB_ELLIPSIS_END) {
+                assert(tailLength == 0);
+            }
+            if (mode == TAB_ELLIPSIS_START) {
+                assert(headLength == 0);
+            }
+        }
+    }
+}
+
+int main() {
+    TestNoTruncation();
+    TestModes();
+    TestClusterBoundaries();
+    TestComplexScript();
+    TestFitKeepsClusters();
+    TestFitSweep(L"C:\\Users\\name\\Documents\\report.txt");
+    TestFitSweep(L"\x0645\x064E\x0631\x0652\x062D\x064E\x0628\x064B\x0627 \x0628\x0650\x0643\x064F\x0645\x0652");
+    TestFitSweep(L"\x0928\x092E\x0938\x094D\x0924\x0947 \x0915\x094D\x0937\x093F\x0924\x093F");
+    TestFitSweep(L"\x0E2A\x0E27\x0E31\x0E2A\x0E14\x0E35 \x0E01\x0E34\x0E19");
+    TestFitSweep(L"Tab \xD83D\xDC68\x200D\xD83D\xDC69\x200D\xD83D\xDC67 \xD83D\xDC4D\xD83C\xDFFD a\xD834\xDD67\xD834\xDD67 e\x0301");
+    printf("TabEllipsisTest: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,364 @@
+﻿// タブのレイアウト・ヒットテスト・並べ替えのベンチマーク。
+// TabLayoutEngine は Windows API に依存しないので Linux でもそのまま動く。
+//
+//   g++ -std=c++14 -O2 -I. Benchmark/TabLayoutBenchmark.cpp TabLayoutEngine.cpp TabWidthTree.cpp TabMeasureCache.cpp TabAdornments.cpp TabEllipsis.cpp -o tab_bench
+//   ./tab_bench > bench.jsonl
+//
+// 結果は 1 行 1 件の JSON で標準出力に書く。
+//   {"op":"hit_test","tabs":10000,"ns_per_op":12.3,"allocs_per_op":0.00,"bytes_per_tab":96.0}
+// bytes_per_tab はそのタブ数のエンジンが確保しているヒープをタブ数で割ったもの。
+// タイトルの省略 (fit_title_*) は tabs の代わりにタイトルの文字数 chars を出す。
+// 状態表示 (adornment_frame) は 1 フレーム分の処理を 1 回とし、無効化した面積 px_per_frame を出す。
+
+#include "TabLayoutEngine.h"
+#include "TabEllipsis.h"
+#include "TabAdornments.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <vector>
+
+// 確保回数と確保中のバイト数を数えるために operator new を差し替える。
+// バイト数は malloc が実際に割り当てた大きさ (glibc の malloc_usable_size)
+static unsigned long long s_allocCount = 0;
+static long long s_liveBytes = 0;
+
+void* operator new(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    s_allocCount++;
+    s_liveBytes += (long long)malloc_usable_size(p);
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) {
+        return;
+    }
+    s_liveBytes -= (long long)malloc_usable_size(p);
+    free(p);
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+// 文字数に比例する決まった幅を返す計測器
+class FakeTextMeasurer : public ITabTextMeasurer {
+public:
+    int MeasureText(const std::wstring& text) override {
+        int width = 0;
+        for (size_t i = 0; i < text.length(); ++i) {
+            width += text[i] < 0x80 ? 7 : 14;
+        }
+        return width;
+    }
+};
+
+// 結果が再現するように固定の種を使う xorshift
+class Random {
+public:
+    explicit Random(unsigned int seed) : m_state(seed) {}
+    int Next(int range) {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return (int)(m_state % (unsigned int)range);
+    }
+
+private:
+    unsigned int m_state;
+};
+
+static unsigned long long NowNs() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#define CLIENT_WIDTH 1280
+// 1 つの測定で最低限回す操作数
+#define MIN_OPS 200000
+
+static FakeTextMeasurer s_measurer;
+static std::vector<std::wstring> s_titles;
+
+static void PrepareTitles(int count) {
+    s_titles.clear();
+    s_titles.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        s_titles.push_back(L"Document " + std::to_wstring(i + 1) + (i % 3 == 0 ? L" - Long Title" : L""));
+    }
+}
+
+static void SetupEngine(TabLayoutEngine& engine) {
+    engine.SetTextMeasurer(&s_measurer);
+    engine.SetDpi(96);
+    engine.SetClientWidth(CLIENT_WIDTH);
+}
+
+static void FillEngine(TabLayoutEngine& engine, int count) {
+    SetupEngine(engine);
+    engine.SetDeferMeasure(true);
+    for (int i = 0; i < count; ++i) {
+        engine.AddTab(s_titles[i]);
+    }
+    engine.SetDeferMeasure(false);
+}
+
+struct Measurement {
+    unsigned long long ns;
+    unsigned long long ops;
+    unsigned long long allocs;
+};
+
+static void Report(const char* op, int tabs, const Measurement& m, double bytesPerTab) {
+    double ops = m.ops ? (double)m.ops : 1.0;
+    printf("{\"op\":\"%s\",\"tabs\":%d,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"bytes_per_tab\":%.1f}\n",
+        op, tabs, (double)m.ns / ops, (double)m.allocs / ops, bytesPerTab);
+    fflush(stdout);
+}
+
+// 計測区間の開始・終了
+class Timer {
+public:
+    Timer() : m_start(NowNs()), m_allocs(s_allocCount) {}
+    void Stop(Measurement& m) {
+        m.ns += NowNs() - m_start;
+        m.allocs += s_allocCount - m_allocs;
+    }
+
+private:
+    unsigned long long m_start;
+    unsigned long long m_allocs;
+};
+
+// BeginUpdate / EndUpdate で囲んだ一括追加と同じ手順
+static Measurement BenchBulkAdd(int count) {
+    Measurement m = {};
+    while (m.ops < MIN_OPS) {
+        TabLayoutEngine engine;
+        SetupEngine(engine);
+        Timer timer;
+        engine.SetDeferMeasure(true);
+        for (int i = 0; i < count; ++i) {
+            engine.AddTab(s_titles[i]);
+        }
+        engine.SetDeferMeasure(false);
+        timer.Stop(m);
+        m.ops += count;
+    }
+    return m;
+}
+
+static Measurement BenchRename(TabLayoutEngine& engine, int count) {
+    Measurement m = {};
+    Random random(1);
+    std::wstring titles[2] = { L"Renamed", L"Renamed Tab With A Longer Title" };
+    Timer timer;
+    for (int i = 0; i < MIN_OPS; ++i) {
+        engine.RenameTab(random.Next(count), titles[i & 1]);
+    }
+    timer.Stop(m);
+    m.ops = MIN_OPS;
+    return m;
+}
+
+// CustomTabControl::SwitchTabOrder と同じく選択中のタブを ID で追いかける
+static Measurement BenchSwitchOrder(TabLayoutEngine& engine, int count) {
+    Measurement m = {};
+    Random random(2);
+    int selected = count / 2;
+    int ops = count >= 100000 ? 2000 : count >= 10000 ? 20000 : MIN_OPS;
+    Timer timer;
+    for (int i = 0; i < ops; ++i) {
+        int from = random.Next(count);
+        int to = random.Next(count);
+        unsigned long long selectedId = engine.GetTabId(selected);
+        engine.MoveTab(from, to);
+        selected = engine.FindTab(selectedId);
+    }
+    timer.Stop(m);
+    m.ops = ops;
+    return m;
+}
+
+// SetCurSel の中で行うスクロール位置の調整
+static Measurement BenchSetCurSel(TabLayoutEngine& engine, int count) {
+    Measurement m = {};
+    Random random(3);
+    Timer timer;
+    for (int i = 0; i < MIN_OPS; ++i) {
+        engine.EnsureVisible(random.Next(count));
+    }
+    timer.Stop(m);
+    m.ops = MIN_OPS;
+    return m;
+}
+
+// スクロール位置を変えながら端から端までマウスを動かす
+static Measurement BenchHitTest(TabLayoutEngine& engine) {
+    Measurement m = {};
+    int maxOffset = engine.GetMaxScrollOffset();
+    int y = engine.GetTabHeight() / 2;
+    int checksum = 0;
+    Timer timer;
+    while (m.ops < MIN_OPS) {
+        engine.SetScrollOffset(maxOffset ? (int)(m.ops * 7919 % (unsigned long long)(maxOffset + 1)) : 0);
+        for (int x = 0; x < CLIENT_WIDTH; ++x) {
+            bool isClose = false;
+            bool isScrollLeft = false;
+            bool isScrollRight = false;
+            checksum += engine.HitTest(x, y, false, &isClose, &isScrollLeft, &isScrollRight);
+        }
+        m.ops += CLIENT_WIDTH;
+    }
+    timer.Stop(m);
+    // 最適化でループが消えないように使っておく
+    if (checksum == 0x7fffffff) {
+        fprintf(stderr, "%d\n", checksum);
+    }
+    return m;
+}
+
+// 2 つのモニターの間でウィンドウを行き来させる。1 回目だけ空き時間に計測し、
+// 以降は DPI ごとの表から引くだけになる
+static Measurement BenchDpiSwitch(TabLayoutEngine& engine, int count) {
+    Measurement m = {};
+    int ops = count >= 100000 ? 20 : count >= 10000 ? 200 : 2000;
+    Timer timer;
+    for (int i = 0; i < ops; ++i) {
+        engine.SetDpi(i % 2 == 0 ? 168 : 96);
+        bool isChanged = false;
+        while (engine.MeasureIdle(256, &isChanged)) {
+        }
+    }
+    timer.Stop(m);
+    m.ops = ops;
+    return m;
+}
+
+static Measurement BenchRemoveFront(TabLayoutEngine& engine, int count) {
+    Measurement m = {};
+    int ops = count >= 100000 ? 1000 : count >= 10000 ? 5000 : count;
+    Timer timer;
+    for (int i = 0; i < ops; ++i) {
+        engine.RemoveTab(0);
+    }
+    timer.Stop(m);
+    m.ops = ops;
+    return m;
+}
+
+// すべてのタブで進捗が 1 フレームに何度も進み、4 つに 1 つはスピナーが回っている。
+// 1 フレーム分の変更の記録・まとめ・無効化する矩形の計算を測る (GDI の描画は含まない)
+static Measurement BenchAdornments(int count, double* pixelsPerFrame) {
+    TabLayoutEngine engine;
+    FillEngine(engine, count);
+    engine.SetMultiRow(true);
+    TabAdornments adornments;
+    std::vector<TabAdornments::Dirty> dirty;
+    const int updatesPerFrame = 8;
+    const int frames = 20000;
+    long long pixels = 0;
+    Measurement m = {};
+    Timer timer;
+    for (int frame = 0; frame < frames; ++frame) {
+        for (int u = 0; u < updatesPerFrame; ++u) {
+            for (int i = 0; i < count; ++i) {
+                TabAdornment adornment = { (frame * updatesPerFrame + u + i) % 101, i % 4 == 0, i % 7, i % 5 == 0 };
+                adornments.Set(engine.GetTabId(i), adornment);
+            }
+        }
+        adornments.CollectDirty(dirty);
+        for (size_t d = 0; d < dirty.size(); ++d) {
+            TabRect rc = engine.GetTabRect(engine.FindTab(dirty[d].key));
+            if (dirty[d].parts & TAB_ADORN_PROGRESS) {
+                pixels += (long long)(rc.right - rc.left) * engine.Scale(3);
+            }
+            if (dirty[d].parts & TAB_ADORN_STATUS) {
+                TabRect rcClose = engine.GetCloseButtonRect(rc);
+                pixels += (long long)(rcClose.right - rcClose.left) * (rcClose.bottom - rcClose.top);
+            }
+        }
+    }
+    timer.Stop(m);
+    m.ops = frames;
+    *pixelsPerFrame = (double)pixels / frames;
+    return m;
+}
+
+// 累積送り幅を計測済みのタイトルを、幅を変えながら省略する
+static Measurement BenchFitTitle(int length, TabEllipsisMode mode) {
+    std::wstring title;
+    std::vector<int> prefix(1, 0);
+    for (int i = 0; i < length; ++i) {
+        wchar_t c = (wchar_t)(i % 16 == 0 ? L'\\' : L'a' + i % 26);
+        title += c;
+        prefix.push_back(prefix.back() + s_measurer.MeasureText(std::wstring(1, c)));
+    }
+    std::wstring result;
+    result.reserve(title.length() + 1);
+    Measurement m = {};
+    Timer timer;
+    for (int i = 0; i < MIN_OPS; ++i) {
+        FitTitleToWidth(title, prefix.data(), 7, 40 + i % 200, mode, result);
+    }
+    timer.Stop(m);
+    m.ops = MIN_OPS;
+    return m;
+}
+
+int main() {
+    static const int s_tabCounts[] = { 10, 1000, 10000, 100000 };
+    PrepareTitles(100000);
+
+    for (size_t c = 0; c < sizeof(s_tabCounts) / sizeof(s_tabCounts[0]); ++c) {
+        int count = s_tabCounts[c];
+
+        long long liveBefore = s_liveBytes;
+        TabLayoutEngine engine;
+        FillEngine(engine, count);
+        double bytesPerTab = (double)(s_liveBytes - liveBefore) / count;
+
+        Report("bulk_add", count, BenchBulkAdd(count), bytesPerTab);
+        Report("rename", count, BenchRename(engine, count), bytesPerTab);
+        Report("switch_tab_order", count, BenchSwitchOrder(engine, count), bytesPerTab);
+        Report("set_cur_sel", count, BenchSetCurSel(engine, count), bytesPerTab);
+        Report("hit_test", count, BenchHitTest(engine), bytesPerTab);
+        Report("dpi_switch", count, BenchDpiSwitch(engine, count), bytesPerTab);
+        Report("remove_front", count, BenchRemoveFront(engine, count), bytesPerTab);
+    }
+
+    double pixelsPerFrame = 0.0;
+    Measurement adornment = BenchAdornments(100, &pixelsPerFrame);
+    printf("{\"op\":\"adornment_frame\",\"tabs\":100,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"px_per_frame\":%.1f}\n",
+        (double)adornment.ns / adornment.ops, (double)adornment.allocs / adornment.ops, pixelsPerFrame);
+
+    static const int s_titleLengths[] = { 16, 256, 4096 };
+    static const char* const s_fitNames[] = { "fit_title_end", "fit_title_middle", "fit_title_start" };
+    for (size_t l = 0; l < sizeof(s_titleLengths) / sizeof(s_titleLengths[0]); ++l) {
+        for (int mode = TAB_ELLIPSIS_END; mode <= TAB_ELLIPSIS_START; ++mode) {
+            Measurement m = BenchFitTitle(s_titleLengths[l], (TabEllipsisMode)mode);
+            printf("{\"op\":\"%s\",\"chars\":%d,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f}\n",
+                s_fitNames[mode], s_titleLengths[l], (double)m.ns / m.ops, (double)m.allocs / m.ops);
+        }
+    }
+    return 0;
+}
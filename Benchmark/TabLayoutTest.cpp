@@ -0,0 +1,295 @@
+﻿// タブのレイアウト (TabLayoutEngine) のテスト。Windows API に依存しないので Linux でもそのまま動く。
+//
+//   g++ -std=c++14 -I. Benchmark/TabLayoutTest.cpp TabLayoutEngine.cpp TabWidthTree.cpp TabMeasureCache.cpp -o tab_layout_test
+//   ./tab_layout_test
+//
+// ヒットテスト・ドロップ位置・スクロールの範囲・範囲にかかるタブを確かめる。失敗すると assert で止まる。
+
+#undef NDEBUG
+#include "TabLayoutEngine.h"
+#include <cassert>
+#include <cstdio>
+#include <cwchar>
+#include <string>
+#include <vector>
+
+// 1 文字 7 の固定幅 (TabLayoutBenchmark と同じ)
+class FakeTextMeasurer : public ITabTextMeasurer {
+public:
+    int MeasureText(const std::wstring& text) override {
+        return (int)text.length() * 7;
+    }
+};
+
+#define TAB_COUNT 20
+#define CLIENT_WIDTH 500
+
+// 96 DPI ではタブの高さと閉じるボタンの幅が 37、タブの幅は 6 文字 42 + 余白 16 + 37 = 95
+#define TAB_HEIGHT 37
+#define TAB_WIDTH 95
+
+static void SetUpTabs(TabLayoutEngine& engine, FakeTextMeasurer& measurer) {
+    engine.SetTextMeasurer(&measurer);
+    engine.SetDpi(96);
+    engine.SetClientWidth(CLIENT_WIDTH);
+    for (int i = 0; i < TAB_COUNT; ++i) {
+        wchar_t title[16];
+        swprintf(title, 16, L"Tab %02d", i);
+        engine.AddTab(title);
+    }
+}
+
+static void TestMetrics() {
+    FakeTextMeasurer measurer;
+    TabLayoutEngine engine;
+    SetUpTabs(engine, measurer);
+    assert(engine.GetTabHeight() == TAB_HEIGHT);
+    assert(engine.GetTabWidth(0) == TAB_WIDTH);
+    assert(engine.GetTotalWidth() == TAB_WIDTH * TAB_COUNT);
+    assert(engine.HasScrollButtons());
+    assert(engine.GetViewWidth() == CLIENT_WIDTH - engine.GetScrollButtonWidth() * 3);
+}
+
+static void TestHitTest() {
+    FakeTextMeasurer measurer;
+    TabLayoutEngine engine;
+    SetUpTabs(engine, measurer);
+    bool isClose = true;
+    bool isLeft = true;
+    bool isRight = true;
+
+    assert(engine.HitTest(0, 5, false, &isClose, &isLeft, &isRight) == 0);
+    assert(!isClose && !isLeft && !isRight);
+    assert(engine.HitTest(TAB_WIDTH - 1, 5, false, nullptr, nullptr, nullptr) == 0);
+    assert(engine.HitTest(TAB_WIDTH, 5, false, nullptr, nullptr, nullptr) == 1);
+    assert(engine.HitTest(-1, 5, false, nullptr, nullptr, nullptr) == -1);
+
+    // 閉じるボタンはタブの右端から高さと同じ幅
+    engine.HitTest(TAB_WIDTH - TAB_HEIGHT - 1, 5, false, &isClose, nullptr, nullptr);
+    assert(!isClose);
+    engine.HitTest(TAB_WIDTH - TAB_HEIGHT, 5, false, &isClose, nullptr, nullptr);
+    assert(isClose);
+
+    // スクロールボタンと一覧ボタン
+    TabRect rcLeft = engine.GetScrollLeftRect();
+    TabRect rcRight = engine.GetScrollRightRect();
+    TabRect rcOverflow = engine.GetOverflowButtonRect();
+    assert(engine.HitTest(rcLeft.left + 1, 5, false, &isClose, &isLeft, &isRight) == -1);
+    assert(isLeft && !isRight);
+    assert(engine.HitTest(rcRight.left + 1, 5, false, &isClose, &isLeft, &isRight) == -1);
+    assert(!isLeft && isRight);
+    assert(engine.HitTest(rcOverflow.left + 1, 5, false, &isClose, &isLeft, &isRight) == -1);
+    assert(!isLeft && !isRight);
+
+    // スクロールした分だけずれる
+    engine.SetScrollOffset(50);
+    assert(engine.HitTest(TAB_WIDTH - 50 - 1, 5, false, nullptr, nullptr, nullptr) == 0);
+    assert(engine.HitTest(TAB_WIDTH - 50, 5, false, nullptr, nullptr, nullptr) == 1);
+
+    // ドラッグ中は端の外でも先頭と末尾のタブになる
+    assert(engine.HitTest(-100, 5, true, nullptr, nullptr, nullptr) == 0);
+    engine.SetScrollOffset(engine.GetMaxScrollOffset());
+    int lastTabRight = engine.GetTabRect(TAB_COUNT - 1).right;
+    assert(engine.HitTest(lastTabRight - 1, 5, false, nullptr, nullptr, nullptr) == TAB_COUNT - 1);
+}
+
+static void TestDropIndex() {
+    FakeTextMeasurer measurer;
+    TabLayoutEngine engine;
+    SetUpTabs(engine, measurer);
+    engine.RemoveTabs(4, TAB_COUNT - 4);
+    assert(!engine.HasScrollButtons());
+
+    // タブの上ならそのタブ、右の余白ならホバーしていなくても末尾
+    assert(engine.GetDropIndex(TAB_WIDTH * 2 + 1, 5, 2, 0) == 2);
+    assert(engine.GetDropIndex(TAB_WIDTH * 4 + 20, 5, -1, 0) == 3);
+    assert(engine.GetDropIndex(-20, 5, -1, 2) == 0);
+
+    // スクロールボタンの上では動かさない (ドラッグ中のタブのまま)
+    FakeTextMeasurer measurer2;
+    TabLayoutEngine scrolled;
+    SetUpTabs(scrolled, measurer2);
+    assert(scrolled.GetDropIndex(scrolled.GetScrollLeftRect().left + 1, 5, 3, 7) == 7);
+}
+
+static void TestScrollClamp() {
+    FakeTextMeasurer measurer;
+    TabLayoutEngine engine;
+    SetUpTabs(engine, measurer);
+    int viewWidth = engine.GetViewWidth();
+    int maxOffset = TAB_WIDTH * TAB_COUNT - viewWidth;
+    assert(engine.GetMaxScrollOffset() == maxOffset);
+
+    engine.SetScrollOffset(-10);
+    assert(engine.GetScrollOffset() == 0);
+    engine.SetScrollOffset(1000000);
+    assert(engine.GetScrollOffset() == maxOffset);
+    engine.ScrollBy(-30);
+    assert(engine.GetScrollOffset() == maxOffset - 30);
+    engine.ScrollBy(1000);
+    assert(engine.GetScrollOffset() == maxOffset);
+
+    // EnsureVisible は見えていないときだけ、最小の量だけ動かす
+    engine.EnsureVisible(0);
+    assert(engine.GetScrollOffset() == 0);
+    engine.EnsureVisible(1);
+    assert(engine.GetScrollOffset() == 0);
+    engine.EnsureVisible(5);
+    assert(engine.GetScrollOffset() == TAB_WIDTH * 6 - viewWidth);
+    engine.EnsureVisible(TAB_COUNT - 1);
+    assert(engine.GetScrollOffset() == maxOffset);
+
+    // タブが減ったり表示領域が広がったりしたら範囲に収め直す
+    engine.RemoveTabs(10, TAB_COUNT - 10);
+    assert(engine.GetScrollOffset() == engine.GetMaxScrollOffset());
+    engine.SetClientWidth(TAB_WIDTH * 10);
+    assert(!engine.HasScrollButtons());
+    assert(engine.GetMaxScrollOffset() == 0);
+    assert(engine.GetScrollOffset() == 0);
+
+    // 複数行モードではスクロールしない
+    engine.SetClientWidth(CLIENT_WIDTH);
+    engine.SetMultiRow(true);
+    engine.SetScrollOffset(100);
+    assert(engine.GetScrollOffset() == 0);
+}
+
+static void TestTabsInRange() {
+    FakeTextMeasurer measurer;
+    TabLayoutEngine engine;
+    SetUpTabs(engine, measurer);
+    int first = 0;
+    int last = -1;
+
+    engine.GetTabsInRange(0, TAB_WIDTH, &first, &last);
+    assert(first == 0 && last == 0);
+    engine.GetTabsInRange(0, TAB_WIDTH + 1, &first, &last);
+    assert(first == 0 && last == 1);
+    engine.GetTabsInRange(TAB_WIDTH, TAB_WIDTH * 2, &first, &last);
+    assert(first == 1 && last == 1);
+    engine.GetTabsInRange(-50, 10, &first, &last);
+    assert(first == 0 && last == 0);
+    engine.GetTabsInRange(TAB_WIDTH * 18 + 5, 1000000, &first, &last);
+    assert(first == 18 && last == TAB_COUNT - 1);
+
+    // 空の範囲
+    engine.GetTabsInRange(TAB_WIDTH * TAB_COUNT, TAB_WIDTH * TAB_COUNT + 100, &first, &last);
+    assert(first > last);
+    engine.GetTabsInRange(50, 50, &first, &last);
+    assert(first > last);
+    engine.GetTabsInRange(-100, 0, &first, &last);
+    assert(first > last);
+
+    // 座标はスクロール後のもの
+    engine.SetScrollOffset(TAB_WIDTH);
+    engine.GetTabsInRange(0, TAB_WIDTH, &first, &last);
+    assert(first == 1 && last == 1);
+    engine.GetVisibleRange(&first, &last);
+    assert(first == 1 && last == (TAB_WIDTH + engine.GetViewWidth() - 1) / TAB_WIDTH);
+
+    TabLayoutEngine empty;
+    empty.SetClientWidth(CLIENT_WIDTH);
+    empty.GetTabsInRange(0, CLIENT_WIDTH, &first, &last);
+    assert(first > last);
+}
+
+static void TestMultiRow() {
+    FakeTextMeasurer measurer;
+    TabLayoutEngine engine;
+    SetUpTabs(engine, measurer);
+    engine.SetMultiRow(true);
+    // 1 行に 5 つ (475) ずつ、4 行
+    int perRow = CLIENT_WIDTH / TAB_WIDTH;
+    assert(engine.GetRowCount() == (TAB_COUNT + perRow - 1) / perRow);
+    assert(engine.GetRequiredHeight() == engine.GetRowCount() * TAB_HEIGHT);
+    assert(engine.HitTest(10, TAB_HEIGHT + 5, false, nullptr, nullptr, nullptr) == perRow);
+    assert(engine.HitTest(TAB_WIDTH + 10, TAB_HEIGHT * 2 + 5, false, nullptr, nullptr, nullptr) == perRow * 2 + 1);
+    // 行の右の余白と、最後の行より下
+    assert(engine.HitTest(CLIENT_WIDTH - 5, 5, false, nullptr, nullptr, nullptr) == -1);
+    assert(engine.HitTest(10, TAB_HEIGHT * 10, false, nullptr, nullptr, nullptr) == -1);
+    // ドラッグ中は行と行内の位置を端に寄せる
+    assert(engine.HitTest(CLIENT_WIDTH - 5, 5, true, nullptr, nullptr, nullptr) == perRow - 1);
+    assert(engine.HitTest(10, TAB_HEIGHT * 10, true, nullptr, nullptr, nullptr) == perRow * 3);
+    assert(engine.GetDropIndex(10, TAB_HEIGHT * 10, -1, 2) == perRow * 3);
+}
+
+// GetTabTitle を呼んだ回数を数える
+class CountingDataSource : public ITabDataSource {
+public:
+    CountingDataSource() : m_fetches(0) {}
+    void GetTabTitle(int index, std::wstring& title) override {
+        m_fetches++;
+        wchar_t buffer[16];
+        swprintf(buffer, 16, L"Tab %02d", index % 100);
+        title = buffer;
+    }
+    int m_fetches;
+};
+
+static void TestVirtualDpiSwitch() {
+    FakeTextMeasurer measurer;
+    CountingDataSource source;
+    TabLayoutEngine engine;
+    engine.SetTextMeasurer(&measurer);
+    engine.SetDpi(96);
+    engine.SetClientWidth(CLIENT_WIDTH);
+    engine.SetDataSource(&source, 1000);
+    bool isChanged = false;
+    while (engine.MeasureIdle(64, &isChanged)) {
+    }
+    assert(engine.GetTabWidth(0) == TAB_WIDTH);
+
+    // DPI が変わってもタイトルは問い合わせず、概算にしておく
+    source.m_fetches = 0;
+    engine.SetDpi(192);
+    assert(source.m_fetches == 0);
+    assert(engine.HasIdleMeasure());
+    assert(engine.GetTabWidth(0) > TAB_WIDTH);
+
+    // 計測し直すときは計測するタブ (表示範囲と 64 個) の分だけ
+    engine.MeasureIdle(64, &isChanged);
+    int first = 0;
+    int last = -1;
+    engine.GetVisibleRange(&first, &last);
+    assert(source.m_fetches > 0 && source.m_fetches <= 64 + (last - first + 1));
+}
+
+// 既定の上限は全タブの 2 つの DPI 分に足りるよう、タブ数から決まる
+static void TestMeasureCacheBudget() {
+    FakeTextMeasurer measurer;
+    TabLayoutEngine engine;
+    engine.SetTextMeasurer(&measurer);
+    engine.SetDpi(96);
+    engine.SetClientWidth(CLIENT_WIDTH);
+    // 固定の 2 MB では 2 つの DPI 分に足りない数
+    std::vector<std::wstring> titles(40000);
+    for (size_t i = 0; i < titles.size(); ++i) {
+        titles[i] = L"Document " + std::to_wstring(i);
+    }
+    engine.InsertTabs(0, titles);
+    bool isChanged = false;
+    engine.SetDpi(144);
+    while (engine.MeasureIdle(1024, &isChanged)) {
+    }
+    unsigned long long misses = engine.GetWidthCacheMisses();
+    engine.SetDpi(96);
+    while (engine.MeasureIdle(1024, &isChanged)) {
+    }
+    engine.SetDpi(144);
+    while (engine.MeasureIdle(1024, &isChanged)) {
+    }
+    assert(engine.GetWidthCacheMisses() == misses);
+}
+
+int main() {
+    TestMetrics();
+    TestHitTest();
+    TestDropIndex();
+    TestScrollClamp();
+    TestTabsInRange();
+    TestMultiRow();
+    TestVirtualDpiSwitch();
+    TestMeasureCacheBudget();
+    printf("TabLayoutTest: all tests passed\n");
+    return 0;
+}
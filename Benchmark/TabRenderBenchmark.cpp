@@ -0,0 +1,264 @@
+﻿// ソフトウェア描画 (TabRaster / TabSoftwareRenderer) のベンチマーク。
+// Windows API に依存しないので Linux でもそのまま動く。
+//
+//   g++ -std=c++14 -O2 -I. Benchmark/TabRenderBenchmark.cpp TabRaster.cpp TabSoftwareRenderer.cpp TabLayoutEngine.cpp TabWidthTree.cpp TabMeasureCache.cpp TabAnimator.cpp TabAdornments.cpp TabEllipsis.cpp -o tab_render_bench
+//   ./tab_render_bench > render.jsonl
+//
+// -mavx2 で AVX2、-DTAB_RASTER_NO_SIMD でスカラー版になる。どれで作っても描く画素は
+// 同じなので、フレームの checksum (FNV-1a) を下の正解の値と比べて画素単位で確かめる。
+// 1 つでも違えば "match":false を出し、終了コード 1 で終わる。
+// 描画を意図して変えたときは、スカラー版で出した値で正解を書き換える。
+// 結果は 1 行 1 件の JSON で標準出力に書く。
+//   {"op":"render_frame","simd":"sse2","tabs":100,"ns_per_op":41000.0,"ns_per_px":0.86,"checksum":"82a230b510cb78ab","match":true}
+// スパンと図形 (fill_span など) は 1 回の操作で塗ったピクセル数 px を出す。
+
+#include "TabRaster.h"
+#include "TabSoftwareRenderer.h"
+#include "TabLayoutEngine.h"
+#include "TabAnimator.h"
+#include "TabAdornments.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 文字数に比例する決まった幅を返す計測器 (TabLayoutBenchmark と同じ幅)
+class FakeTextMeasurer : public ITabTextMeasurer {
+public:
+    int MeasureText(const std::wstring& text) override {
+        int width = 0;
+        for (size_t i = 0; i < text.length(); ++i) {
+            width += text[i] < 0x80 ? 7 : 14;
+        }
+        return width;
+    }
+};
+
+// 文字コードから決まる模様のグリフ。送り幅は FakeTextMeasurer と同じ
+class FakeGlyphSource : public ITabGlyphSource {
+public:
+    const TabGlyph* GetGlyph(wchar_t c) override {
+        auto it = m_glyphs.find(c);
+        if (it != m_glyphs.end()) {
+            return &it->second;
+        }
+        TabGlyph& glyph = m_glyphs[c];
+        glyph.advance = c < 0x80 ? 7 : 14;
+        glyph.left = 1;
+        glyph.top = 9;
+        glyph.width = c == L' ' ? 0 : glyph.advance - 2;
+        glyph.height = c == L' ' ? 0 : 9;
+        glyph.coverage.resize((size_t)glyph.width * glyph.height);
+        for (int y = 0; y < glyph.height; ++y) {
+            for (int x = 0; x < glyph.width; ++x) {
+                glyph.coverage[(size_t)y * glyph.width + x] = (uint8_t)((x * 67 + y * 29 + c * 13) & 0xff);
+            }
+        }
+        return &glyph;
+    }
+    int GetAscent() override {
+        return 12;
+    }
+    int GetLineHeight() override {
+        return 16;
+    }
+
+private:
+    std::unordered_map<wchar_t, TabGlyph> m_glyphs;
+};
+
+static unsigned long long NowNs() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#define CLIENT_WIDTH 1280
+// 1 つの測定で最低限塗るピクセル数
+#define MIN_PIXELS 200000000ULL
+
+static unsigned long long Checksum(const TabRaster& raster) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int y = 0; y < raster.GetHeight(); ++y) {
+        const uint32_t* row = raster.GetPixels() + (size_t)y * raster.GetStride();
+        for (int x = 0; x < raster.GetWidth(); ++x) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                hash = (hash ^ ((row[x] >> shift) & 0xff)) * 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
+
+// 正解の checksum。SIMD の種類によらず同じ値になる
+static const unsigned long long s_renderFrameGolden[] = {
+    0x11f524c094620eb0ULL, // 10 タブ
+    0x82a230b510cb78abULL, // 100 タブ
+    0x1e00d22201690a12ULL, // 1000 タブ
+};
+
+static int s_mismatchCount = 0;
+
+static const char* CheckGolden(unsigned long long checksum, unsigned long long golden) {
+    if (checksum != golden) {
+        s_mismatchCount++;
+        return "false";
+    }
+    return "true";
+}
+
+static void Report(const char* op, int tabs, unsigned long long ns, unsigned long long ops, unsigned long long pixels, unsigned long long checksum, unsigned long long golden) {
+    printf("{\"op\":\"%s\",\"simd\":\"%s\",\"tabs\":%d,\"ns_per_op\":%.1f,\"ns_per_px\":%.3f,\"checksum\":\"%016llx\",\"match\":%s}\n",
+        op, TabGetRasterSimdName(), tabs, (double)ns / ops, (double)ns / pixels, checksum, CheckGolden(checksum, golden));
+    fflush(stdout);
+}
+
+static void ReportPrimitive(const char* op, int px, unsigned long long ns, unsigned long long ops, unsigned long long checksum, unsigned long long golden) {
+    printf("{\"op\":\"%s\",\"simd\":\"%s\",\"px\":%d,\"ns_per_op\":%.1f,\"ns_per_px\":%.3f,\"checksum\":\"%016llx\",\"match\":%s}\n",
+        op, TabGetRasterSimdName(), px, (double)ns / ops, (double)ns / ((double)ops * px), checksum, CheckGolden(checksum, golden));
+    fflush(stdout);
+}
+
+static TabRenderPalette MakePalette() {
+    TabRenderPalette palette = {
+        TabRasterColor(32, 32, 32), TabRasterColor(220, 220, 220), TabRasterColor(50, 50, 50), TabRasterColor(70, 70, 70),
+        TabRasterColor(60, 60, 60), TabRasterColor(150, 150, 150), TabRasterColor(200, 0, 0),
+        TabRasterColor(80, 80, 80), TabRasterColor(0, 120, 215)
+    };
+    return palette;
+}
+
+// 表示中のタブをすべて描き直す 1 フレーム。ホバーのフェードと状態表示も含める
+static void BenchRenderFrame(int count, unsigned long long golden) {
+    FakeTextMeasurer measurer;
+    FakeGlyphSource glyphs;
+    TabLayoutEngine engine;
+    engine.SetTextMeasurer(&measurer);
+    engine.SetDpi(96);
+    engine.SetClientWidth(CLIENT_WIDTH);
+    engine.SetDeferMeasure(true);
+    for (int i = 0; i < count; ++i) {
+        engine.AddTab(L"Document " + std::to_wstring(i + 1) + (i % 3 == 0 ? L" - Long Title That Gets Cut Off" : L""));
+    }
+    engine.SetDeferMeasure(false);
+    engine.SetScrollOffset(engine.GetMaxScrollOffset() / 2);
+
+    int first = 0;
+    int last = -1;
+    engine.GetVisibleRange(&first, &last);
+    TabAnimator animator;
+    animator.SetHover(first + 1, true, 0.0);
+    animator.Tick(60.0, engine.GetScrollOffset(), engine.GetMaxScrollOffset());
+    TabAdornments adornments;
+    TabAdornment busy = { 40, true, 0, false };
+    TabAdornment unread = { -1, false, 7, false };
+    TabAdornment modified = { -1, false, 0, true };
+    adornments.Set(engine.GetTabKey(first + 2), busy);
+    adornments.Set(engine.GetTabKey(first + 3), unread);
+    adornments.Set(engine.GetTabKey(first + 4), modified);
+
+    TabSoftwareRenderer renderer;
+    renderer.SetPalette(MakePalette());
+    renderer.SetGlyphSource(&glyphs);
+    TabRenderState state = {};
+    state.selectedTab = first;
+    state.hoveredCloseButtonTab = -1;
+    state.pressedCloseButtonTab = -1;
+    state.animator = &animator;
+    state.adornments = &adornments;
+    state.spinnerHead = 3;
+
+    TabRaster raster;
+    raster.Resize(CLIENT_WIDTH, engine.GetTabHeight());
+    unsigned long long framePixels = (unsigned long long)raster.GetWidth() * raster.GetHeight();
+    unsigned long long frames = MIN_PIXELS / framePixels / 4 + 1;
+    unsigned long long start = NowNs();
+    for (unsigned long long i = 0; i < frames; ++i) {
+        raster.SetClip(0, 0, raster.GetWidth(), raster.GetHeight());
+        renderer.Render(raster, engine, state);
+    }
+    unsigned long long ns = NowNs() - start;
+    Report("render_frame", count, ns, frames, frames * framePixels, Checksum(raster), golden);
+}
+
+enum Primitive {
+    PRIMITIVE_FILL_SPAN,
+    PRIMITIVE_BLEND_SPAN,
+    PRIMITIVE_BLEND_SPAN_MASK,
+    PRIMITIVE_ROUNDED_TAB,
+    PRIMITIVE_CROSS,
+    PRIMITIVE_TRIANGLE,
+    PRIMITIVE_GLYPH_BLIT,
+    PRIMITIVE_COUNT
+};
+
+static const char* const s_primitiveNames[PRIMITIVE_COUNT] = {
+    "fill_span", "blend_span", "blend_span_mask", "rounded_tab", "cross", "triangle", "glyph_blit"
+};
+
+static const unsigned long long s_primitiveGolden[PRIMITIVE_COUNT] = {
+    0xe5181a58b214a325ULL, 0x9974d14a14d88b25ULL, 0xa3f9f03803537d69ULL, 0xf093a53a93958b4dULL,
+    0x2501080e6d830c73ULL, 0x2cc1928c0a9832f4ULL, 0x70761c4e641d22a5ULL
+};
+
+// 1 回分を描く。戻り値は塗った範囲のピクセル数
+static int DrawPrimitive(TabRaster& raster, Primitive primitive, const std::vector<uint8_t>& mask, int i) {
+    uint32_t translucent = TabRasterColor(200, 100, 50, 128);
+    switch (primitive) {
+    case PRIMITIVE_FILL_SPAN:
+        TabFillSpan(raster.GetPixels(), raster.GetWidth(), TabRasterColor(i & 0xff, 40, 40));
+        return raster.GetWidth();
+    case PRIMITIVE_BLEND_SPAN:
+        TabBlendSpan(raster.GetPixels(), raster.GetWidth(), translucent);
+        return raster.GetWidth();
+    case PRIMITIVE_BLEND_SPAN_MASK:
+        TabBlendSpanMask(raster.GetPixels(), raster.GetWidth(), translucent, mask.data());
+        return raster.GetWidth();
+    case PRIMITIVE_ROUNDED_TAB:
+        raster.FillRoundedTab(10, 0, 210, 37, 8, TabRasterColor(50, 50, 50));
+        return 200 * 37;
+    case PRIMITIVE_CROSS:
+        raster.FillCross(20.5, 8.5, 40.5, 28.5, 1.0, TabRasterColor(150, 150, 150));
+        return 24 * 24;
+    case PRIMITIVE_TRIANGLE:
+        raster.FillTriangle(10.5, 15.5, 15.5, 10.5, 15.5, 20.5, TabRasterColor(220, 220, 220));
+        return 6 * 11;
+    default:
+        raster.BlitMask(i % 64, 4, mask.data(), 64, 16, 64, TabRasterColor(220, 220, 220));
+        return 64 * 16;
+    }
+}
+
+static void BenchPrimitive(Primitive primitive) {
+    TabRaster raster;
+    raster.Resize(CLIENT_WIDTH, 37);
+    raster.FillRect(0, 0, raster.GetWidth(), raster.GetHeight(), TabRasterColor(32, 32, 32));
+    std::vector<uint8_t> mask(CLIENT_WIDTH);
+    for (size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = (uint8_t)((i * 37) & 0xff);
+    }
+    int px = DrawPrimitive(raster, primitive, mask, 0);
+    unsigned long long ops = MIN_PIXELS / px / 8 + 1;
+    unsigned long long start = NowNs();
+    for (unsigned long long i = 1; i <= ops; ++i) {
+        DrawPrimitive(raster, primitive, mask, (int)i);
+    }
+    unsigned long long ns = NowNs() - start;
+    ReportPrimitive(s_primitiveNames[primitive], px, ns, ops, Checksum(raster), s_primitiveGolden[primitive]);
+}
+
+int main() {
+    static const int s_tabCounts[] = { 10, 100, 1000 };
+    for (size_t c = 0; c < sizeof(s_tabCounts) / sizeof(s_tabCounts[0]); ++c) {
+        BenchRenderFrame(s_tabCounts[c], s_renderFrameGolden[c]);
+    }
+
+    for (int p = 0; p < PRIMITIVE_COUNT; ++p) {
+        BenchPrimitive((Primitive)p);
+    }
+    if (s_mismatchCount > 0) {
+        fprintf(stderr, "%d checksum(s) differ from the golden values\n", s_mismatchCount);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+﻿// 複数のスレッドでコントロールを作っては壊すストレステスト。
+// ウィンドウクラスの登録 (call_once) と TabResourcePool の参照カウントを同時に叩き、
+// 終わった後にプールが空で、GDI オブジェクトが増えていないことを確かめる。
+//
+//   cl /EHsc /O2 /I. Benchmark\TabStressTest.cpp CustomTabControl.cpp CUtil.cpp Tab*.cpp user32.lib gdi32.lib comctl32.lib dwmapi.lib uxtheme.lib
+//   TabStressTest.exe [スレッド数] [1 スレッドあたりの回数]
+//
+// 結果は 1 行 1 件の JSON で標準出力に書き、失敗があれば 1 を返す。
+//   {"op":"create_destroy","threads":8,"iterations":200,"ms":1234.5,"pool_entries":0,"gdi_leaked":0,"failures":0}
+
+#include <Windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CustomTabControl.h"
+#include "TabResourcePool.h"
+
+#pragma comment(lib, "comctl32.lib")
+#pragma comment(lib, "dwmapi.lib")
+#pragma comment(lib, "uxtheme.lib")
+
+static std::atomic<int> s_failures(0);
+
+static void PumpMessages() {
+    MSG msg;
+    while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE)) {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+}
+
+// 1 回分: 親ウィンドウとコントロールを作り、描いてテーマを切り替え、壊す
+static void CreateAndDestroy(int thread, int iteration) {
+    HWND hParent = CreateWindowExW(0, L"STATIC", L"", WS_OVERLAPPEDWINDOW,
+        0, 0, 640, 120, NULL, NULL, GetModuleHandle(NULL), NULL);
+    if (!hParent) {
+        s_failures++;
+        return;
+    }
+    CustomTabControl* tabControl = new CustomTabControl();
+    // スレッドごとにテーマを変えて、同じ組と違う組の Acquire を混ぜる
+    bool isDarkMode = ((thread + iteration) & 1) != 0;
+    if (!tabControl->Create(hParent, 0, 0, 640, 40, 1, isDarkMode)) {
+        s_failures++;
+    }
+    else {
+        for (int i = 0; i < 20; ++i) {
+            tabControl->AddTab(L"Thread " + std::to_wstring(thread) + L" Tab " + std::to_wstring(i));
+        }
+        tabControl->PostAddTab(L"Posted");
+        RedrawWindow(tabControl->GetHwnd(), NULL, NULL, RDW_INVALIDATE | RDW_UPDATENOW);
+        // テーマの切り替えはサンプルと同じく WM_APP で送る
+        SendMessage(tabControl->GetHwnd(), WM_APP, !isDarkMode, 0);
+        tabControl->SetSoftwareRendering((iteration & 2) != 0);
+        RedrawWindow(tabControl->GetHwnd(), NULL, NULL, RDW_INVALIDATE | RDW_UPDATENOW);
+        PumpMessages();
+    }
+    DestroyWindow(hParent);
+    PumpMessages();
+    delete tabControl;
+}
+
+static void ThreadMain(int thread, int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+        CreateAndDestroy(thread, i);
+    }
+}
+
+int main(int argc, char** argv) {
+    int threadCount = argc > 1 ? atoi(argv[1]) : 8;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    if (threadCount <= 0 || iterations <= 0) {
+        fprintf(stderr, "usage: TabStressTest [threads] [iterations]\n");
+        return 2;
+    }
+
+    // クラスの登録やシステムが一度だけ作るものを先に済ませてから数える
+    CreateAndDestroy(0, 0);
+    DWORD gdiBefore = GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back(ThreadMain, t, iterations);
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    int poolEntries = TabResourcePool::GetEntryCount();
+    long gdiLeaked = (long)GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS) - (long)gdiBefore;
+    printf("{\"op\":\"create_destroy\",\"threads\":%d,\"iterations\":%d,\"ms\":%.1f,\"pool_entries\":%d,\"gdi_leaked\":%ld,\"failures\":%d}\n",
+        threadCount, iterations, ms, poolEntries, gdiLeaked, s_failures.load());
+    return (poolEntries != 0 || gdiLeaked > 0 || s_failures.load() != 0) ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+﻿// タブ幅の木 (TabWidthTree) のテスト。Windows API に依存しないので Linux でもそのまま動く。
+//
+//   g++ -std=c++14 -I. Benchmark/TabWidthTreeTest.cpp TabWidthTree.cpp -o tab_width_tree_test
+//   ./tab_width_tree_test
+//
+// ふつうの配列に同じ操作をして、すべての問い合わせの答えが一致することを確かめる。失敗すると assert で止まる。
+
+#undef NDEBUG
+#include "TabWidthTree.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static void CheckSame(const TabWidthTree& tree, const std::vector<int>& widths) {
+    int n = (int)widths.size();
+    assert(tree.Size() == n);
+    std::vector<int> all(n);
+    tree.GetRange(0, n, all.data());
+    assert(all == widths);
+    for (int i = 0; i < n; i += 7) {
+        int count = std::min(5, n - i);
+        int part[5];
+        tree.GetRange(i, count, part);
+        assert(std::equal(part, part + count, widths.begin() + i));
+    }
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+        assert(tree.Get(i) == widths[i]);
+        assert(tree.PrefixSum(i) == sum);
+        for (int offset = sum; offset < sum + widths[i]; ++offset) {
+            assert(tree.FindIndex(offset) == i);
+        }
+        sum += widths[i];
+    }
+    assert(tree.PrefixSum(n) == sum);
+    assert(tree.PrefixSum(n + 10) == sum);
+    assert(tree.Total() == sum);
+    assert(tree.FindIndex(-1) == -1);
+    assert(tree.FindIndex(sum) == -1);
+}
+
+static void TestEmpty() {
+    TabWidthTree tree;
+    CheckSame(tree, std::vector<int>());
+    tree.Erase(0);
+    tree.Move(0, 1);
+    tree.Set(0, 5);
+    assert(tree.Get(0) == 0);
+    CheckSame(tree, std::vector<int>());
+}
+
+static void TestZeroWidths() {
+    // 幅 0 (まだ計っていないタブ) は FindIndex で飛ばす
+    std::vector<int> widths = { 0, 10, 0, 0, 10, 0 };
+    TabWidthTree tree;
+    tree.Assign(widths);
+    CheckSame(tree, widths);
+    assert(tree.FindIndex(10) == 4);
+}
+
+static void TestRandomEdits() {
+    std::mt19937 random(12345);
+    std::vector<int> widths;
+    TabWidthTree tree;
+    for (int step = 0; step < 4000; ++step) {
+        int n = (int)widths.size();
+        int width = (int)(random() % 8);
+        switch (random() % 8) {
+        case 0:
+            tree.PushBack(width);
+            widths.push_back(width);
+            break;
+        case 1: {
+            int index = (int)(random() % (n + 1));
+            tree.Insert(index, width);
+            widths.insert(widths.begin() + index, width);
+            break;
+        }
+        case 2:
+            if (n > 0) {
+                int index = (int)(random() % n);
+                tree.Erase(index);
+                widths.erase(widths.begin() + index);
+            }
+            break;
+        case 3: {
+            int index = (int)(random() % (n + 1));
+            int count = (int)(random() % 6);
+            std::vector<int> inserted(count);
+            for (int& w : inserted) {
+                w = (int)(random() % 8);
+            }
+            tree.InsertRange(index, inserted.data(), count);
+            widths.insert(widths.begin() + index, inserted.begin(), inserted.end());
+            break;
+        }
+        case 4:
+            if (n > 0) {
+                int index = (int)(random() % n);
+                int count = (int)(random() % 6);
+                tree.EraseRange(index, count);
+                widths.erase(widths.begin() + index, widths.begin() + std::min(n, index + count));
+            }
+            break;
+        case 5:
+            if (n > 0) {
+                int from = (int)(random() % n);
+                int to = (int)(random() % n);
+                tree.Move(from, to);
+                int moved = widths[from];
+                widths.erase(widths.begin() + from);
+                widths.insert(widths.begin() + to, moved);
+            }
+            break;
+        case 6:
+            if (n > 0) {
+                int index = (int)(random() % n);
+                tree.Set(index, width);
+                widths[index] = width;
+            }
+            break;
+        case 7:
+            if (n > 0) {
+                int index = (int)(random() % n);
+                int count = std::min((int)(random() % 6) + 1, n - index);
+                std::vector<int> replaced(count);
+                for (int& w : replaced) {
+                    w = (int)(random() % 8);
+                }
+                tree.SetRange(index, replaced.data(), count);
+                std::copy(replaced.begin(), replaced.end(), widths.begin() + index);
+            }
+            if (random() % 50 == 0) {
+                tree.Assign(widths);
+            }
+            break;
+        }
+        if (step % 10 == 0) {
+            CheckSame(tree, widths);
+        }
+    }
+    CheckSame(tree, widths);
+    tree.Clear();
+    CheckSame(tree, std::vector<int>());
+}
+
+int main() {
+    TestEmpty();
+    TestZeroWidths();
+    TestRandomEdits();
+    printf("TabWidthTreeTest: all tests passed\n");
+    return 0;
+}
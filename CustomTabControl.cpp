@@ -3,20 +3,88 @@
 #include <uxtheme.h>
 #include <commctrl.h>
 #include <algorithm>
+#include <mutex>
 #include <math.h>
 #include "CUtil.h"
 
-#define TAB_PADDING_X 16
-#define TAB_PADDING_Y 8
-#define TAB_ROUND_RADIUS 8
-#define FONT_SIZE 16
-
 static const WCHAR s_szClassName[] = L"CustomTabControlClass";
 static const WCHAR s_szDragClassName[] = L"CustomTabDragClass";
 static const WCHAR s_szPopupClassName[] = L"CustomTabPopupClass";
-static bool s_classRegistered = false;
-static bool s_dragClassRegistered = false;
-static bool s_popupClassRegistered = false;
+static const WCHAR s_szOverflowClassName[] = L"CustomTabOverflowClass";
+// 複数の UI スレッドから同時に Create されても登録は 1 回だけ
+static std::once_flag s_classOnce;
+static std::once_flag s_dragClassOnce;
+static std::once_flag s_popupClassOnce;
+static std::once_flag s_overflowClassOnce;
+
+// タブ一覧のポップアップ (96 DPI 基準)
+#define OVERFLOW_LIST_WIDTH 320
+#define OVERFLOW_ITEM_HEIGHT 28
+#define OVERFLOW_VISIBLE_ITEMS 12
+#define IDC_OVERFLOW_EDIT 1
+#define IDC_OVERFLOW_LIST 2
+
+// アニメーション (96 DPI 基準)
+#define WHEEL_SCROLL_STEP 60
+#define AUTO_SCROLL_ZONE 32
+#define AUTO_SCROLL_SPEED 800
+#define HOVER_FADE_STEPS 8
+
+// DPI が変わった後の計測。WM_TIMER は他のメッセージがないときだけ届くので、空き時間に進む
+#define IDLE_MEASURE_TIMER_ID 2
+#define IDLE_MEASURE_INTERVAL 15
+#define IDLE_MEASURE_TIME_SLICE 4.0
+#define IDLE_MEASURE_BATCH 64
+
+// ツールチップの文字列の最大幅 (96 DPI 基準)。超えたら中央を省略する
+#define TOOLTIP_MAX_TEXT_WIDTH 600
+// ツールチップのサムネイルの最大サイズ (96 DPI 基準)
+#define THUMBNAIL_WIDTH 240
+#define THUMBNAIL_HEIGHT 150
+// サムネイルの縮小が終わったときにワーカースレッドから届く
+#define WM_THUMBNAIL_READY (WM_APP + 1)
+// ワーカースレッドからの変更を空のキューに積んだときに 1 回だけ届く
+#define WM_TAB_UPDATES (WM_APP + 2)
+#define TAB_UPDATES_TIMER_ID 3
+// アニメーションの 1 フレームごとに TabFramePacer から届く
+#define WM_ANIMATION_FRAME (WM_APP + 3)
+
+static LONGLONG GetPerformanceFrequency() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+}
+
+// 単調増加するミリ秒単位の時刻
+static double GetAnimationTime() {
+    // 関数内の static の初期化はスレッドセーフ
+    static const LONGLONG s_frequency = GetPerformanceFrequency();
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1000.0 / (double)s_frequency;
+}
+
+// from と to の間を step / steps の割合で混ぜる
+static COLORREF BlendColor(COLORREF from, COLORREF to, int step, int steps) {
+    return RGB(
+        GetRValue(from) + (GetRValue(to) - GetRValue(from)) * step / steps,
+        GetGValue(from) + (GetGValue(to) - GetGValue(from)) * step / steps,
+        GetBValue(from) + (GetBValue(to) - GetBValue(from)) * step / steps);
+}
+
+static RECT ToRECT(const TabRect& rc) {
+    RECT rect = { rc.left, rc.top, rc.right, rc.bottom };
+    return rect;
+}
+
+static TabRect ToTabRect(const RECT& rc) {
+    TabRect rect = { (int)rc.left, (int)rc.top, (int)rc.right, (int)rc.bottom };
+    return rect;
+}
+
+static uint32_t ToRasterColor(COLORREF color) {
+    return TabRasterColor(GetRValue(color), GetGValue(color), GetBValue(color));
+}
 
 LRESULT CALLBACK CustomTabControl::PopupWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     CustomTabControl* pThis = reinterpret_cast<CustomTabControl*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
@@ -29,15 +97,22 @@ LRESULT CALLBACK CustomTabControl::PopupWndProc(HWND hWnd, UINT uMsg, WPARAM wPa
             GetClientRect(hWnd, &rcClient);
 
             // 背景の描画を修正
-            HBRUSH hBrush = CreateSolidBrush(pThis->m_clrTooltipBg);
-            FillRect(hdc, &rcClient, hBrush);
-            DeleteObject(hBrush);
+            FillRect(hdc, &rcClient, pThis->m_gdiCache.GetBrush(pThis->m_clrTooltipBg));
+
+            // サムネイルは上に、タイトルはその下に出す
+            RECT rcText = rcClient;
+            if (pThis->m_hasPopupThumbnail) {
+                RECT rcThumbnail = { 10, 10, rcClient.right - 10, 10 + MulDiv(THUMBNAIL_HEIGHT, pThis->m_dpi, 96) };
+                pThis->DrawPopupThumbnail(hdc, rcThumbnail);
+                rcText.top = rcThumbnail.bottom;
+            }
 
             // テキストの描画を修正
             SetBkMode(hdc, TRANSPARENT);
             SetTextColor(hdc, pThis->m_clrTooltipText);
-            SelectObject(hdc, pThis->m_hFont);
-            DrawTextW(hdc, pThis->m_popupText.c_str(), -1, &rcClient, DT_SINGLELINE | DT_CENTER | DT_VCENTER);
+            HFONT hOldFont = (HFONT)SelectObject(hdc, pThis->m_hFont);
+            DrawTextW(hdc, pThis->m_popupText.c_str(), -1, &rcText, DT_SINGLELINE | DT_CENTER | DT_VCENTER);
+            SelectObject(hdc, hOldFont);
 
             EndPaint(hWnd, &ps);
             return 0;
@@ -51,32 +126,37 @@ LRESULT CALLBACK CustomTabControl::PopupWndProc(HWND hWnd, UINT uMsg, WPARAM wPa
 }
 
 void CustomTabControl::RegisterPopupWindowClass(HINSTANCE hInstance) {
-    if (!s_popupClassRegistered) {
+    std::call_once(s_popupClassOnce, [hInstance]() {
         WNDCLASSEXW wc = { 0 };
         wc.cbSize = sizeof(WNDCLASSEXW);
         wc.lpfnWndProc = PopupWndProc;
         wc.hInstance = hInstance;
         wc.lpszClassName = s_szPopupClassName;
         RegisterClassExW(&wc);
-        s_popupClassRegistered = true;
-    }
+    });
 }
 
 CustomTabControl::CustomTabControl()
     : m_hWnd(NULL), m_hFont(NULL), m_dpi(96), m_selectedTab(0), m_hoveredTab(-1),
     m_hoveredCloseButtonTab(-1), m_pressedCloseButtonTab(-1),
     m_draggedTabIndex(-1), m_isDragging(false),
-    m_scrollOffset(0), m_isScrollLeftHovered(false), m_isScrollRightHovered(false),
-    m_totalTabsWidth(0), m_scrollButtonWidth(0), m_scrollButtonHeight(0),
-    m_hDragWnd(NULL), m_hPopupWnd(NULL), m_isPopupVisible(false) {
-
-    m_tabTitles.push_back(L"Tab 1");
-    m_tabTitles.push_back(L"Tab 2");
-    m_tabTitles.push_back(L"Tab 3");
-    m_tabTitles.push_back(L"Long Tab Title 4");
-    m_tabTitles.push_back(L"Another Tab");
-    m_tabTitles.push_back(L"Final Tab 6");
-    m_tabTitles.push_back(L"Tab 7");
+    m_isScrollLeftHovered(false), m_isScrollRightHovered(false), m_isOverflowHovered(false), m_lastPaintTabCount(0),
+    m_updateDepth(0), m_isLayoutPending(false), m_isEnsureVisiblePending(false),
+    m_isAnimationRunning(false), m_isAdornmentRunning(false), m_resources(NULL), m_isVirtualMode(false), m_hUpdateRgn(NULL), m_dragSnapshotLeft(0), m_dragSnapshotRight(0),
+    m_isSoftwareRendering(false), m_hDragWnd(NULL), m_hPopupWnd(NULL), m_isPopupVisible(false), m_popupTextSize(), m_hasPopupThumbnail(false), m_popupThumbnailKey(0),
+    m_hOverflowWnd(NULL), m_hOverflowEdit(NULL), m_hOverflowList(NULL), m_pfnOverflowEditProc(NULL),
+    m_hasSearchIndex(false), m_isOverflowFiltered(false), m_isOverflowRefreshPending(false) {
+
+    // 実際の幅は Create 時の WM_SETFONT で計測する
+    m_layout.AddTab(L"Tab 1");
+    m_layout.AddTab(L"Tab 2");
+    m_layout.AddTab(L"Tab 3");
+    m_layout.AddTab(L"Long Tab Title 4");
+    m_layout.AddTab(L"Another Tab");
+    m_layout.AddTab(L"Final Tab 6");
+    m_layout.AddTab(L"Tab 7");
+    m_layout.SetTextMeasurer(this);
+    m_softRenderer.SetGlyphSource(&m_glyphSource);
 
     m_clrBg = RGB(32, 32, 32);
     m_clrText = RGB(220, 220, 220);
@@ -84,32 +164,42 @@ CustomTabControl::CustomTabControl()
     m_clrSeparator = RGB(60, 60, 60);
     m_clrCloseHoverBg = RGB(200, 0, 0);
     m_clrCloseText = RGB(150, 150, 150);
+    m_lastMousePos.x = 0;
+    m_lastMousePos.y = 0;
 }
 
 CustomTabControl::~CustomTabControl() {
-    if (m_hFont) {
-        DeleteObject(m_hFont);
-    }
     if (m_hPopupWnd) {
         DestroyWindow(m_hPopupWnd);
     }
+    HideOverflowList();
     DestroyDragWindow();
+    // フォントとブラシは共有リソースのものなので、参照を返すだけ。
+    // フォントを使うウィンドウと DC を先に片付けてから返す
+    m_glyphSource.SetFont(NULL);
+    m_backBuffer.Release();
+    m_dragSnapshot.Release();
+    if (m_hUpdateRgn) {
+        DeleteObject(m_hUpdateRgn);
+    }
+    m_gdiCache.SetShared(NULL);
+    TabResourcePool::Release(m_resources);
 }
 
 void CustomTabControl::RegisterWindowClass(HINSTANCE hInstance) {
-    if (!s_classRegistered) {
+    std::call_once(s_classOnce, [hInstance]() {
         WNDCLASSEXW wc = { 0 };
         wc.cbSize = sizeof(WNDCLASSEXW);
         wc.lpfnWndProc = WndProc;
         wc.hInstance = hInstance;
         wc.hCursor = LoadCursor(NULL, IDC_ARROW);
-        wc.hbrBackground = CreateSolidBrush(RGB(32, 32, 32));
+        // 背景は WM_PAINT ですべて描くので、クラスのブラシは作らない (作ると解放されない)
+        wc.hbrBackground = (HBRUSH)GetStockObject(NULL_BRUSH);
         wc.lpszClassName = s_szClassName;
         RegisterClassExW(&wc);
-        s_classRegistered = true;
-    }
+    });
 
-    if (!s_dragClassRegistered) {
+    std::call_once(s_dragClassOnce, [hInstance]() {
         WNDCLASSEXW wc = { 0 };
         wc.cbSize = sizeof(WNDCLASSEXW);
         wc.lpfnWndProc = DragWndProc;
@@ -118,8 +208,17 @@ void CustomTabControl::RegisterWindowClass(HINSTANCE hInstance) {
         wc.hbrBackground = (HBRUSH)GetStockObject(NULL_BRUSH);
         wc.lpszClassName = s_szDragClassName;
         RegisterClassExW(&wc);
-        s_dragClassRegistered = true;
-    }
+    });
+
+    std::call_once(s_overflowClassOnce, [hInstance]() {
+        WNDCLASSEXW wc = { 0 };
+        wc.cbSize = sizeof(WNDCLASSEXW);
+        wc.lpfnWndProc = OverflowWndProc;
+        wc.hInstance = hInstance;
+        wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+        wc.lpszClassName = s_szOverflowClassName;
+        RegisterClassExW(&wc);
+    });
 }
 
 HWND CustomTabControl::Create(HWND hParent, int x, int y, int width, int height, UINT_PTR uId, BOOL IsDarkMode) {
@@ -152,14 +251,11 @@ HWND CustomTabControl::Create(HWND hParent, int x, int y, int width, int height,
         }
 
         m_dpi = GetDpiForWindow(m_hWnd);
-        int lfHeight = -MulDiv(FONT_SIZE, m_dpi, 72);
-        m_hFont = CreateFontW(
-            lfHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
-            DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-            CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_SWISS, L"Segoe UI"
-        );
-        SendMessage(m_hWnd, WM_SETFONT, (WPARAM)m_hFont, FALSE);
-
+        m_layout.SetDpi(m_dpi);
+        m_thumbnails.SetNotifyWindow(m_hWnd, WM_THUMBNAIL_READY);
+        m_updates.SetNotifyWindow(m_hWnd, WM_TAB_UPDATES);
+        m_framePacer.SetNotifyWindow(m_hWnd, WM_ANIMATION_FRAME);
+        m_thumbnails.SetMaxSize(MulDiv(THUMBNAIL_WIDTH, m_dpi, 96), MulDiv(THUMBNAIL_HEIGHT, m_dpi, 96));
         TRACKMOUSEEVENT tme;
         tme.cbSize = sizeof(tme);
         tme.dwFlags = TME_HOVER | TME_LEAVE;
@@ -167,166 +263,334 @@ HWND CustomTabControl::Create(HWND hParent, int x, int y, int width, int height,
         tme.dwHoverTime = HOVER_DEFAULT;
         _TrackMouseEvent(&tme);
 
+        // 「ウィンドウ内のアニメーション」がオフならフェードしない
+        BOOL isAnimationEnabled = TRUE;
+        SystemParametersInfoW(SPI_GETCLIENTAREAANIMATION, 0, &isAnimationEnabled, 0);
+        m_animator.SetEnabled(isAnimationEnabled != FALSE);
+
+        // フォントと配色もここで共有リソースから受け取る
         UpdateTheme(IsDarkMode);
     }
     return m_hWnd;
 }
 
-void CustomTabControl::AddTab(const std::wstring& title) {
-    m_tabTitles.push_back(title);
+UINT64 CustomTabControl::AddTab(const std::wstring& title, LPARAM userData) {
+    UINT64 id = m_layout.AddTab(title, userData);
+    RecalculateTabPositions();
+    RefreshOverflowList();
+    return id;
+}
+
+void CustomTabControl::AddTabs(const std::vector<std::wstring>& titles) {
+    InsertTabs(m_layout.GetTabCount(), titles);
+}
+
+void CustomTabControl::InsertTabs(int index, const std::vector<std::wstring>& titles) {
+    if (titles.empty()) {
+        return;
+    }
+    index = min(max(index, 0), m_layout.GetTabCount());
+    m_layout.InsertTabs(index, titles);
+    if (m_selectedTab >= index && m_layout.GetTabCount() > (int)titles.size()) {
+        m_selectedTab += (int)titles.size();
+    }
     RecalculateTabPositions();
+    RefreshOverflowList();
 }
 
 void CustomTabControl::RemoveTab(int index) {
-    if (index >= 0 && index < (int)m_tabTitles.size()) {
-        m_tabTitles.erase(m_tabTitles.begin() + index);
+    if (index >= 0 && index < m_layout.GetTabCount()) {
+        m_adornments.Remove(m_layout.GetTabId(index));
+        m_layout.RemoveTab(index);
+        ClearVirtualThumbnails();
         if (m_selectedTab == index) {
-            m_selectedTab = min((int)m_tabTitles.size() - 1, m_selectedTab);
+            m_selectedTab = min(m_layout.GetTabCount() - 1, m_selectedTab);
         }
         else if (m_selectedTab > index) {
             m_selectedTab--;
         }
         RecalculateTabPositions();
+        RefreshOverflowList();
+    }
+}
+
+void CustomTabControl::RemoveTabs(int index, int count) {
+    int tabCount = m_layout.GetTabCount();
+    if (index < 0 || index >= tabCount || count <= 0) {
+        return;
     }
+    count = min(count, tabCount - index);
+    for (int i = index; i < index + count; ++i) {
+        m_adornments.Remove(m_layout.GetTabId(i));
+    }
+    m_layout.RemoveTabs(index, count);
+    ClearVirtualThumbnails();
+    if (m_selectedTab >= index + count) {
+        m_selectedTab -= count;
+    }
+    else if (m_selectedTab >= index) {
+        m_selectedTab = min(m_layout.GetTabCount() - 1, index);
+    }
+    RecalculateTabPositions();
+    RefreshOverflowList();
 }
 
 void CustomTabControl::RenameTab(int index, const std::wstring& newTitle) {
-    if (index >= 0 && index < (int)m_tabTitles.size()) {
-        m_tabTitles[index] = newTitle;
+    if (index >= 0 && index < m_layout.GetTabCount()) {
+        m_layout.RenameTab(index, newTitle);
         RecalculateTabPositions();
+        RefreshOverflowList();
     }
 }
 
-int CustomTabControl::GetCurSel() const {
-    return m_selectedTab;
+void CustomTabControl::SetDataSource(ITabDataSource* dataSource, int count) {
+    HideCustomTooltip();
+    m_hoveredTab = -1;
+    m_hoveredCloseButtonTab = -1;
+    m_pressedCloseButtonTab = -1;
+    m_adornments.Clear();
+    m_thumbnails.Clear();
+    m_layout.SetDataSource(dataSource, max(count, 0));
+    m_isVirtualMode = dataSource != nullptr;
+    m_selectedTab = m_layout.GetTabCount() > 0 ? 0 : -1;
+    RecalculateTabPositions();
+    RefreshOverflowList();
+    StartIdleMeasure();
 }
 
-void CustomTabControl::SetCurSel(int index) {
-    if (index >= 0 && index < (int)m_tabTitles.size()) {
-        m_selectedTab = index;
-
-        RECT rcClient;
-        GetClientRect(m_hWnd, &rcClient);
-        bool showScrollButtons = m_totalTabsWidth > rcClient.right;
-        int effectiveClientWidth = showScrollButtons ? (rcClient.right - m_scrollButtonWidth * 2) : rcClient.right;
-
-        int currentX = 0;
-        int tabWidth = 0;
-        for (size_t i = 0; i <= (size_t)index; ++i) {
-            tabWidth = GetTabWidth(i);
-            if (i < (size_t)index) {
-                currentX += tabWidth;
-            }
-        }
-
-        if (currentX < m_scrollOffset) {
-            m_scrollOffset = currentX;
-        }
-        else if (currentX + tabWidth > m_scrollOffset + effectiveClientWidth) {
-            m_scrollOffset = currentX + tabWidth - effectiveClientWidth;
-        }
+void CustomTabControl::SetVirtualTabCount(int count) {
+    int tabCount = m_layout.GetTabCount();
+    if (!m_layout.GetDataSource() || count < 0 || count == tabCount) {
+        return;
+    }
+    if (count > tabCount) {
+        NotifyTabsInserted(tabCount, count - tabCount);
+    }
+    else {
+        RemoveTabs(count, tabCount - count);
+    }
+}
 
-        InvalidateRect(m_hWnd, NULL, TRUE);
+void CustomTabControl::NotifyTabsInserted(int index, int count) {
+    if (!m_layout.GetDataSource() || count <= 0) {
+        return;
+    }
+    index = min(max(index, 0), m_layout.GetTabCount());
+    bool hadTabs = m_layout.GetTabCount() > 0;
+    m_layout.InsertVirtualTabs(index, count);
+    ClearVirtualThumbnails();
+    if (!hadTabs) {
+        m_selectedTab = 0;
+    }
+    else if (m_selectedTab >= index) {
+        m_selectedTab += count;
     }
+    RecalculateTabPositions();
+    RefreshOverflowList();
+    StartIdleMeasure();
 }
 
-int CustomTabControl::GetTabCount() const {
-    return (int)m_tabTitles.size();
+void CustomTabControl::NotifyTabChanged(int index) {
+    if (index < 0 || index >= m_layout.GetTabCount()) {
+        return;
+    }
+    int oldWidth = m_layout.GetTabWidth(index);
+    m_layout.RemeasureTab(index);
+    if (m_layout.GetTabWidth(index) != oldWidth) {
+        RecalculateTabPositions();
+    }
+    else {
+        InvalidateTab(index);
+    }
+    RefreshOverflowList();
 }
 
-HWND CustomTabControl::GetHwnd() const {
-    return m_hWnd;
+void CustomTabControl::BeginUpdate() {
+    if (m_updateDepth++ == 0) {
+        m_layout.SetDeferMeasure(true);
+    }
 }
 
-void CustomTabControl::SwitchTabOrder(int index1, int index2) {
-    if (index1 == index2 || index1 < 0 || index2 < 0 ||
-        index1 >= (int)m_tabTitles.size() || index2 >= (int)m_tabTitles.size()) {
+void CustomTabControl::EndUpdate() {
+    if (m_updateDepth == 0 || --m_updateDepth > 0) {
         return;
     }
-    std::wstring draggedTabTitle = m_tabTitles[index1];
-    m_tabTitles.erase(m_tabTitles.begin() + index1);
-    if (index1 < index2) {
-        m_tabTitles.insert(m_tabTitles.begin() + index2, draggedTabTitle);
+    m_layout.SetDeferMeasure(false);
+    if (m_isEnsureVisiblePending) {
+        m_isEnsureVisiblePending = false;
+        m_layout.EnsureVisible(m_selectedTab);
     }
-    else {
-        m_tabTitles.insert(m_tabTitles.begin() + index2, draggedTabTitle);
+    if (m_isLayoutPending) {
+        m_isLayoutPending = false;
+        RecalculateTabPositions();
+    }
+    if (m_isOverflowRefreshPending) {
+        m_isOverflowRefreshPending = false;
+        RefreshOverflowList();
     }
-    if (m_selectedTab == index1) {
-        if (index1 < index2) {
-            m_selectedTab = index2 - 1;
+}
+
+int CustomTabControl::GetCurSel() const {
+    return m_selectedTab;
+}
+
+void CustomTabControl::SetCurSel(int index) {
+    if (index >= 0 && index < m_layout.GetTabCount()) {
+        int oldSelectedTab = m_selectedTab;
+        int oldScrollOffset = m_layout.GetScrollOffset();
+        m_selectedTab = index;
+        if (m_updateDepth > 0) {
+            // 幅が確定していないので EndUpdate でスクロールする
+            m_isEnsureVisiblePending = true;
+            m_isLayoutPending = true;
+            return;
+        }
+        m_layout.EnsureVisible(index);
+
+        if (m_layout.GetScrollOffset() != oldScrollOffset) {
+            InvalidateRect(m_hWnd, NULL, FALSE);
         }
         else {
-            m_selectedTab = index2;
+            InvalidateTab(oldSelectedTab);
+            InvalidateTab(m_selectedTab);
         }
     }
-    else if (m_selectedTab > index1 && m_selectedTab <= index2) {
-        m_selectedTab--;
+}
+
+int CustomTabControl::GetTabCount() const {
+    return m_layout.GetTabCount();
+}
+
+UINT64 CustomTabControl::GetTabId(int index) const {
+    return m_layout.GetTabId(index);
+}
+
+int CustomTabControl::GetTabById(UINT64 id) const {
+    return m_layout.FindTab(id);
+}
+
+bool CustomTabControl::MoveTab(UINT64 id, int newIndex) {
+    int index = m_layout.FindTab(id);
+    if (index == -1 || newIndex < 0 || newIndex >= m_layout.GetTabCount()) {
+        return false;
     }
-    else if (m_selectedTab < index1&& m_selectedTab >= index2) {
-        m_selectedTab++;
+    SwitchTabOrder(index, newIndex);
+    return true;
+}
+
+bool CustomTabControl::CloseTab(UINT64 id) {
+    int index = m_layout.FindTab(id);
+    if (index == -1) {
+        return false;
     }
-    InvalidateRect(m_hWnd, NULL, TRUE);
+    RemoveTab(index);
+    return true;
 }
 
-int CustomTabControl::HitTest(int x, int y, bool* isCloseButton, bool* isScrollLeft, bool* isScrollRight) const {
-    if (isCloseButton) *isCloseButton = false;
-    if (isScrollLeft) *isScrollLeft = false;
-    if (isScrollRight) *isScrollRight = false;
+LPARAM CustomTabControl::GetTabUserData(int index) const {
+    return (LPARAM)m_layout.GetUserData(index);
+}
 
-    RECT rcClient;
-    GetClientRect(m_hWnd, &rcClient);
-    bool showScrollButtons = m_totalTabsWidth > rcClient.right;
-    int effectiveClientWidth = showScrollButtons ? (rcClient.right - m_scrollButtonWidth * 2) : rcClient.right;
+void CustomTabControl::SetTabUserData(int index, LPARAM userData) {
+    m_layout.SetUserData(index, userData);
+}
 
-    if (showScrollButtons) {
-        if (x >= m_scrollRightRect.left && x <= m_scrollRightRect.right) {
-            if (isScrollRight) *isScrollRight = true;
-            return -1;
-        }
-        if (x >= m_scrollLeftRect.left && x <= m_scrollLeftRect.right) {
-            if (isScrollLeft) *isScrollLeft = true;
-            return -1;
-        }
+UINT64 CustomTabControl::PostAddTab(const std::wstring& title, LPARAM userData) {
+    if (m_isVirtualMode) {
+        return 0;
     }
+    // ID は積む時点で取っておき、反映するときにその ID で追加する
+    UINT64 id = m_layout.ReserveTabId();
+    m_updates.Push(TabUpdate{ TAB_UPDATE_ADD, id, title, (std::intptr_t)userData });
+    return id;
+}
 
-    if (m_isDragging) {
-        int totalWidth = 0;
-        for (size_t i = 0; i < m_tabTitles.size(); ++i) {
-            totalWidth += GetTabWidth(i);
-        }
+void CustomTabControl::PostRemoveTab(UINT64 id) {
+    m_updates.Push(TabUpdate{ TAB_UPDATE_REMOVE, id, std::wstring(), 0 });
+}
 
-        if (x < -m_scrollOffset) {
-            return 0;
-        }
-        if (x > totalWidth - m_scrollOffset) {
-            return (int)m_tabTitles.size() - 1;
-        }
+void CustomTabControl::PostRenameTab(UINT64 id, const std::wstring& title) {
+    m_updates.Push(TabUpdate{ TAB_UPDATE_RENAME, id, title, 0 });
+}
+
+void CustomTabControl::PostTabUserData(UINT64 id, LPARAM userData) {
+    m_updates.Push(TabUpdate{ TAB_UPDATE_USER_DATA, id, std::wstring(), (std::intptr_t)userData });
+}
+
+void CustomTabControl::SetTabAdornment(UINT64 id, const TabAdornment& adornment) {
+    if (m_layout.FindTab(id) == -1) {
+        return;
     }
+    m_adornments.Set(id, adornment);
+    if (m_adornments.IsAnimating() && !m_isAdornmentRunning && m_hWnd) {
+        // タブの状態表示の描き直しもアニメーションと同じく 1 フレームに 1 回
+        m_isAdornmentRunning = true;
+        m_framePacer.Start();
+    }
+}
 
-    if (x > effectiveClientWidth) {
-        return -1;
+bool CustomTabControl::GetTabAdornment(UINT64 id, TabAdornment* adornment) const {
+    const TabAdornment* found = m_adornments.Find(id);
+    if (!found) {
+        return false;
     }
+    *adornment = *found;
+    return true;
+}
 
-    int totalWidth = -m_scrollOffset;
-    int tabHeight = MulDiv(FONT_SIZE, m_dpi, 72) + MulDiv(TAB_PADDING_Y * 2, m_dpi, 96);
-    int closeBtnW = tabHeight;
-    int tabPaddingX = MulDiv(TAB_PADDING_X, m_dpi, 96);
+void CustomTabControl::PostTabAdornment(UINT64 id, const TabAdornment& adornment) {
+    m_updates.Push(TabUpdate{ TAB_UPDATE_ADORNMENT, id, std::wstring(), 0, adornment });
+}
 
-    for (size_t i = 0; i < m_tabTitles.size(); ++i) {
-        int tabWidth = GetTabWidth(i);
-        RECT tabRect = { totalWidth, 0, totalWidth + tabWidth, tabHeight };
+HWND CustomTabControl::GetHwnd() const {
+    return m_hWnd;
+}
 
-        if (x >= tabRect.left && x < tabRect.right &&
-            tabRect.right > 0 && tabRect.left < effectiveClientWidth) {
-            if (isCloseButton) {
-                int closeBtnX = tabRect.right - closeBtnW;
-                *isCloseButton = (x >= closeBtnX);
-            }
-            return (int)i;
+UINT64 CustomTabControl::GetWidthCacheHits() const {
+    return m_layout.GetWidthCacheHits();
+}
+
+UINT64 CustomTabControl::GetWidthCacheMisses() const {
+    return m_layout.GetWidthCacheMisses();
+}
+
+int CustomTabControl::GetLastPaintTabCount() const {
+    return m_lastPaintTabCount;
+}
+
+void CustomTabControl::SwitchTabOrder(int index1, int index2) {
+    if (index1 == index2 || index1 < 0 || index2 < 0 ||
+        index1 >= m_layout.GetTabCount() || index2 >= m_layout.GetTabCount()) {
+        return;
+    }
+    // 選択中のタブは ID で追いかける。仮想モードには ID がないので、移動に合わせてインデックスをずらす
+    if (m_layout.GetDataSource()) {
+        m_layout.MoveTab(index1, index2);
+        ClearVirtualThumbnails();
+        if (m_selectedTab == index1) {
+            m_selectedTab = index2;
+        }
+        else if (index1 < m_selectedTab && m_selectedTab <= index2) {
+            m_selectedTab--;
+        }
+        else if (index2 <= m_selectedTab && m_selectedTab < index1) {
+            m_selectedTab++;
+        }
+    }
+    else {
+        UINT64 selectedId = m_layout.GetTabId(m_selectedTab);
+        m_layout.MoveTab(index1, index2);
+        if (selectedId != 0) {
+            m_selectedTab = m_layout.FindTab(selectedId);
         }
-        totalWidth += tabWidth;
     }
-    return -1;
+    InvalidateRect(m_hWnd, NULL, FALSE);
+    RefreshOverflowList();
+}
+
+int CustomTabControl::HitTest(int x, int y, bool* isCloseButton, bool* isScrollLeft, bool* isScrollRight) const {
+    TAB_STAT_SCOPE(m_stats, TAB_STAT_HIT_TEST);
+    return m_layout.HitTest(x, y, m_isDragging, isCloseButton, isScrollLeft, isScrollRight);
 }
 
 LRESULT CALLBACK CustomTabControl::WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
@@ -345,6 +609,9 @@ LRESULT CALLBACK CustomTabControl::WndProc(HWND hWnd, UINT uMsg, WPARAM wParam,
         case WM_PAINT:
             pThis->OnPaint(hWnd);
             return 0;
+        case WM_ERASEBKGND:
+            // 背景もバックバッファに描くので消去しない
+            return 1;
         case WM_SIZE:
             pThis->OnSize(hWnd);
             break;
@@ -363,13 +630,59 @@ LRESULT CALLBACK CustomTabControl::WndProc(HWND hWnd, UINT uMsg, WPARAM wParam,
         case WM_MOUSELEAVE:
             pThis->OnMouseLeave(hWnd);
             return 0;
+        case WM_MOUSEWHEEL:
+            pThis->OnMouseWheel(hWnd, GET_WHEEL_DELTA_WPARAM(wParam), false);
+            return 0;
+        case WM_MOUSEHWHEEL:
+            pThis->OnMouseWheel(hWnd, GET_WHEEL_DELTA_WPARAM(wParam), true);
+            return 0;
+        case WM_TIMER:
+            if (wParam == IDLE_MEASURE_TIMER_ID) {
+                pThis->OnIdleMeasureTimer();
+                return 0;
+            }
+            if (wParam == TAB_UPDATES_TIMER_ID) {
+                KillTimer(hWnd, TAB_UPDATES_TIMER_ID);
+                pThis->ApplyTabUpdates();
+                return 0;
+            }
+            break;
         case WM_DPICHANGED:
             pThis->OnDpiChanged(hWnd, LOWORD(wParam));
             return 0;
+        case WM_SETFONT:
+            // フォントが変わったら計測済みのタブ幅は使えない
+            pThis->m_layout.RemeasureAll();
+            pThis->m_textCache.Invalidate();
+            pThis->m_popupTitle.clear();
+            pThis->RecalculateTabPositions();
+            return 0;
         case WM_APP:
             pThis->UpdateTheme((BOOL)wParam);
             return 0;
+        case WM_THUMBNAIL_READY:
+            pThis->OnThumbnailReady();
+            return 0;
+        case WM_TAB_UPDATES:
+            pThis->OnTabUpdatesPosted();
+            return 0;
+        case WM_ANIMATION_FRAME:
+            pThis->m_framePacer.OnFrame();
+            if (pThis->m_isAnimationRunning) {
+                pThis->OnAnimationFrame();
+            }
+            if (pThis->m_isAdornmentRunning) {
+                pThis->OnAdornmentFrame();
+            }
+            return 0;
         case WM_DESTROY:
+            pThis->StopAnimation();
+            pThis->m_isAdornmentRunning = false;
+            pThis->m_framePacer.Stop();
+            pThis->m_framePacer.SetNotifyWindow(NULL, 0);
+            pThis->m_thumbnails.Stop();
+            pThis->m_thumbnails.SetNotifyWindow(NULL, 0);
+            pThis->m_updates.SetNotifyWindow(NULL, 0);
             pThis->m_hWnd = NULL;
             break;
         }
@@ -397,168 +710,308 @@ LRESULT CALLBACK CustomTabControl::DragWndProc(HWND hWnd, UINT uMsg, WPARAM wPar
 }
 
 void CustomTabControl::OnPaint(HWND hWnd) {
+    TAB_STAT_SCOPE(m_stats, TAB_STAT_PAINT);
+#ifndef TAB_STATS_DISABLED
+    unsigned long long frameStart = TabStats::Now();
+    unsigned long long gdiCreatedBefore = m_gdiCache.GetCreatedCount();
+#endif
+    // 離れた 2 つのタブの状態表示が変わったときなど、無効化された範囲は矩形 1 つとは限らない。
+    // ps.rcPaint はその外接矩形なので、間のタブまで描き直さないよう BeginPaint の前にリージョンを取る
+    if (!m_hUpdateRgn) {
+        m_hUpdateRgn = CreateRectRgn(0, 0, 0, 0);
+    }
+    bool isComplexUpdate = m_hUpdateRgn && GetUpdateRgn(hWnd, m_hUpdateRgn, FALSE) == COMPLEXREGION;
     PAINTSTRUCT ps;
     HDC hdc = BeginPaint(hWnd, &ps);
 
+    // ドラッグ中はスナップショットを貼り合わせるので GDI で描く
+    if (m_isSoftwareRendering && !m_isDragging) {
+        m_lastPaintTabCount = 0;
+        if (isComplexUpdate) {
+            // リージョンを矩形に分けて、それぞれを描く
+            DWORD size = GetRegionData(m_hUpdateRgn, 0, NULL);
+            m_updateRgnData.resize(size);
+            RGNDATA* data = (RGNDATA*)m_updateRgnData.data();
+            if (size != 0 && GetRegionData(m_hUpdateRgn, size, data) != 0) {
+                const RECT* rects = (const RECT*)data->Buffer;
+                for (DWORD i = 0; i < data->rdh.nCount; ++i) {
+                    PaintSoftware(hdc, rects[i]);
+                }
+            }
+        }
+        else {
+            PaintSoftware(hdc, ps.rcPaint);
+        }
+        EndPaint(hWnd, &ps);
+#ifndef TAB_STATS_DISABLED
+        m_stats.EndFrame(TabStats::Now() - frameStart, 0);
+#endif
+        return;
+    }
+
     RECT clientRect;
     GetClientRect(hWnd, &clientRect);
 
-    HDC hdcMem = CreateCompatibleDC(hdc);
-    HBITMAP hbmMem = CreateCompatibleBitmap(hdc, clientRect.right, clientRect.bottom);
-    HBITMAP hbmOld = (HBITMAP)SelectObject(hdcMem, hbmMem);
-
-    HBRUSH hBrush = CreateSolidBrush(m_clrBg);
-    FillRect(hdcMem, &clientRect, hBrush);
-    DeleteObject(hBrush);
-
-    int tabHeight = MulDiv(FONT_SIZE, m_dpi, 72) + MulDiv(TAB_PADDING_Y * 2, m_dpi, 96);
+    // バックバッファは OnSize で確保済み。足りないときだけ作り直す
+    if (!m_backBuffer.Ensure(hdc, clientRect.right, clientRect.bottom)) {
+        EndPaint(hWnd, &ps);
+        return;
+    }
+    HDC hdcMem = m_backBuffer.GetDC();
 
-    m_scrollButtonWidth = MulDiv(30, m_dpi, 96);
-    m_scrollButtonHeight = tabHeight;
-    bool showScrollButtons = m_totalTabsWidth > clientRect.right;
-    int effectiveClientWidth = clientRect.right;
-    if (showScrollButtons) {
-        effectiveClientWidth -= m_scrollButtonWidth * 2;
+    // 無効化された範囲だけ描き直す
+    RECT rcPaint = ps.rcPaint;
+    if (isComplexUpdate) {
+        SelectClipRgn(hdcMem, m_hUpdateRgn);
+        FillRgn(hdcMem, m_hUpdateRgn, m_gdiCache.GetBrush(m_clrBg));
+    }
+    else {
+        FillRect(hdcMem, &rcPaint, m_gdiCache.GetBrush(m_clrBg));
     }
-    int maxScrollOffset = max(0, m_totalTabsWidth - effectiveClientWidth);
-    m_scrollOffset = min(maxScrollOffset, max(0, m_scrollOffset));
+
+    int tabHeight = m_layout.GetTabHeight();
+    bool showScrollButtons = m_layout.HasScrollButtons();
 
     RECT tabsDrawingRect = clientRect;
-    if (showScrollButtons) {
-        tabsDrawingRect.right = clientRect.right - m_scrollButtonWidth * 2;
-    }
+    tabsDrawingRect.right = m_layout.GetViewWidth();
+    IntersectRect(&tabsDrawingRect, &tabsDrawingRect, &rcPaint);
     IntersectClipRect(hdcMem, tabsDrawingRect.left, tabsDrawingRect.top, tabsDrawingRect.right, tabsDrawingRect.bottom);
 
-    int currentX = -m_scrollOffset;
-    std::vector<RECT> tabRects(m_tabTitles.size());
-    for (size_t i = 0; i < m_tabTitles.size(); ++i) {
+    // 見えているタブだけ描く。ドラッグ中は挿入位置に応じてタブが
+    // ドラッグ中のタブの幅だけずれるので、その分だけ範囲を広げる
+    int margin = m_isDragging ? GetTabWidth(m_draggedTabIndex) : 0;
+    int firstTab = 0;
+    int lastTab = -1;
+    bool isMultiRow = m_layout.IsMultiRow();
+    if (!isMultiRow && !IsRectEmpty(&tabsDrawingRect)) {
+        m_layout.GetTabsInRange(tabsDrawingRect.left - margin, tabsDrawingRect.right + margin, &firstTab, &lastTab);
+    }
+
+    m_lastPaintTabCount = 0;
+    if (isMultiRow && !IsRectEmpty(&tabsDrawingRect)) {
+        PaintRows(hdcMem, tabsDrawingRect);
+    }
+    if (m_isDragging && !isMultiRow && !IsRectEmpty(&tabsDrawingRect)) {
+        ComposeDragSnapshot(hdcMem, tabsDrawingRect);
+        lastTab = firstTab - 1;
+    }
+    int currentX = firstTab <= lastTab ? m_layout.GetTabOffset(firstTab) - m_layout.GetScrollOffset() : 0;
+    for (int i = firstTab; i <= lastTab; ++i) {
         int xPos = currentX;
         int tabWidth = GetTabWidth(i);
 
         if (m_isDragging) {
-            if ((int)i == m_draggedTabIndex) {
+            if (i == m_draggedTabIndex) {
                 currentX += tabWidth;
                 continue;
             }
-            else {
-                int newPos = -1;
-                int draggedTabWidth = GetTabWidth(m_draggedTabIndex);
-
-                if (m_draggedTabIndex < m_hoveredTab) {
-                    if ((int)i > m_draggedTabIndex && (int)i <= m_hoveredTab) {
-                        xPos -= draggedTabWidth;
-                    }
-                }
-                else if (m_draggedTabIndex > m_hoveredTab) {
-                    if ((int)i >= m_hoveredTab && (int)i < m_draggedTabIndex) {
-                        xPos += draggedTabWidth;
-                    }
-                }
-            }
+            xPos += m_layout.GetDragShift(i, m_draggedTabIndex, m_hoveredTab);
         }
 
-        tabRects[i] = { xPos, 0, xPos + tabWidth, tabHeight };
-        bool isActive = ((int)i == m_selectedTab);
-        bool isHovered = ((int)i == m_hoveredTab);
-        bool isCloseHovered = ((int)i == m_hoveredCloseButtonTab);
+        RECT tabRect = { xPos, 0, xPos + tabWidth, tabHeight };
+        if (isComplexUpdate && !RectVisible(hdcMem, &tabRect)) {
+            // 外接矩形には入るが、更新リージョンにはかからないタブ
+            currentX += tabWidth;
+            continue;
+        }
+        bool isActive = (i == m_selectedTab);
+        bool isCloseHovered = (i == m_hoveredCloseButtonTab);
 
-        DrawTab(hdcMem, i, tabRects[i], isActive, isHovered, isCloseHovered);
+        DrawTab(hdcMem, i, tabRect, isActive, m_animator.GetHoverLevel(i), isCloseHovered);
+        m_lastPaintTabCount++;
 
         currentX += tabWidth;
     }
 
     SelectClipRgn(hdcMem, NULL);
 
-    if (showScrollButtons) {
-        m_scrollLeftRect = { clientRect.right - m_scrollButtonWidth * 2, 0, clientRect.right - m_scrollButtonWidth, m_scrollButtonHeight };
-        m_scrollRightRect = { clientRect.right - m_scrollButtonWidth, 0, clientRect.right, m_scrollButtonHeight };
-        HBRUSH hScrollBrush = CreateSolidBrush(m_isScrollLeftHovered ? m_clrScrollButtonHoverBg : m_clrBg);
-        FillRect(hdcMem, &m_scrollLeftRect, hScrollBrush);
-        DeleteObject(hScrollBrush);
-        POINT triangleLeft[] = { {m_scrollLeftRect.left + MulDiv(10, m_dpi, 96), m_scrollLeftRect.top + MulDiv(15, m_dpi, 96)},{m_scrollLeftRect.left + MulDiv(15, m_dpi, 96), m_scrollLeftRect.top + MulDiv(10, m_dpi, 96)},{m_scrollLeftRect.left + MulDiv(15, m_dpi, 96), m_scrollLeftRect.top + MulDiv(20, m_dpi, 96)} };
-        HBRUSH hTriangleBrush = CreateSolidBrush(m_clrText);
-        SelectObject(hdcMem, hTriangleBrush);
+    if (showScrollButtons && rcPaint.right > m_layout.GetViewWidth()) {
+        RECT rcScrollLeft = ToRECT(m_layout.GetScrollLeftRect());
+        RECT rcScrollRight = ToRECT(m_layout.GetScrollRightRect());
+        HBRUSH hTriangleBrush = m_gdiCache.GetBrush(m_clrText);
+        HBRUSH hOldBrush = (HBRUSH)SelectObject(hdcMem, hTriangleBrush);
+        FillRect(hdcMem, &rcScrollLeft, m_gdiCache.GetBrush(m_isScrollLeftHovered ? m_clrScrollButtonHoverBg : m_clrBg));
+        POINT triangleLeft[] = { {rcScrollLeft.left + MulDiv(10, m_dpi, 96), rcScrollLeft.top + MulDiv(15, m_dpi, 96)},{rcScrollLeft.left + MulDiv(15, m_dpi, 96), rcScrollLeft.top + MulDiv(10, m_dpi, 96)},{rcScrollLeft.left + MulDiv(15, m_dpi, 96), rcScrollLeft.top + MulDiv(20, m_dpi, 96)} };
         Polygon(hdcMem, triangleLeft, 3);
-        DeleteObject(hTriangleBrush);
-        hScrollBrush = CreateSolidBrush(m_isScrollRightHovered ? m_clrScrollButtonHoverBg : m_clrBg);
-        FillRect(hdcMem, &m_scrollRightRect, hScrollBrush);
-        DeleteObject(hScrollBrush);
-        POINT triangleRight[] = { {m_scrollRightRect.left + MulDiv(15, m_dpi, 96), m_scrollRightRect.top + MulDiv(20, m_dpi, 96)},{m_scrollRightRect.left + MulDiv(20, m_dpi, 96), m_scrollRightRect.top + MulDiv(15, m_dpi, 96)},{m_scrollRightRect.left + MulDiv(15, m_dpi, 96), m_scrollRightRect.top + MulDiv(10, m_dpi, 96)} };
-        hTriangleBrush = CreateSolidBrush(m_clrText);
-        SelectObject(hdcMem, hTriangleBrush);
+        FillRect(hdcMem, &rcScrollRight, m_gdiCache.GetBrush(m_isScrollRightHovered ? m_clrScrollButtonHoverBg : m_clrBg));
+        POINT triangleRight[] = { {rcScrollRight.left + MulDiv(15, m_dpi, 96), rcScrollRight.top + MulDiv(20, m_dpi, 96)},{rcScrollRight.left + MulDiv(20, m_dpi, 96), rcScrollRight.top + MulDiv(15, m_dpi, 96)},{rcScrollRight.left + MulDiv(15, m_dpi, 96), rcScrollRight.top + MulDiv(10, m_dpi, 96)} };
         Polygon(hdcMem, triangleRight, 3);
-        DeleteObject(hTriangleBrush);
+        RECT rcOverflow = ToRECT(m_layout.GetOverflowButtonRect());
+        FillRect(hdcMem, &rcOverflow, m_gdiCache.GetBrush((m_isOverflowHovered || m_hOverflowWnd) ? m_clrScrollButtonHoverBg : m_clrBg));
+        POINT triangleDown[] = { {rcOverflow.left + MulDiv(10, m_dpi, 96), rcOverflow.top + MulDiv(13, m_dpi, 96)},{rcOverflow.left + MulDiv(20, m_dpi, 96), rcOverflow.top + MulDiv(13, m_dpi, 96)},{rcOverflow.left + MulDiv(15, m_dpi, 96), rcOverflow.top + MulDiv(18, m_dpi, 96)} };
+        Polygon(hdcMem, triangleDown, 3);
+        SelectObject(hdcMem, hOldBrush);
     }
 
-    BitBlt(hdc, 0, 0, clientRect.right, clientRect.bottom, hdcMem, 0, 0, SRCCOPY);
-
-    SelectObject(hdcMem, hbmOld);
-    DeleteObject(hbmMem);
-    DeleteDC(hdcMem);
+    m_backBuffer.Present(hdc, ps.rcPaint);
 
     EndPaint(hWnd, &ps);
+
+#ifndef TAB_STATS_DISABLED
+    m_stats.EndFrame(TabStats::Now() - frameStart, (unsigned int)(m_gdiCache.GetCreatedCount() - gdiCreatedBefore));
+#endif
+}
+
+void CustomTabControl::PaintSoftware(HDC hdc, const RECT& rcPaint) {
+    RECT clientRect;
+    GetClientRect(m_hWnd, &clientRect);
+    RECT rc;
+    if (!IntersectRect(&rc, &rcPaint, &clientRect)) {
+        return;
+    }
+    // バッファはクライアント全体。大きくなるときだけ確保し直す
+    m_raster.Resize(clientRect.right, clientRect.bottom);
+    m_raster.SetClip(rc.left, rc.top, rc.right, rc.bottom);
+
+    TabRenderPalette palette = {
+        ToRasterColor(m_clrBg), ToRasterColor(m_clrText), ToRasterColor(m_clrActiveTab), ToRasterColor(m_clrHoverBg),
+        ToRasterColor(m_clrSeparator), ToRasterColor(m_clrCloseText), ToRasterColor(m_clrCloseButtonHoverBg),
+        ToRasterColor(m_clrScrollButtonHoverBg), ToRasterColor(m_clrAccent)
+    };
+    m_softRenderer.SetPalette(palette);
+    m_glyphSource.SetFont(m_hFont);
+
+    TabRenderState state;
+    state.selectedTab = m_selectedTab;
+    state.hoveredCloseButtonTab = m_hoveredCloseButtonTab;
+    state.pressedCloseButtonTab = m_pressedCloseButtonTab;
+    state.isScrollLeftHovered = m_isScrollLeftHovered;
+    state.isScrollRightHovered = m_isScrollRightHovered;
+    state.isOverflowHovered = m_isOverflowHovered || m_hOverflowWnd;
+    state.animator = &m_animator;
+    state.adornments = &m_adornments;
+    state.spinnerHead = TabAdornments::GetSpinnerHead(GetAnimationTime());
+    m_softRenderer.Render(m_raster, m_layout, state);
+    m_lastPaintTabCount += m_softRenderer.GetLastTabCount();
+
+    // 無効化された行の帯だけを上から下への DIB として渡す
+    int bandHeight = rc.bottom - rc.top;
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = m_raster.GetStride();
+    bmi.bmiHeader.biHeight = -bandHeight;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    const uint32_t* bits = m_raster.GetPixels() + (size_t)rc.top * m_raster.GetStride();
+    SetDIBitsToDevice(hdc, rc.left, rc.top, rc.right - rc.left, bandHeight, rc.left, 0, 0, bandHeight, bits, &bmi, DIB_RGB_COLORS);
+
+    // グリフにできない文字を含むタイトルは、背景だけ描いてあるところに GDI で重ねる。
+    // m_textCache はそういうタイトルをグリフ番号ではなく文字列で描くので、フォントリンクと整形が効く
+    const std::vector<TabTitleFallback>& fallbacks = m_softRenderer.GetFallbackTitles();
+    if (!fallbacks.empty()) {
+        IntersectClipRect(hdc, rc.left, rc.top, min((int)rc.right, m_layout.GetViewWidth()), rc.bottom);
+        SetBkMode(hdc, TRANSPARENT);
+        SetTextColor(hdc, m_clrText);
+        HFONT hOldFont = (HFONT)SelectObject(hdc, m_hFont);
+        for (size_t i = 0; i < fallbacks.size(); ++i) {
+            RECT rcText = ToRECT(fallbacks[i].rect);
+            m_textCache.Draw(hdc, GetTabKey(fallbacks[i].index), m_layout.GetTitle(fallbacks[i].index), rcText);
+        }
+        SelectObject(hdc, hOldFont);
+        SelectClipRgn(hdc, NULL);
+    }
+}
+
+void CustomTabControl::PaintRows(HDC hdc, const RECT& rcClip) {
+    // 行の高さは同じなので、無効化された範囲にかかる行は割り算で決まる。
+    // ドラッグ中のタブは元の位置から抜くだけで、ほかのタブはずらさない
+    int tabHeight = m_layout.GetTabHeight();
+    int firstRow = max(0L, rcClip.top / tabHeight);
+    int lastRow = min((int)(rcClip.bottom - 1) / tabHeight, m_layout.GetRowCount() - 1);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        int first = 0;
+        int last = -1;
+        m_layout.GetRowRange(row, &first, &last);
+        for (int i = first; i <= last; ++i) {
+            if (m_isDragging && i == m_draggedTabIndex) {
+                continue;
+            }
+            RECT tabRect = ToRECT(m_layout.GetTabRect(i));
+            if (tabRect.left >= rcClip.right) {
+                break;
+            }
+            if (tabRect.right <= rcClip.left || !RectVisible(hdc, &tabRect)) {
+                continue;
+            }
+            DrawTab(hdc, i, tabRect, i == m_selectedTab, m_animator.GetHoverLevel(i), i == m_hoveredCloseButtonTab);
+            m_lastPaintTabCount++;
+        }
+    }
 }
 
-void CustomTabControl::DrawTab(HDC hdc, int index, const RECT& rect, bool isActive, bool isHovered, bool isCloseHovered) {
+void CustomTabControl::DrawTab(HDC hdc, int index, const RECT& rect, bool isActive, float hoverLevel, bool isCloseHovered) {
+    TAB_STAT_SCOPE(m_stats, TAB_STAT_DRAW_TAB);
     RECT rc = rect;
     COLORREF bgColor = isActive ? m_clrActiveTab : m_clrBg;
-    if (isHovered && !isActive) {
-        bgColor = m_clrHoverBg;
+    if (hoverLevel > 0.0f && !isActive) {
+        // ブラシが増えすぎないよう、フェード中の色は段階を絞る
+        int step = (int)(hoverLevel * HOVER_FADE_STEPS + 0.5f);
+        bgColor = BlendColor(m_clrBg, m_clrHoverBg, step, HOVER_FADE_STEPS);
     }
 
-    HBRUSH hBrush = CreateSolidBrush(bgColor);
-    HPEN hPen = CreatePen(PS_SOLID, 1, m_clrSeparator);
-    HBRUSH hOldBrush = (HBRUSH)SelectObject(hdc, hBrush);
+    HBRUSH hBrush = m_gdiCache.GetBrush(bgColor);
+    HPEN hPen = m_gdiCache.GetPen(m_clrSeparator);
     HPEN hOldPen = (HPEN)SelectObject(hdc, hPen);
 
-    int radius = MulDiv(TAB_ROUND_RADIUS, m_dpi, 96);
+    int radius = m_tabShape.GetDiameter();
     if (isActive) rc.bottom += 1;
-    HRGN hRgn = CreateRoundRectRgn(rc.left, rc.top, rc.right + 1, rc.bottom + 1, radius, radius);
-    HRGN hRectRgn = CreateRectRgn(rc.left, rc.top + radius, rc.right + 1, rc.bottom + 1);
-    CombineRgn(hRgn, hRgn, hRectRgn, RGN_OR);
-    DeleteObject(hRectRgn);
 
-    SelectClipRgn(hdc, hRgn);
-    FillRect(hdc, &rc, hBrush);
-    SelectClipRgn(hdc, NULL);
-    DeleteObject(hRgn);
+    // 角の部分は行ごとに削って塗り、残りは 1 回で塗る
+    int cornerRows = min(m_tabShape.GetRowCount(), (int)(rc.bottom - rc.top));
+    for (int row = 0; row < cornerRows; ++row) {
+        int inset = m_tabShape.GetInset(row);
+        RECT rcRow = { rc.left + inset, rc.top + row, min(rc.right, rc.right + 1 - inset), rc.top + row + 1 };
+        FillRect(hdc, &rcRow, hBrush);
+    }
+    RECT rcBody = { rc.left, rc.top + cornerRows, rc.right, rc.bottom };
+    FillRect(hdc, &rcBody, hBrush);
+
+    const TabAdornment* adornment = m_adornments.Find(GetTabKey(index));
+    if (adornment && adornment->progress >= 0) {
+        int barHeight = MulDiv(ADORNMENT_BAR_HEIGHT, m_dpi, 96);
+        RECT rcBar = { rect.left + radius, rect.bottom - barHeight, rect.right - radius, rect.bottom };
+        rcBar.right = rcBar.left + (rcBar.right - rcBar.left) * min(adornment->progress, 100) / 100;
+        FillRect(hdc, &rcBar, m_gdiCache.GetBrush(m_clrAccent));
+    }
 
     if (!isActive) {
-        SelectObject(hdc, hPen);
         MoveToEx(hdc, rc.left + radius, rc.top, NULL);
         LineTo(hdc, rc.right - radius, rc.top);
         MoveToEx(hdc, rc.right - 1, rc.top + radius, NULL); LineTo(hdc, rc.right - 1, rc.bottom);
         MoveToEx(hdc, rc.left, rc.top + radius, NULL); LineTo(hdc, rc.left, rc.bottom);
     }
 
-    SelectObject(hdc, hOldBrush);
     SelectObject(hdc, hOldPen);
-    DeleteObject(hBrush);
-    DeleteObject(hPen);
 
     SetBkMode(hdc, TRANSPARENT);
     SetTextColor(hdc, m_clrText);
-    SelectObject(hdc, m_hFont);
-    RECT rcText = rect;
-    rcText.left += MulDiv(TAB_PADDING_X, m_dpi, 96) / 2;
-    int closeBtnW = rect.bottom - rect.top;
-    rcText.right -= closeBtnW;
-    DrawTextW(hdc, m_tabTitles[index].c_str(), -1, &rcText, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_END_ELLIPSIS);
+    // 共有フォントは Release で消されることがあるので、選んだままにしない
+    HFONT hOldFont = (HFONT)SelectObject(hdc, m_hFont);
+    TabRect tabRect = ToTabRect(rect);
+    RECT rcText = ToRECT(m_layout.GetTextRect(tabRect));
+    // 状態表示だけを描き直すときはタイトルに触れない
+    if (RectVisible(hdc, &rcText)) {
+        m_textCache.Draw(hdc, GetTabKey(index), m_layout.GetTitle(index), rcText);
+    }
 
-    int closeBtnX = rect.right - closeBtnW;
-    RECT rcCloseRect = { closeBtnX, rect.top, rect.right, rect.bottom };
+    RECT rcCloseRect = ToRECT(m_layout.GetCloseButtonRect(tabRect));
 
     bool isPressed = ((int)index == m_pressedCloseButtonTab);
+    // ホバーしていないタブは閉じるボタンの代わりに状態を出す
+    bool hasStatus = adornment && (adornment->isBusy || adornment->unreadCount > 0 || adornment->isModified);
+    if (hasStatus && hoverLevel <= 0.0f && !isCloseHovered && !isPressed) {
+        DrawTabStatus(hdc, *adornment, rcCloseRect, bgColor);
+        SelectObject(hdc, hOldFont);
+        return;
+    }
     // ホバー時にm_clrCloseButtonHoverBgを使用
-    HBRUSH hCloseBrush = (isCloseHovered || isPressed) ? CreateSolidBrush(m_clrCloseButtonHoverBg) : (HBRUSH)GetStockObject(NULL_BRUSH);
-
     if (isCloseHovered || isPressed) {
-        FillRect(hdc, &rcCloseRect, hCloseBrush);
+        FillRect(hdc, &rcCloseRect, m_gdiCache.GetBrush(m_clrCloseButtonHoverBg));
     }
-    DeleteObject(hCloseBrush);
 
     COLORREF oldTextColor = SetTextColor(hdc, (isCloseHovered || isPressed) ? RGB(255, 255, 255) : m_clrCloseText);
-    HPEN hClosePen = CreatePen(PS_SOLID, 1, (isCloseHovered || isPressed) ? m_clrText : m_clrCloseText); // ★ 修正: ホバー時のX印の色をm_clrTextに
+    HPEN hClosePen = m_gdiCache.GetPen((isCloseHovered || isPressed) ? m_clrText : m_clrCloseText); // ★ 修正: ホバー時のX印の色をm_clrTextに
     HPEN hOldClosePen = (HPEN)SelectObject(hdc, hClosePen);
 
     int crossPadding = MulDiv(8, m_dpi, 96);
@@ -571,14 +1024,72 @@ void CustomTabControl::DrawTab(HDC hdc, int index, const RECT& rect, bool isActi
 
     SetTextColor(hdc, oldTextColor);
     SelectObject(hdc, hOldClosePen);
-    DeleteObject(hClosePen);
+    SelectObject(hdc, hOldFont);
+}
+
+void CustomTabControl::DrawTabStatus(HDC hdc, const TabAdornment& adornment, const RECT& rect, COLORREF bgColor) {
+    int cx = (rect.left + rect.right) / 2;
+    int cy = (rect.top + rect.bottom) / 2;
+    if (adornment.isBusy) {
+        // 円周上の点を、いちばん明るい点から離れるほど背景に近い色で描く
+        static const int s_directions[TAB_SPINNER_DOTS][2] = {
+            { 0, -1000 }, { 707, -707 }, { 1000, 0 }, { 707, 707 },
+            { 0, 1000 }, { -707, 707 }, { -1000, 0 }, { -707, -707 }
+        };
+        int radius = MulDiv(ADORNMENT_SPINNER_RADIUS, m_dpi, 96);
+        int dot = max(1, MulDiv(ADORNMENT_SPINNER_DOT, m_dpi, 96));
+        int head = TabAdornments::GetSpinnerHead(GetAnimationTime());
+        for (int i = 0; i < TAB_SPINNER_DOTS; ++i) {
+            int x = cx + MulDiv(radius, s_directions[i][0], 1000);
+            int y = cy + MulDiv(radius, s_directions[i][1], 1000);
+            int age = (head - i + TAB_SPINNER_DOTS) % TAB_SPINNER_DOTS;
+            RECT rcDot = { x - dot, y - dot, x + dot, y + dot };
+            FillRect(hdc, &rcDot, m_gdiCache.GetBrush(BlendColor(m_clrText, bgColor, age, TAB_SPINNER_DOTS)));
+        }
+        return;
+    }
+
+    HBRUSH hOldBrush = (HBRUSH)SelectObject(hdc, GetStockObject(NULL_BRUSH));
+    HPEN hOldPen = (HPEN)SelectObject(hdc, GetStockObject(NULL_PEN));
+    if (adornment.unreadCount > 0) {
+        std::wstring text = adornment.unreadCount > 99 ? L"99+" : std::to_wstring(adornment.unreadCount);
+        SIZE size;
+        GetTextExtentPoint32W(hdc, text.c_str(), (int)text.length(), &size);
+        int height = MulDiv(ADORNMENT_BADGE_HEIGHT, m_dpi, 96);
+        int width = min(max(height, (int)size.cx + height / 2), (int)(rect.right - rect.left));
+        RECT rcBadge = { cx - width / 2, cy - height / 2, cx - width / 2 + width, cy - height / 2 + height };
+        SelectObject(hdc, m_gdiCache.GetBrush(m_clrAccent));
+        RoundRect(hdc, rcBadge.left, rcBadge.top, rcBadge.right + 1, rcBadge.bottom + 1, height, height);
+        SetTextColor(hdc, RGB(255, 255, 255));
+        DrawTextW(hdc, text.c_str(), (int)text.length(), &rcBadge, DT_SINGLELINE | DT_CENTER | DT_VCENTER | DT_NOPREFIX);
+    }
+    else if (adornment.isModified) {
+        int radius = MulDiv(ADORNMENT_DOT_RADIUS, m_dpi, 96);
+        SelectObject(hdc, m_gdiCache.GetBrush(m_clrText));
+        Ellipse(hdc, cx - radius, cy - radius, cx + radius + 1, cy + radius + 1);
+    }
+    SelectObject(hdc, hOldPen);
+    SelectObject(hdc, hOldBrush);
 }
 
 void CustomTabControl::OnSize(HWND hWnd) {
     RECT rcClient;
     GetClientRect(hWnd, &rcClient);
-    int tabHeight = MulDiv(FONT_SIZE, m_dpi, 72) + MulDiv(TAB_PADDING_Y * 2, m_dpi, 96);
-    SetWindowPos(hWnd, NULL, 0, 0, rcClient.right, tabHeight, SWP_NOZORDER);
+    int height = m_layout.GetTabHeight();
+    if (m_layout.IsMultiRow()) {
+        // 行数は幅で決まるので、幅を反映してから高さを合わせる
+        m_layout.SetClientWidth(rcClient.right);
+        UpdateControlHeight();
+        height = m_layout.GetRequiredHeight();
+    }
+    else {
+        SetWindowPos(hWnd, NULL, 0, 0, rcClient.right, height, SWP_NOZORDER);
+    }
+
+    HDC hdc = GetDC(hWnd);
+    m_backBuffer.Ensure(hdc, rcClient.right, height);
+    ReleaseDC(hWnd, hdc);
+
     RecalculateTabPositions();
 }
 
@@ -590,44 +1101,49 @@ void CustomTabControl::OnLButtonDown(HWND hWnd, int x, int y) {
 
     HideCustomTooltip();
 
+    if (m_layout.HasScrollButtons() && x >= m_layout.GetOverflowButtonRect().left) {
+        // 開いているときに押されたら閉じる
+        if (m_hOverflowWnd) {
+            HideOverflowList();
+        }
+        else {
+            ShowOverflowList();
+        }
+        return;
+    }
+
     if (isScrollLeft) {
-        m_scrollOffset = max(0, m_scrollOffset - 50);
-        InvalidateRect(hWnd, NULL, TRUE);
+        SmoothScrollBy(-50);
         return;
     }
 
     if (isScrollRight) {
-        RECT rcClient;
-        GetClientRect(hWnd, &rcClient);
-        int effectiveClientWidth = rcClient.right;
-        if (m_totalTabsWidth > rcClient.right) {
-            effectiveClientWidth -= m_scrollButtonWidth * 2;
-        }
-        int maxScrollOffset = max(0, m_totalTabsWidth - effectiveClientWidth);
-        m_scrollOffset = min(maxScrollOffset, m_scrollOffset + 50);
-        InvalidateRect(hWnd, NULL, TRUE);
+        SmoothScrollBy(50);
         return;
     }
 
     if (index != -1) {
         if (isClose) {
             m_pressedCloseButtonTab = index;
-            InvalidateRect(hWnd, NULL, FALSE);
+            InvalidateTab(index);
             SetCapture(hWnd);
         }
         else {
+            int oldSelectedTab = m_selectedTab;
             m_selectedTab = index;
             m_draggedTabIndex = index;
             m_dragStartPos.x = x;
             m_dragStartPos.y = y;
             SetCapture(hWnd);
 
-            InvalidateRect(hWnd, NULL, TRUE);
+            InvalidateTab(oldSelectedTab);
+            InvalidateTab(index);
         }
     }
 }
 
 void CustomTabControl::OnMouseMove(HWND hWnd, int x, int y) {
+    TAB_STAT_SCOPE(m_stats, TAB_STAT_MOUSE_MOVE);
     bool isClose = false;
     bool isScrollLeft = false;
     bool isScrollRight = false;
@@ -640,15 +1156,29 @@ void CustomTabControl::OnMouseMove(HWND hWnd, int x, int y) {
     if (m_isDragging) {
         isClose = false;
     }
-    m_hoveredTab = newHoveredTab;
+    m_lastMousePos.x = x;
+    m_lastMousePos.y = y;
+    SetHoveredTab(newHoveredTab);
 
     m_hoveredCloseButtonTab = isClose ? m_hoveredTab : -1;
 
-    // ホバー状態が変化した場合のみ再描画
-    if (oldHoveredTab != m_hoveredTab || oldHoveredCloseButtonTab != m_hoveredCloseButtonTab || isScrollLeft != m_isScrollLeftHovered || isScrollRight != m_isScrollRightHovered) {
+    // ホバー状態が変化した場合のみ、変化したタブとボタンだけ再描画
+    if (oldHoveredTab != m_hoveredTab || oldHoveredCloseButtonTab != m_hoveredCloseButtonTab) {
+        if (m_isDragging) {
+            // 挿入位置が変わったときは、前後の挿入位置の間だけがずれる
+            InvalidateDragSpan(oldHoveredTab, m_hoveredTab);
+        }
+        else {
+            InvalidateTab(oldHoveredTab);
+            InvalidateTab(m_hoveredTab);
+        }
+    }
+    bool isOverflow = m_layout.HasScrollButtons() && x >= m_layout.GetOverflowButtonRect().left;
+    if (isScrollLeft != m_isScrollLeftHovered || isScrollRight != m_isScrollRightHovered || isOverflow != m_isOverflowHovered) {
         m_isScrollLeftHovered = isScrollLeft;
         m_isScrollRightHovered = isScrollRight;
-        InvalidateRect(hWnd, NULL, FALSE);
+        m_isOverflowHovered = isOverflow;
+        InvalidateScrollButtons();
     }
 
     if (m_draggedTabIndex != -1 && GetCapture() == hWnd && m_pressedCloseButtonTab == -1) {
@@ -657,23 +1187,26 @@ void CustomTabControl::OnMouseMove(HWND hWnd, int x, int y) {
                 abs(y - m_dragStartPos.y) > GetSystemMetrics(SM_CYDRAG)) {
                 m_isDragging = true;
                 CreateDragWindow(m_draggedTabIndex);
+                m_dragSnapshotLeft = m_dragSnapshotRight = 0;
+                InvalidateRect(hWnd, NULL, FALSE);
             }
         }
         else {
             POINT pt;
             GetCursorPos(&pt);
             int tabWidth = GetTabWidth(m_draggedTabIndex);
-            int tabHeight = MulDiv(FONT_SIZE, m_dpi, 72) + MulDiv(TAB_PADDING_Y * 2, m_dpi, 96);
+            int tabHeight = m_layout.GetTabHeight();
             SetWindowPos(m_hDragWnd, NULL, pt.x - tabWidth / 2, pt.y - tabHeight / 2, tabWidth, tabHeight, SWP_NOZORDER | SWP_NOACTIVATE);
 
-            InvalidateRect(hWnd, NULL, FALSE);
+            // タブ列はスナップショットのままなので、ドラッグウィンドウを動かすだけでよい
+            UpdateAutoScroll(x);
         }
     }
     else if (m_pressedCloseButtonTab != -1 && GetCapture() == hWnd) {
         bool isCloseBtnHoveredNow = isClose && (newHoveredTab == m_pressedCloseButtonTab);
         if (isCloseBtnHoveredNow != (m_hoveredCloseButtonTab != -1)) {
             m_hoveredCloseButtonTab = isCloseBtnHoveredNow ? m_pressedCloseButtonTab : -1;
-            InvalidateRect(hWnd, NULL, FALSE);
+            InvalidateTab(m_pressedCloseButtonTab);
         }
     }
 
@@ -706,28 +1239,16 @@ void CustomTabControl::OnLButtonUp(HWND hWnd, int x, int y) {
 
     ReleaseCapture();
 
+    bool wasDragging = m_isDragging;
+    int pressedCloseButtonTab = m_pressedCloseButtonTab;
+    m_animator.SetAutoScrollVelocity(0.0, GetAnimationTime());
     if (m_isDragging) {
-        bool isClose = false;
-        bool isScrollLeft = false;
-        bool isScrollRight = false;
-        int dropIndex = -1;
-        RECT rcClient;
-        GetClientRect(hWnd, &rcClient);
-        int totalTabsWidth = 0;
-        for (size_t i = 0; i < m_tabTitles.size(); ++i) {
-            totalTabsWidth += GetTabWidth(i);
-        }
-        if (m_hoveredTab == -1 && x > totalTabsWidth - m_scrollOffset) {
-            dropIndex = (int)m_tabTitles.size() - 1;
-        }
-        else {
-            dropIndex = HitTest(x, y, &isClose, &isScrollLeft, &isScrollRight);
-        }
-        if (dropIndex == -1) {
-            dropIndex = m_draggedTabIndex;
-        }
+        int dropIndex = m_layout.GetDropIndex(x, y, m_hoveredTab, m_draggedTabIndex);
         if (dropIndex != m_draggedTabIndex) {
             SwitchTabOrder(m_draggedTabIndex, dropIndex);
+            if (m_layout.GetDataSource()) {
+                m_layout.GetDataSource()->OnTabMoved(m_draggedTabIndex, dropIndex);
+            }
         }
         SetCurSel(dropIndex);
         RecalculateTabPositions();
@@ -740,64 +1261,371 @@ void CustomTabControl::OnLButtonUp(HWND hWnd, int x, int y) {
 
         if (index != -1 && isClose && index == m_pressedCloseButtonTab) {
             RemoveTab(index);
+            if (m_layout.GetDataSource()) {
+                m_layout.GetDataSource()->OnTabClosed(index);
+            }
         }
     }
 
     m_draggedTabIndex = -1;
     m_isDragging = false;
     m_pressedCloseButtonTab = -1;
-    InvalidateRect(hWnd, NULL, TRUE);
+    m_dragSnapshot.Release();
+    m_dragSnapshotLeft = m_dragSnapshotRight = 0;
+    if (wasDragging) {
+        InvalidateRect(hWnd, NULL, FALSE);
+    }
+    else {
+        InvalidateTab(pressedCloseButtonTab);
+    }
 }
 
 void CustomTabControl::OnMouseLeave(HWND hWnd) {
-    if (m_hoveredTab != -1 || m_isScrollLeftHovered || m_isScrollRightHovered || m_hoveredCloseButtonTab != -1) {
-        m_hoveredTab = -1;
+    if (m_hoveredTab != -1 || m_isScrollLeftHovered || m_isScrollRightHovered || m_isOverflowHovered || m_hoveredCloseButtonTab != -1) {
+        InvalidateTab(m_hoveredTab);
+        if (m_isScrollLeftHovered || m_isScrollRightHovered || m_isOverflowHovered) {
+            InvalidateScrollButtons();
+        }
+        SetHoveredTab(-1);
         m_hoveredCloseButtonTab = -1;
         m_isScrollLeftHovered = false;
         m_isScrollRightHovered = false;
+        m_isOverflowHovered = false;
         HideCustomTooltip();
-        InvalidateRect(hWnd, NULL, FALSE);
     }
 }
 
+void CustomTabControl::OnMouseWheel(HWND hWnd, int delta, bool isHorizontal) {
+    if (!m_layout.HasScrollButtons()) {
+        return;
+    }
+    // 縦ホイールは上で左へ、横ホイール (タッチパッド) は右で右へ。
+    // タッチパッドは細かい値で何度も来るので、量に比例させる
+    int step = MulDiv(WHEEL_SCROLL_STEP, m_dpi, 96);
+    int distance = MulDiv(step, delta, WHEEL_DELTA);
+    SmoothScrollBy(isHorizontal ? distance : -distance);
+}
+
 void CustomTabControl::OnDpiChanged(HWND hWnd, int dpi) {
     m_dpi = dpi;
-    if (m_hFont) {
-        DeleteObject(m_hFont);
-    }
-    int lfHeight = -MulDiv(FONT_SIZE, m_dpi, 72);
-    m_hFont = CreateFontW(
-        lfHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
-        DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-        CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_SWISS, L"Segoe UI"
-    );
-    SendMessage(m_hWnd, WM_SETFONT, (WPARAM)m_hFont, FALSE);
-    InvalidateRect(hWnd, NULL, TRUE);
+    m_layout.SetDpi(m_dpi);
+    m_thumbnails.SetMaxSize(MulDiv(THUMBNAIL_WIDTH, m_dpi, 96), MulDiv(THUMBNAIL_HEIGHT, m_dpi, 96));
+    // タブの高さが変わるので、次の OnSize で作り直す
+    m_backBuffer.Release();
+    AcquireResources(m_resources ? m_resources->isDarkMode : true);
+    StartIdleMeasure();
+    InvalidateRect(hWnd, NULL, FALSE);
 }
 
 void CustomTabControl::RecalculateTabPositions() {
-    m_totalTabsWidth = 0;
-    for (size_t i = 0; i < m_tabTitles.size(); ++i) {
-        m_totalTabsWidth += GetTabWidth(i);
+    if (m_updateDepth > 0) {
+        m_isLayoutPending = true;
+        return;
     }
-    InvalidateRect(m_hWnd, NULL, TRUE);
+    // タブの並びが変わるとフェード中のインデックスは意味を失う
+    m_animator.ResetHover(m_hoveredTab);
+    InvalidateDragSnapshot();
+    RECT rcClient = { 0 };
+    GetClientRect(m_hWnd, &rcClient);
+    m_layout.SetClientWidth(rcClient.right);
+    UpdateControlHeight();
+    InvalidateRect(m_hWnd, NULL, FALSE);
 }
 
-int CustomTabControl::GetTabWidth(int index) const {
-    if (index < 0 || index >= (int)m_tabTitles.size()) {
-        return 0;
+void CustomTabControl::UpdateControlHeight() {
+    if (!m_hWnd) {
+        return;
+    }
+    RECT rcClient = { 0 };
+    GetClientRect(m_hWnd, &rcClient);
+    int height = m_layout.GetRequiredHeight();
+    if (height == rcClient.bottom) {
+        return;
+    }
+    // WM_SIZE の中でレイアウトし直される
+    SetWindowPos(m_hWnd, NULL, 0, 0, rcClient.right, height, SWP_NOZORDER | SWP_NOMOVE);
+
+    NMCTCHEIGHT nm = {};
+    nm.hdr.hwndFrom = m_hWnd;
+    nm.hdr.idFrom = GetDlgCtrlID(m_hWnd);
+    nm.hdr.code = CTCN_HEIGHTCHANGED;
+    nm.height = height;
+    SendMessage(GetParent(m_hWnd), WM_NOTIFY, nm.hdr.idFrom, (LPARAM)&nm);
+}
+
+void CustomTabControl::InvalidateTab(int index) {
+    if (m_updateDepth > 0) {
+        m_isLayoutPending = true;
+        return;
+    }
+    if (!m_hWnd || index < 0 || index >= m_layout.GetTabCount()) {
+        return;
+    }
+    InvalidateDragSnapshot();
+    RECT rc = ToRECT(m_layout.GetTabRect(index));
+    rc.left = max(rc.left, 0L);
+    rc.right = min(rc.right, (LONG)m_layout.GetViewWidth());
+    if (rc.left < rc.right) {
+        InvalidateRect(m_hWnd, &rc, FALSE);
+    }
+}
+
+void CustomTabControl::InvalidateDragSnapshot() {
+    if (m_isDragging) {
+        m_dragSnapshotLeft = m_dragSnapshotRight = 0;
+    }
+}
+
+void CustomTabControl::InvalidateAdornment(int index, int parts) {
+    if (m_updateDepth > 0) {
+        m_isLayoutPending = true;
+        return;
+    }
+    if (!m_hWnd || index < 0 || index >= m_layout.GetTabCount()) {
+        return;
+    }
+    InvalidateDragSnapshot();
+    TabRect tabRect = m_layout.GetTabRect(index);
+    RECT rcParts[2];
+    int count = 0;
+    if (parts & TAB_ADORN_PROGRESS) {
+        RECT rc = ToRECT(tabRect);
+        rc.top = rc.bottom - MulDiv(ADORNMENT_BAR_HEIGHT, m_dpi, 96);
+        rcParts[count++] = rc;
+    }
+    if (parts & TAB_ADORN_STATUS) {
+        rcParts[count++] = ToRECT(m_layout.GetCloseButtonRect(tabRect));
+    }
+    for (int i = 0; i < count; ++i) {
+        RECT rc = rcParts[i];
+        rc.left = max(rc.left, 0L);
+        rc.right = min(rc.right, (LONG)m_layout.GetViewWidth());
+        if (rc.left < rc.right) {
+            InvalidateRect(m_hWnd, &rc, FALSE);
+        }
+    }
+}
+
+void CustomTabControl::InvalidateScrollButtons() {
+    if (!m_hWnd || !m_layout.HasScrollButtons()) {
+        return;
+    }
+    RECT rc = ToRECT(m_layout.GetScrollLeftRect());
+    rc.right = m_layout.GetClientWidth();
+    InvalidateRect(m_hWnd, &rc, FALSE);
+}
+
+void CustomTabControl::SmoothScrollBy(int delta) {
+    if (!m_animator.IsEnabled()) {
+        m_layout.ScrollBy(delta);
+        InvalidateRect(m_hWnd, NULL, FALSE);
+        return;
+    }
+    m_animator.ScrollBy(delta, m_layout.GetScrollOffset(), m_layout.GetMaxScrollOffset(), GetAnimationTime());
+    StartAnimation();
+}
+
+void CustomTabControl::UpdateAutoScroll(int x) {
+    // ドラッグ中にタブ列の端に近づくほど速くスクロールする
+    double velocity = 0.0;
+    if (m_layout.HasScrollButtons()) {
+        int zone = MulDiv(AUTO_SCROLL_ZONE, m_dpi, 96);
+        int speed = MulDiv(AUTO_SCROLL_SPEED, m_dpi, 96);
+        int viewWidth = m_layout.GetViewWidth();
+        if (x < zone) {
+            velocity = -(double)speed * min(zone - x, zone) / zone;
+        }
+        else if (x > viewWidth - zone) {
+            velocity = (double)speed * min(x - (viewWidth - zone), zone) / zone;
+        }
+    }
+    m_animator.SetAutoScrollVelocity(velocity, GetAnimationTime());
+    if (velocity != 0.0) {
+        StartAnimation();
+    }
+}
+
+void CustomTabControl::SetHoveredTab(int index) {
+    if (index == m_hoveredTab) {
+        return;
+    }
+    if (m_isDragging) {
+        // ドラッグ中のタブ列はスナップショットなのでフェードしない
+        m_hoveredTab = index;
+        return;
+    }
+    double now = GetAnimationTime();
+    m_animator.SetHover(m_hoveredTab, false, now);
+    m_animator.SetHover(index, true, now);
+    m_hoveredTab = index;
+    if (m_animator.IsAnimating()) {
+        StartAnimation();
+    }
+}
+
+int CustomTabControl::GetFrameInterval() const {
+    // 画面のリフレッシュレートに合わせる。ただし SetTimer の分解能は約 15.6ms なので、
+    // これより短くしても 64Hz ほどにしかならない。アニメーションは m_framePacer で合成に合わせる
+    int refreshRate = 60;
+    HDC hdc = GetDC(m_hWnd);
+    if (hdc) {
+        int rate = GetDeviceCaps(hdc, VREFRESH);
+        if (rate > 1) {
+            refreshRate = rate;
+        }
+        ReleaseDC(m_hWnd, hdc);
+    }
+    return max(1, 1000 / refreshRate);
+}
+
+void CustomTabControl::StartAnimation() {
+    if (m_isAnimationRunning || !m_hWnd) {
+        return;
     }
-    int tabHeight = MulDiv(FONT_SIZE, m_dpi, 72) + MulDiv(TAB_PADDING_Y * 2, m_dpi, 96);
-    int closeBtnW = tabHeight;
-    int tabPaddingX = MulDiv(TAB_PADDING_X, m_dpi, 96);
+    m_isAnimationRunning = true;
+    m_framePacer.Start();
+}
+
+void CustomTabControl::StopAnimation() {
+    if (m_isAnimationRunning) {
+        m_isAnimationRunning = false;
+        if (!m_isAdornmentRunning) {
+            m_framePacer.Pause();
+        }
+    }
+}
+
+void CustomTabControl::OnAnimationFrame() {
+    // このフレームの変化をまとめて無効化し、WM_PAINT 1 回で描く
+    int oldOffset = m_layout.GetScrollOffset();
+    if (m_animator.Tick(GetAnimationTime(), oldOffset, m_layout.GetMaxScrollOffset())) {
+        m_layout.SetScrollOffset(m_animator.GetScrollOffset());
+    }
+    if (m_layout.GetScrollOffset() != oldOffset) {
+        if (m_isDragging) {
+            // カーソルが止まっていてもタブが動くので挿入位置を求め直す
+            SetHoveredTab(HitTest(m_lastMousePos.x, m_lastMousePos.y, NULL, NULL, NULL));
+        }
+        InvalidateRect(m_hWnd, NULL, FALSE);
+    }
+    else {
+        for (int index : m_animator.GetFadedTabs()) {
+            InvalidateTab(index);
+        }
+    }
+    if (!m_animator.IsAnimating()) {
+        StopAnimation();
+    }
+}
+
+void CustomTabControl::OnTabUpdatesPosted() {
+    // 通知は取り出すまで次が来ないので、1 フレーム待つ間に届いた変更もまとめて反映できる
+    SetTimer(m_hWnd, TAB_UPDATES_TIMER_ID, GetFrameInterval(), NULL);
+}
+
+void CustomTabControl::ApplyTabUpdates() {
+    m_updates.Drain(m_drainedUpdates);
+    if (m_drainedUpdates.empty()) {
+        return;
+    }
+    // レイアウトと再描画は EndUpdate の 1 回だけ
+    BeginUpdate();
+    for (size_t i = 0; i < m_drainedUpdates.size(); ++i) {
+        TabUpdate& update = m_drainedUpdates[i];
+        if (update.type == TAB_UPDATE_ADD) {
+            // 積んだ後に仮想モードに切り替わっていたら AddTab は何もしない (PostAddTab の説明を参照)
+            m_layout.AddTab(update.title, update.userData, update.id);
+            RecalculateTabPositions();
+            RefreshOverflowList();
+            continue;
+        }
+        int index = m_layout.FindTab(update.id);
+        if (index == -1) {
+            // 先に閉じられたタブ
+            continue;
+        }
+        switch (update.type) {
+        case TAB_UPDATE_REMOVE:
+            RemoveTab(index);
+            break;
+        case TAB_UPDATE_RENAME:
+            RenameTab(index, update.title);
+            break;
+        case TAB_UPDATE_USER_DATA:
+            SetTabUserData(index, (LPARAM)update.userData);
+            break;
+        case TAB_UPDATE_ADORNMENT:
+            SetTabAdornment(update.id, update.adornment);
+            break;
+        default:
+            break;
+        }
+    }
+    EndUpdate();
+    // 文字列はすぐに解放し、配列の領域だけを次のフレームで使い回す
+    m_drainedUpdates.clear();
+}
+
+void CustomTabControl::OnAdornmentFrame() {
+    // このフレームまでの変更をまとめ、変わった部分だけを無効化する
+    m_adornments.CollectDirty(m_dirtyAdornments);
+    for (size_t i = 0; i < m_dirtyAdornments.size(); ++i) {
+        InvalidateAdornment(m_layout.FindTab(m_dirtyAdornments[i].key), m_dirtyAdornments[i].parts);
+    }
+    if (!m_adornments.IsAnimating()) {
+        m_isAdornmentRunning = false;
+        if (!m_isAnimationRunning) {
+            m_framePacer.Pause();
+        }
+    }
+}
 
+void CustomTabControl::StartIdleMeasure() {
+    if (m_hWnd && m_layout.HasIdleMeasure()) {
+        SetTimer(m_hWnd, IDLE_MEASURE_TIMER_ID, IDLE_MEASURE_INTERVAL, NULL);
+    }
+}
+
+void CustomTabControl::OnIdleMeasureTimer() {
+    if (m_updateDepth > 0) {
+        // 計測は EndUpdate の後に回す
+        return;
+    }
+    // 1 回の時間を区切り、入力や描画を待たせない
+    double deadline = GetAnimationTime() + IDLE_MEASURE_TIME_SLICE;
+    bool hasMore = true;
+    bool isChanged = false;
+    while (hasMore && GetAnimationTime() < deadline) {
+        bool isBatchChanged = false;
+        hasMore = m_layout.MeasureIdle(IDLE_MEASURE_BATCH, &isBatchChanged);
+        isChanged = isChanged || isBatchChanged;
+    }
+    if (!hasMore) {
+        KillTimer(m_hWnd, IDLE_MEASURE_TIMER_ID);
+    }
+    if (isChanged) {
+        RecalculateTabPositions();
+    }
+}
+
+int CustomTabControl::GetTabWidth(int index) const {
+    TAB_STAT_SCOPE(m_stats, TAB_STAT_GET_TAB_WIDTH);
+    return m_layout.GetTabWidth(index);
+}
+
+UINT64 CustomTabControl::GetTabKey(int index) const {
+    return m_layout.GetTabKey(index);
+}
+
+int CustomTabControl::MeasureText(const std::wstring& text) {
+    TAB_STAT_SCOPE(m_stats, TAB_STAT_MEASURE_TEXT);
     HDC hdc = GetDC(m_hWnd);
-    SelectObject(hdc, m_hFont);
+    HFONT hOldFont = (HFONT)SelectObject(hdc, m_hFont);
     SIZE size;
-    GetTextExtentPoint32W(hdc, m_tabTitles[index].c_str(), (int)m_tabTitles[index].length(), &size);
+    GetTextExtentPoint32W(hdc, text.c_str(), (int)text.length(), &size);
+    SelectObject(hdc, hOldFont);
     ReleaseDC(m_hWnd, hdc);
-
-    return size.cx + tabPaddingX + closeBtnW;
+    return size.cx;
 }
 
 void CustomTabControl::CreateDragWindow(int tabIndex) {
@@ -809,7 +1637,7 @@ void CustomTabControl::CreateDragWindow(int tabIndex) {
     GetCursorPos(&ptCursor);
 
     int tabWidth = GetTabWidth(tabIndex);
-    int tabHeight = MulDiv(FONT_SIZE, m_dpi, 72) + MulDiv(TAB_PADDING_Y * 2, m_dpi, 96);
+    int tabHeight = m_layout.GetTabHeight();
 
     m_hDragWnd = CreateWindowExW(
         WS_EX_LAYERED | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
@@ -833,11 +1661,9 @@ void CustomTabControl::CreateDragWindow(int tabIndex) {
         HBITMAP hbmOld = (HBITMAP)SelectObject(hdcMem, hbmTab);
 
         RECT rc = { 0, 0, tabWidth, tabHeight };
-        HBRUSH hClearBrush = CreateSolidBrush(m_clrBg);
-        FillRect(hdcMem, &rc, hClearBrush);
-        DeleteObject(hClearBrush);
+        FillRect(hdcMem, &rc, m_gdiCache.GetBrush(m_clrBg));
 
-        DrawTab(hdcMem, tabIndex, rc, true, false, false);
+        DrawTab(hdcMem, tabIndex, rc, true, 0.0f, false);
 
         POINT ptZero = { 0, 0 };
         SIZE sizeTab = { tabWidth, tabHeight };
@@ -857,40 +1683,146 @@ void CustomTabControl::DestroyDragWindow() {
     }
 }
 
+void CustomTabControl::RenderDragSnapshot(int contentLeft, int contentRight) {
+    int tabHeight = m_layout.GetTabHeight();
+    HDC hdcRef = GetDC(m_hWnd);
+    bool ok = m_dragSnapshot.Ensure(hdcRef, contentRight - contentLeft, tabHeight);
+    ReleaseDC(m_hWnd, hdcRef);
+    if (!ok) {
+        m_dragSnapshotLeft = m_dragSnapshotRight = 0;
+        return;
+    }
+
+    HDC hdc = m_dragSnapshot.GetDC();
+    RECT rcFill = { 0, 0, contentRight - contentLeft, tabHeight };
+    FillRect(hdc, &rcFill, m_gdiCache.GetBrush(m_clrBg));
+
+    // ドラッグ中のタブはドラッグウィンドウに描くので、ここには描かない
+    int scrollOffset = m_layout.GetScrollOffset();
+    int firstTab = 0;
+    int lastTab = -1;
+    m_layout.GetTabsInRange(contentLeft - scrollOffset, contentRight - scrollOffset, &firstTab, &lastTab);
+    for (int i = firstTab; i <= lastTab; ++i) {
+        if (i == m_draggedTabIndex) {
+            continue;
+        }
+        int x = m_layout.GetTabOffset(i) - contentLeft;
+        RECT tabRect = { x, 0, x + GetTabWidth(i), tabHeight };
+        DrawTab(hdc, i, tabRect, i == m_selectedTab, 0.0f, false);
+        m_lastPaintTabCount++;
+    }
+    m_dragSnapshotLeft = contentLeft;
+    m_dragSnapshotRight = contentRight;
+}
+
+void CustomTabControl::ComposeDragSnapshot(HDC hdc, const RECT& rcClip) {
+    int scrollOffset = m_layout.GetScrollOffset();
+    int viewWidth = m_layout.GetViewWidth();
+    int totalWidth = m_layout.GetTotalWidth();
+    int draggedWidth = GetTabWidth(m_draggedTabIndex);
+
+    // ずれた分も含めて表示に必要な範囲がなければ、前後に 1 画面分の余裕を持たせて描き直す
+    int needLeft = max(0, scrollOffset - draggedWidth);
+    int needRight = min(totalWidth, scrollOffset + viewWidth + draggedWidth);
+    if (needLeft >= needRight) {
+        return;
+    }
+    if (needLeft < m_dragSnapshotLeft || needRight > m_dragSnapshotRight) {
+        RenderDragSnapshot(max(0, scrollOffset - viewWidth), min(totalWidth, scrollOffset + viewWidth * 2));
+        if (needLeft < m_dragSnapshotLeft || needRight > m_dragSnapshotRight) {
+            return;
+        }
+    }
+
+    // GetDragShift と同じく、ずれるのはドラッグ中のタブと挿入位置の間の連続した範囲だけ。
+    // ずれない前後の範囲とずれる範囲を、それぞれ 1 回の BitBlt で貼る
+    struct Segment {
+        int left;
+        int right;
+        int shift;
+    };
+    int dragged = m_draggedTabIndex;
+    int target = max(m_hoveredTab, 0);
+    int draggedLeft = m_layout.GetTabOffset(dragged);
+    int draggedRight = draggedLeft + draggedWidth;
+    Segment segments[3] = { { 0, draggedLeft, 0 }, { draggedRight, totalWidth, 0 }, { 0, 0, 0 } };
+    if (dragged < target) {
+        int targetRight = m_layout.GetTabOffset(target + 1);
+        segments[1] = { draggedRight, targetRight, -draggedWidth };
+        segments[2] = { targetRight, totalWidth, 0 };
+    }
+    else if (dragged > target) {
+        int targetLeft = m_layout.GetTabOffset(target);
+        segments[0] = { 0, targetLeft, 0 };
+        segments[1] = { targetLeft, draggedLeft, draggedWidth };
+        segments[2] = { draggedRight, totalWidth, 0 };
+    }
+
+    int tabHeight = m_layout.GetTabHeight();
+    HDC hdcSnapshot = m_dragSnapshot.GetDC();
+    for (const Segment& segment : segments) {
+        int destLeft = max((int)rcClip.left, segment.left - scrollOffset + segment.shift);
+        int destRight = min((int)rcClip.right, segment.right - scrollOffset + segment.shift);
+        if (destLeft >= destRight) {
+            continue;
+        }
+        int srcLeft = destLeft + scrollOffset - segment.shift - m_dragSnapshotLeft;
+        BitBlt(hdc, destLeft, 0, destRight - destLeft, tabHeight, hdcSnapshot, srcLeft, 0, SRCCOPY);
+    }
+}
+
+void CustomTabControl::InvalidateDragSpan(int oldTarget, int newTarget) {
+    if (m_updateDepth > 0) {
+        m_isLayoutPending = true;
+        return;
+    }
+    if (m_layout.IsMultiRow()) {
+        // 複数行モードではタブをずらさないが、挿入位置の行をまたぐので全体を描き直す
+        InvalidateRect(m_hWnd, NULL, FALSE);
+        return;
+    }
+    // 挿入位置が old から new に変わると、その間のタブだけがドラッグ中のタブの幅だけ動く
+    int tabCount = m_layout.GetTabCount();
+    int lo = min(max(min(oldTarget, newTarget), 0), tabCount - 1);
+    int hi = min(max(max(oldTarget, newTarget), 0), tabCount - 1);
+    int draggedWidth = GetTabWidth(m_draggedTabIndex);
+    int scrollOffset = m_layout.GetScrollOffset();
+    RECT rc = { 0, 0, 0, m_layout.GetTabHeight() };
+    rc.left = max(0, m_layout.GetTabOffset(lo) - draggedWidth - scrollOffset);
+    rc.right = min(m_layout.GetViewWidth(), m_layout.GetTabOffset(hi + 1) + draggedWidth - scrollOffset);
+    if (rc.left < rc.right) {
+        InvalidateRect(m_hWnd, &rc, FALSE);
+    }
+}
+
 void CustomTabControl::DrawDragWindow(HDC hdc) {
-    if (m_draggedTabIndex < 0 || m_draggedTabIndex >= m_tabTitles.size()) {
+    if (m_draggedTabIndex < 0 || m_draggedTabIndex >= m_layout.GetTabCount()) {
         return;
     }
 
-    int tabHeight = MulDiv(FONT_SIZE, m_dpi, 72) + MulDiv(TAB_PADDING_Y * 2, m_dpi, 96);
-    int closeBtnW = tabHeight;
-    int tabPaddingX = MulDiv(TAB_PADDING_X, m_dpi, 96);
+    int closeBtnW = m_layout.GetCloseButtonWidth();
 
     RECT rc;
     GetClientRect(m_hDragWnd, &rc);
     int tabWidth = rc.right;
 
-    HBRUSH hBrush = CreateSolidBrush(m_clrActiveTab);
-    FillRect(hdc, &rc, hBrush);
-    DeleteObject(hBrush);
+    FillRect(hdc, &rc, m_gdiCache.GetBrush(m_clrActiveTab));
 
     SetBkMode(hdc, TRANSPARENT);
     SetTextColor(hdc, m_clrText);
-    SelectObject(hdc, m_hFont);
+    HFONT hOldFont = (HFONT)SelectObject(hdc, m_hFont);
 
     RECT rcText = rc;
     rcText.left += MulDiv(TAB_PADDING_X, m_dpi, 96) / 2;
     rcText.right -= closeBtnW;
-    DrawTextW(hdc, m_tabTitles[m_draggedTabIndex].c_str(), -1, &rcText, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_END_ELLIPSIS);
+    m_textCache.Draw(hdc, GetTabKey(m_draggedTabIndex), m_layout.GetTitle(m_draggedTabIndex), rcText);
 
     int closeBtnX = tabWidth - closeBtnW;
     RECT rcCloseRect = { closeBtnX, rc.top, rc.right, rc.bottom };
-    HBRUSH hCloseBrush = CreateSolidBrush(RGB(96, 96, 96));
-    FillRect(hdc, &rcCloseRect, hCloseBrush);
-    DeleteObject(hCloseBrush);
+    FillRect(hdc, &rcCloseRect, m_gdiCache.GetBrush(RGB(96, 96, 96)));
 
     COLORREF oldTextColor = SetTextColor(hdc, RGB(255, 255, 255));
-    HPEN hClosePen = CreatePen(PS_SOLID, 1, RGB(255, 255, 255));
+    HPEN hClosePen = m_gdiCache.GetPen(RGB(255, 255, 255));
     HPEN hOldClosePen = (HPEN)SelectObject(hdc, hClosePen);
 
     int crossPadding = MulDiv(8, m_dpi, 96);
@@ -903,25 +1835,45 @@ void CustomTabControl::DrawDragWindow(HDC hdc) {
 
     SetTextColor(hdc, oldTextColor);
     SelectObject(hdc, hOldClosePen);
-    DeleteObject(hClosePen);
+    SelectObject(hdc, hOldFont);
 }
 
 void CustomTabControl::ShowCustomTooltip(int index, int x, int y) {
-    if (!m_hPopupWnd || index < 0 || index >= (int)m_tabTitles.size()) {
+    if (!m_hPopupWnd || index < 0 || index >= m_layout.GetTabCount()) {
         return;
     }
 
-    m_popupText = m_tabTitles[index];
+    const std::wstring& title = m_layout.GetTitle(index);
+
+    // テキストサイズを計算。長すぎるパスや URL は中央を省略して収める。
+    // 同じタブに何度もホバーしたときは計り直さない
+    if (title != m_popupTitle || m_popupTitle.empty()) {
+        HDC hdc = GetDC(m_hPopupWnd);
+        HFONT hOldFont = (HFONT)SelectObject(hdc, m_hFont);
+        std::vector<int> prefix(title.length() + 1, 0);
+        SIZE ellipsisSize;
+        const WCHAR szEllipsis[] = { TAB_ELLIPSIS_CHAR, 0 };
+        GetTextExtentPoint32W(hdc, szEllipsis, 1, &ellipsisSize);
+        GetTextExtentExPointW(hdc, title.c_str(), (int)title.length(), 0, NULL, prefix.data() + 1, &m_popupTextSize);
+        if (FitTitleToWidth(title, prefix.data(), ellipsisSize.cx, MulDiv(TOOLTIP_MAX_TEXT_WIDTH, m_dpi, 96), TAB_ELLIPSIS_MIDDLE, m_popupText)) {
+            GetTextExtentPoint32W(hdc, m_popupText.c_str(), (int)m_popupText.length(), &m_popupTextSize);
+        }
+        SelectObject(hdc, hOldFont);
+        ReleaseDC(m_hPopupWnd, hdc);
+        m_popupTitle = title;
+    }
 
-    // テキストサイズを計算
-    HDC hdc = GetDC(m_hPopupWnd);
-    SelectObject(hdc, m_hFont);
-    SIZE size;
-    GetTextExtentPoint32W(hdc, m_popupText.c_str(), (int)m_popupText.length(), &size);
-    ReleaseDC(m_hPopupWnd, hdc);
+    m_popupWidth = m_popupTextSize.cx + 20; // 左右に10ピクセルのパディング
+    m_popupHeight = m_popupTextSize.cy + 10; // 上下に5ピクセルのパディング
 
-    m_popupWidth = size.cx + 20; // 左右に10ピクセルのパディング
-    m_popupHeight = size.cy + 10; // 上下に5ピクセルのパディング
+    // サムネイルはワーカースレッドで用意する。届くまでは枠だけ出しておく
+    m_hasPopupThumbnail = m_thumbnails.GetProvider() != nullptr;
+    if (m_hasPopupThumbnail) {
+        m_popupThumbnailKey = GetTabKey(index);
+        m_thumbnails.Request(m_popupThumbnailKey);
+        m_popupWidth = std::max(m_popupWidth, MulDiv(THUMBNAIL_WIDTH, m_dpi, 96) + 20);
+        m_popupHeight += MulDiv(THUMBNAIL_HEIGHT, m_dpi, 96) + 10;
+    }
 
     // ポップアップ位置を計算（クライアント座標からスクリーン座標へ）
     POINT pt = { x, y };
@@ -938,6 +1890,84 @@ void CustomTabControl::ShowCustomTooltip(int index, int x, int y) {
     InvalidateRect(m_hPopupWnd, NULL, TRUE);
 }
 
+void CustomTabControl::SetMultiRow(bool multiRow) {
+    m_layout.SetMultiRow(multiRow);
+    RecalculateTabPositions();
+}
+
+bool CustomTabControl::IsMultiRow() const {
+    return m_layout.IsMultiRow();
+}
+
+int CustomTabControl::GetRequiredHeight() const {
+    return m_layout.GetRequiredHeight();
+}
+
+void CustomTabControl::SetEllipsisMode(TabEllipsisMode mode) {
+    m_textCache.SetEllipsisMode(mode);
+    m_softRenderer.SetEllipsisMode(mode);
+    InvalidateRect(m_hWnd, NULL, FALSE);
+}
+
+void CustomTabControl::DrawPopupThumbnail(HDC hdc, const RECT& rect) {
+    const TabThumbnailImage* image = m_thumbnails.Find(m_popupThumbnailKey);
+    if (!image) {
+        FillRect(hdc, &rect, m_gdiCache.GetBrush(m_clrActiveTab));
+        return;
+    }
+    // 縮小済みの画像を中央に転送するだけ
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = image->width;
+    bmi.bmiHeader.biHeight = -image->height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    int x = rect.left + (rect.right - rect.left - image->width) / 2;
+    int y = rect.top + (rect.bottom - rect.top - image->height) / 2;
+    SetDIBitsToDevice(hdc, x, y, image->width, image->height, 0, 0, 0, image->height,
+        image->pixels.data(), &bmi, DIB_RGB_COLORS);
+}
+
+void CustomTabControl::OnThumbnailReady() {
+    m_thumbnails.CollectResults();
+    if (m_isPopupVisible && m_hasPopupThumbnail && m_thumbnails.Find(m_popupThumbnailKey)) {
+        InvalidateRect(m_hPopupWnd, NULL, FALSE);
+    }
+}
+
+void CustomTabControl::SetThumbnailProvider(ITabThumbnailProvider* provider) {
+    m_thumbnails.SetProvider(provider);
+}
+
+void CustomTabControl::SetThumbnailCacheBudget(size_t bytes) {
+    m_thumbnails.SetBudget(bytes);
+}
+
+void CustomTabControl::SetMeasureCacheBudget(size_t bytes) {
+    m_layout.SetMeasureCacheBudget(bytes);
+}
+
+void CustomTabControl::SetSoftwareRendering(bool enable) {
+    m_isSoftwareRendering = enable;
+    InvalidateRect(m_hWnd, NULL, FALSE);
+}
+
+bool CustomTabControl::IsSoftwareRendering() const {
+    return m_isSoftwareRendering;
+}
+
+void CustomTabControl::ClearVirtualThumbnails() {
+    // 仮想モードのサムネイルはインデックスをキーにしているので、ずれた後の画像は別のタブのもの
+    if (m_layout.GetDataSource()) {
+        m_thumbnails.Clear();
+    }
+}
+
+void CustomTabControl::InvalidateTabThumbnail(UINT64 id) {
+    m_thumbnails.Invalidate(id);
+}
+
 void CustomTabControl::HideCustomTooltip() {
     if (m_hPopupWnd && m_isPopupVisible) {
         ShowWindow(m_hPopupWnd, SW_HIDE);
@@ -945,34 +1975,322 @@ void CustomTabControl::HideCustomTooltip() {
     }
 }
 
-// テーマの変更に応じて色を更新する関数
-void CustomTabControl::UpdateTheme(BOOL bIsDarkMode) {
-    if (bIsDarkMode) {
-        m_clrBg = RGB(32, 32, 32);
-        m_clrText = RGB(220, 220, 220);
-        m_clrActiveTab = RGB(50, 50, 50);
-        m_clrSeparator = RGB(60, 60, 60);
-        m_clrCloseText = RGB(150, 150, 150);
-        m_clrHoverBg = RGB(45, 45, 45);
-        m_clrCloseButtonHoverBg = RGB(96, 96, 96);
-        m_clrScrollButtonHoverBg = RGB(60, 60, 60);
-        m_clrTooltipBg = RGB(50, 50, 50);
-        m_clrTooltipText = RGB(255, 255, 255);
+LRESULT CALLBACK CustomTabControl::OverflowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    CustomTabControl* pThis = reinterpret_cast<CustomTabControl*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+    if (pThis) {
+        switch (uMsg) {
+        case WM_COMMAND:
+            if (LOWORD(wParam) == IDC_OVERFLOW_EDIT && HIWORD(wParam) == EN_CHANGE) {
+                pThis->UpdateOverflowFilter();
+            }
+            else if (LOWORD(wParam) == IDC_OVERFLOW_LIST && HIWORD(wParam) == LBN_SELCHANGE) {
+                // キー操作はエディットで受けて LB_SETCURSEL するので、ここに来るのはクリックだけ
+                pThis->ActivateOverflowItem((int)SendMessage(pThis->m_hOverflowList, LB_GETCURSEL, 0, 0));
+            }
+            return 0;
+        case WM_DRAWITEM:
+            pThis->DrawOverflowItem(reinterpret_cast<const DRAWITEMSTRUCT*>(lParam));
+            return TRUE;
+        case WM_CTLCOLOREDIT:
+            SetTextColor((HDC)wParam, pThis->m_clrText);
+            SetBkColor((HDC)wParam, pThis->m_clrActiveTab);
+            return (LRESULT)pThis->m_gdiCache.GetBrush(pThis->m_clrActiveTab);
+        case WM_CTLCOLORLISTBOX:
+            return (LRESULT)pThis->m_gdiCache.GetBrush(pThis->m_clrBg);
+        case WM_ACTIVATE:
+            if (LOWORD(wParam) == WA_INACTIVE) {
+                PostMessage(hWnd, WM_CLOSE, 0, 0);
+            }
+            return 0;
+        case WM_DESTROY:
+            pThis->m_hOverflowWnd = NULL;
+            pThis->m_hOverflowEdit = NULL;
+            pThis->m_hOverflowList = NULL;
+            if (pThis->m_hWnd) {
+                pThis->InvalidateScrollButtons();
+            }
+            break;
+        }
+    }
+    return DefWindowProcW(hWnd, uMsg, wParam, lParam);
+}
+
+LRESULT CALLBACK CustomTabControl::OverflowEditProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    CustomTabControl* pThis = reinterpret_cast<CustomTabControl*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+    if (uMsg == WM_KEYDOWN) {
+        int count = (int)SendMessage(pThis->m_hOverflowList, LB_GETCOUNT, 0, 0);
+        int cur = (int)SendMessage(pThis->m_hOverflowList, LB_GETCURSEL, 0, 0);
+        int next = cur;
+        switch (wParam) {
+        case VK_DOWN: next = cur + 1; break;
+        case VK_UP: next = cur - 1; break;
+        case VK_NEXT: next = cur + OVERFLOW_VISIBLE_ITEMS; break;
+        case VK_PRIOR: next = cur - OVERFLOW_VISIBLE_ITEMS; break;
+        case VK_RETURN:
+            pThis->ActivateOverflowItem(cur);
+            return 0;
+        case VK_ESCAPE:
+            pThis->HideOverflowList();
+            return 0;
+        default:
+            return CallWindowProcW(pThis->m_pfnOverflowEditProc, hWnd, uMsg, wParam, lParam);
+        }
+        if (count > 0) {
+            SendMessage(pThis->m_hOverflowList, LB_SETCURSEL, min(max(next, 0), count - 1), 0);
+        }
+        return 0;
+    }
+    if (uMsg == WM_CHAR && (wParam == VK_RETURN || wParam == VK_ESCAPE)) {
+        return 0; // 確定・取り消しの音を鳴らさない
+    }
+    return CallWindowProcW(pThis->m_pfnOverflowEditProc, hWnd, uMsg, wParam, lParam);
+}
+
+void CustomTabControl::ShowOverflowList() {
+    if (m_hOverflowWnd || !m_hWnd) {
+        return;
+    }
+
+    // 検索の索引は文字を打ったときに作る。開くだけなら仮想モードでもタイトルを問い合わせない
+    m_searchIndex.Clear();
+    m_hasSearchIndex = false;
+    m_isOverflowFiltered = false;
+
+    int width = MulDiv(OVERFLOW_LIST_WIDTH, m_dpi, 96);
+    int editHeight = m_layout.GetTabHeight();
+    int itemHeight = MulDiv(OVERFLOW_ITEM_HEIGHT, m_dpi, 96);
+    int listHeight = itemHeight * OVERFLOW_VISIBLE_ITEMS;
+
+    RECT rcButton = ToRECT(m_layout.GetOverflowButtonRect());
+    POINT pt = { rcButton.right - width, rcButton.bottom };
+    ClientToScreen(m_hWnd, &pt);
+
+    m_hOverflowWnd = CreateWindowExW(
+        WS_EX_TOOLWINDOW, s_szOverflowClassName, L"",
+        WS_POPUP | WS_BORDER,
+        pt.x, pt.y, width, editHeight + listHeight,
+        GetAncestor(m_hWnd, GA_ROOT), NULL, GetModuleHandle(NULL), NULL
+    );
+    if (!m_hOverflowWnd) {
+        return;
+    }
+    SetWindowLongPtr(m_hOverflowWnd, GWLP_USERDATA, (LONG_PTR)this);
+
+    RECT rcClient;
+    GetClientRect(m_hOverflowWnd, &rcClient);
+    m_hOverflowEdit = CreateWindowExW(0, L"EDIT", L"", WS_CHILD | WS_VISIBLE | ES_AUTOHSCROLL,
+        0, 0, rcClient.right, editHeight, m_hOverflowWnd, (HMENU)IDC_OVERFLOW_EDIT, GetModuleHandle(NULL), NULL);
+    // 件数が多くても文字列を持たないよう LBS_NODATA のオーナードローにする
+    m_hOverflowList = CreateWindowExW(0, L"LISTBOX", L"",
+        WS_CHILD | WS_VISIBLE | WS_VSCROLL | LBS_NODATA | LBS_OWNERDRAWFIXED | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT,
+        0, editHeight, rcClient.right, rcClient.bottom - editHeight, m_hOverflowWnd, (HMENU)IDC_OVERFLOW_LIST, GetModuleHandle(NULL), NULL);
+    if (!m_hOverflowEdit || !m_hOverflowList) {
+        HideOverflowList();
+        return;
+    }
+    SendMessage(m_hOverflowEdit, WM_SETFONT, (WPARAM)m_hFont, FALSE);
+    SendMessage(m_hOverflowList, LB_SETITEMHEIGHT, 0, itemHeight);
+    SetWindowLongPtr(m_hOverflowEdit, GWLP_USERDATA, (LONG_PTR)this);
+    m_pfnOverflowEditProc = (WNDPROC)SetWindowLongPtr(m_hOverflowEdit, GWLP_WNDPROC, (LONG_PTR)OverflowEditProc);
+
+    UpdateOverflowFilter();
+    ShowWindow(m_hOverflowWnd, SW_SHOW);
+    SetFocus(m_hOverflowEdit);
+    InvalidateScrollButtons();
+}
+
+void CustomTabControl::HideOverflowList() {
+    if (m_hOverflowWnd) {
+        DestroyWindow(m_hOverflowWnd);
+    }
+}
+
+void CustomTabControl::UpdateOverflowFilter() {
+    if (!m_hOverflowEdit || !m_hOverflowList) {
+        return;
+    }
+    std::wstring query(GetWindowTextLengthW(m_hOverflowEdit), L'\0');
+    if (!query.empty()) {
+        GetWindowTextW(m_hOverflowEdit, &query[0], (int)query.size() + 1);
+    }
+    int count = 0;
+    if (query.empty()) {
+        // 空のクエリは全件を元の順番で出すだけなので索引はいらない (描くときに見える項目のタイトルだけ取る)
+        m_isOverflowFiltered = false;
+        count = m_layout.GetTabCount();
     }
     else {
-        m_clrBg = RGB(220, 220, 220);
-        m_clrText = RGB(32, 32, 32);
-        m_clrActiveTab = RGB(240, 240, 240);
-        m_clrSeparator = RGB(200, 200, 200);
-        m_clrCloseText = RGB(100, 100, 100);
-        m_clrHoverBg = RGB(230, 230, 230);
-        m_clrCloseButtonHoverBg = RGB(200, 200, 200);
-        m_clrScrollButtonHoverBg = RGB(220, 220, 220);
-        m_clrTooltipBg = RGB(250, 250, 250);
-        m_clrTooltipText = RGB(32, 32, 32);
-    }
-    InvalidateRect(m_hWnd, NULL, TRUE);
+        if (!m_hasSearchIndex) {
+            // 開いている間の検索用に、タイトルを小文字化して詰めておく
+            int tabCount = m_layout.GetTabCount();
+            m_searchIndex.Reserve(tabCount, 0);
+            for (int i = 0; i < tabCount; ++i) {
+                m_searchIndex.AddTitle(m_layout.GetTitle(i));
+            }
+            m_hasSearchIndex = true;
+        }
+        m_isOverflowFiltered = true;
+        count = (int)m_searchIndex.Search(query).size();
+    }
+    SendMessage(m_hOverflowList, LB_SETCOUNT, count, 0);
+    SendMessage(m_hOverflowList, LB_SETCURSEL, count == 0 ? -1 : 0, 0);
+}
+
+void CustomTabControl::RefreshOverflowList() {
+    if (!m_hOverflowList) {
+        return;
+    }
+    if (m_updateDepth > 0) {
+        m_isOverflowRefreshPending = true;
+        return;
+    }
+    // 索引は古いタイトルとインデックスのままなので捨てる。絞り込み中なら UpdateOverflowFilter がすぐ作り直す
+    m_searchIndex.Clear();
+    m_hasSearchIndex = false;
+    int cur = (int)SendMessage(m_hOverflowList, LB_GETCURSEL, 0, 0);
+    UpdateOverflowFilter();
+    int count = (int)SendMessage(m_hOverflowList, LB_GETCOUNT, 0, 0);
+    if (cur > 0 && count > 0) {
+        SendMessage(m_hOverflowList, LB_SETCURSEL, min(cur, count - 1), 0);
+    }
+    InvalidateRect(m_hOverflowList, NULL, FALSE);
+}
+
+int CustomTabControl::GetOverflowTabIndex(int item) const {
+    int index = item;
+    if (m_isOverflowFiltered) {
+        const std::vector<int>& results = m_searchIndex.GetResults();
+        index = item >= 0 && item < (int)results.size() ? results[item] : -1;
+    }
+    return index >= 0 && index < m_layout.GetTabCount() ? index : -1;
+}
+
+void CustomTabControl::ActivateOverflowItem(int item) {
+    int index = GetOverflowTabIndex(item);
+    if (index < 0) {
+        return;
+    }
+    HideOverflowList();
+    SetCurSel(index);
+}
+
+void CustomTabControl::DrawOverflowItem(const DRAWITEMSTRUCT* pDis) {
+    int index = GetOverflowTabIndex((int)pDis->itemID);
+    if (index < 0) {
+        return;
+    }
+
+    HDC hdc = pDis->hDC;
+    RECT rc = pDis->rcItem;
+    bool isSelected = (pDis->itemState & ODS_SELECTED) != 0;
+    FillRect(hdc, &rc, m_gdiCache.GetBrush(isSelected ? m_clrCloseButtonHoverBg : m_clrBg));
+
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, m_clrText);
+    HFONT hOldFont = (HFONT)SelectObject(hdc, m_hFont);
+    rc.left += MulDiv(TAB_PADDING_X / 2, m_dpi, 96);
+    rc.right -= MulDiv(TAB_PADDING_X / 2, m_dpi, 96);
+    DrawTextW(hdc, m_layout.GetTitle(index).c_str(), -1, &rc, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_END_ELLIPSIS | DT_NOPREFIX);
+    SelectObject(hdc, hOldFont);
+}
+
+// テーマの変更に応じて色を更新する関数
+void CustomTabControl::UpdateTheme(BOOL bIsDarkMode) {
+    AcquireResources(bIsDarkMode != FALSE);
+    InvalidateRect(m_hWnd, NULL, FALSE);
     if (m_hPopupWnd) {
         InvalidateRect(m_hPopupWnd, NULL, TRUE);
     }
+}
+
+void CustomTabControl::AcquireResources(bool isDarkMode) {
+    // 同じ組なら参照カウントが増えて減るだけで、作り直しはしない
+    // 前の組は、そのフォントやブラシを使う場所をすべて差し替えてから返す
+    const TabThemeResources* oldResources = m_resources;
+    m_resources = TabResourcePool::Acquire(m_dpi, isDarkMode);
+
+    const TabThemeColors& colors = m_resources->colors;
+    m_clrBg = colors.bg;
+    m_clrText = colors.text;
+    m_clrActiveTab = colors.activeTab;
+    m_clrSeparator = colors.separator;
+    m_clrCloseText = colors.closeText;
+    m_clrHoverBg = colors.hoverBg;
+    m_clrCloseButtonHoverBg = colors.closeButtonHoverBg;
+    m_clrScrollButtonHoverBg = colors.scrollButtonHoverBg;
+    m_clrTooltipBg = colors.tooltipBg;
+    m_clrTooltipText = colors.tooltipText;
+    m_clrAccent = colors.accent;
+    RebuildGdiCache();
+
+    if (m_hFont != m_resources->hFont) {
+        bool isFirstFont = (m_hFont == NULL);
+        m_hFont = m_resources->hFont;
+        if (isFirstFont) {
+            // 実際の幅はここで初めて計測する
+            SendMessage(m_hWnd, WM_SETFONT, (WPARAM)m_hFont, FALSE);
+        }
+        else {
+            // DPI が変わったときの幅は m_layout.SetDpi で入れ替えてあり、
+            // 同じ DPI の共有フォントは寸法が同じなので、計測し直さない
+            m_textCache.Invalidate();
+            m_popupTitle.clear();
+            RecalculateTabPositions();
+        }
+        if (m_hOverflowEdit) {
+            SendMessage(m_hOverflowEdit, WM_SETFONT, (WPARAM)m_hFont, TRUE);
+        }
+    }
+    m_glyphSource.SetFont(m_hFont);
+    TabResourcePool::Release(oldResources);
+}
+
+void CustomTabControl::RebuildGdiCache() {
+    // 配色のブラシ・ペンは共有リソースから借りる。ここに残るのはフェード途中の色だけ
+    m_gdiCache.Clear();
+    m_gdiCache.SetShared(&m_resources->gdiCache);
+    InvalidateDragSnapshot();
+
+    // タブの形状は DPI だけで決まる
+    m_tabShape.Build(MulDiv(TAB_ROUND_RADIUS, m_dpi, 96));
+}
+
+int CustomTabControl::GetGdiObjectCount() const {
+    return m_gdiCache.GetObjectCount();
+}
+
+TabControlStats CustomTabControl::GetStats() const {
+#ifndef TAB_STATS_DISABLED
+    return m_stats.Get();
+#else
+    TabControlStats stats = {};
+    return stats;
+#endif
+}
+
+void CustomTabControl::ResetStats() {
+#ifndef TAB_STATS_DISABLED
+    m_stats.Reset();
+#endif
+}
+
+void CustomTabControl::EnableStatsTrace(bool enable) {
+#ifndef TAB_STATS_DISABLED
+    m_stats.SetTraceEnabled(enable);
+#endif
+}
+
+bool CustomTabControl::DumpStatsTrace(LPCWSTR path) const {
+#ifndef TAB_STATS_DISABLED
+    FILE* fp = nullptr;
+    if (_wfopen_s(&fp, path, L"w") != 0 || !fp) {
+        return false;
+    }
+    bool result = m_stats.DumpTrace(fp);
+    fclose(fp);
+    return result;
+#else
+    (void)path;
+    return false;
+#endif
 }
\ No newline at end of file
@@ -2,10 +2,36 @@
 
 #include <Windows.h>
 #include <Windowsx.h>
+#include <atomic>
 #include <vector>
 #include <string>
+#include "TabLayoutEngine.h"
+#include "TabGdiCache.h"
+#include "TabBackBuffer.h"
+#include "TabShapeMask.h"
+#include "TabSearchIndex.h"
+#include "TabAnimator.h"
+#include "TabStats.h"
+#include "TabTextCache.h"
+#include "TabThumbnailCache.h"
+#include "TabFramePacer.h"
+#include "TabResourcePool.h"
+#include "TabUpdateQueue.h"
+#include "TabAdornments.h"
+#include "TabRaster.h"
+#include "TabSoftwareRenderer.h"
+#include "TabGdiGlyphSource.h"
 
-class CustomTabControl {
+// eEBhEւ WM_NOTIFYBs[hōsςARg[̍ςƂɑ
+#define CTCN_FIRST (0U - 3000U)
+#define CTCN_HEIGHTCHANGED (CTCN_FIRST - 0)
+
+struct NMCTCHEIGHT {
+    NMHDR hdr;
+    int height;
+};
+
+class CustomTabControl : private ITabTextMeasurer {
 public:
     CustomTabControl();
     ~CustomTabControl();
@@ -13,20 +39,95 @@ public:
     static void RegisterWindowClass(HINSTANCE hInstance);
     HWND Create(HWND hParent, int x, int y, int width, int height, UINT_PTR uId, BOOL IsDarkMode);
 
-    void AddTab(const std::wstring& title);
+    // ǉ^u ID ԂBID ͕בւ⑼̃^u̍폜ł͕ςȂ
+    UINT64 AddTab(const std::wstring& title, LPARAM userData = 0);
+    void AddTabs(const std::vector<std::wstring>& titles);
+    void InsertTabs(int index, const std::vector<std::wstring>& titles);
     void RemoveTab(int index);
+    void RemoveTabs(int index, int count);
     void RenameTab(int index, const std::wstring& newTitle);
+    // BeginUpdate Ή EndUpdate ܂ł̊Ԃ͌vECAEgEĕ`
+    // ۗAԊO EndUpdate  1 񂾂s
+    void BeginUpdate();
+    void EndUpdate();
+
+    // z[h (LVS_OWNERDATA )B^Cg dataSource KvȂƂ擾A
+    // Rg[̓^uB폜 RemoveTab / RemoveTabs g
+    void SetDataSource(ITabDataSource* dataSource, int count);
+    void SetVirtualTabCount(int count);
+    void NotifyTabsInserted(int index, int count);
+    // index ̃^CgςƂʒm (ʏ탂[hłg)
+    void NotifyTabChanged(int index);
     int GetCurSel() const;
     void SetCurSel(int index);
     int GetTabCount() const;
     HWND GetHwnd() const;
+    // ^u܂ԂĕsɕׂB͍sɍ킹ăRg[gςA
+    // ςe CTCN_HEIGHTCHANGED 𑗂
+    void SetMultiRow(bool multiRow);
+    bool IsMultiRow() const;
+    int GetRequiredHeight() const;
     void SwitchTabOrder(int index1, int index2);
+    // ^CgȗʒuBpX URL ׂȂ TAB_ELLIPSIS_MIDDLE
+    void SetEllipsisMode(TabEllipsisMode mode);
+    // zo[̃|bvAbvɃTlCoBnullptr Ń^Cgɖ߂
+    void SetThumbnailProvider(ITabThumbnailProvider* provider);
+    void SetThumbnailCacheBudget(size_t bytes);
+    // DPI ƂɊoĂ^Cg̏ ( 0 ̓^u玩Ō߂BTabMeasureCache::SetBudget Q)
+    void SetMeasureCacheBudget(size_t bytes);
+    // ^u GDI ł͂Ȃ TabRaster ŕ`ASetDIBitsToDevice  1 ŏo (hbO GDI)
+    void SetSoftwareRendering(bool enable);
+    bool IsSoftwareRendering() const;
+    // ^u̓eςĂԁB̃zo[Ŏ蒼
+    void InvalidateTabThumbnail(UINT64 id);
+
+    // ID ɂ^ȗ
+    UINT64 GetTabId(int index) const;
+    // ID CfbNXԂBꂽ^uȂ -1
+    int GetTabById(UINT64 id) const;
+    bool MoveTab(UINT64 id, int newIndex);
+    bool CloseTab(UINT64 id);
+    LPARAM GetTabUserData(int index) const;
+    void SetTabUserData(int index, LPARAM userData);
+
+    // ǂ̃XbhłĂׂύX (Create ̌AEBhEjO܂)B
+    // UI Xbh 1 t[ 1 ܂Ƃ߂ĔfA^uւ̓ύX͍Ō̂̂gB
+    // PostAddTab ͒ǉ^u ID ɕԂ̂ŁAf҂ PostRenameTab ȂǂɎgB
+    // z[hł͒ǉłȂ̂ 0 ԂĉȂ (^u̓f[^\[Xɑ NotifyTabsInserted)B
+    // ς񂾌AfOɉz[hɐ؂ւꍇǉȂ
+    UINT64 PostAddTab(const std::wstring& title, LPARAM userData = 0);
+    void PostRemoveTab(UINT64 id);
+    void PostRenameTab(UINT64 id, const std::wstring& title);
+    void PostTabUserData(UINT64 id, LPARAM userData);
+
+    // ^ȕԕ\ (io[EXsi[EǐEύX̓_)Bʏ탂[h̃^uB
+    // xςĂ` 1 t[ 1 Ã^u̕ς
+    void SetTabAdornment(UINT64 id, const TabAdornment& adornment);
+    bool GetTabAdornment(UINT64 id, TabAdornment* adornment) const;
+    void PostTabAdornment(UINT64 id, const TabAdornment& adornment);
+
+    // ^uLbV̓v
+    UINT64 GetWidthCacheHits() const;
+    UINT64 GetWidthCacheMisses() const;
+    // O WM_PAINT ŕ`悵^u̐
+    int GetLastPaintTabCount() const;
+    // LbVĂ GDI IuWFNg̐
+    int GetGdiObjectCount() const;
+
+    // `EqbgeXgȂǂ̌vlBTAB_STATS_DISABLED ŃrhƏ 0
+    TabControlStats GetStats() const;
+    void ResetStats();
+    // ߂̃CxgOobt@ɋL^ACSV Ńt@Cɏo
+    void EnableStatsTrace(bool enable);
+    bool DumpStatsTrace(LPCWSTR path) const;
 
 private:
     static LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     static LRESULT CALLBACK DragWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     static LRESULT CALLBACK PopupWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     static void RegisterPopupWindowClass(HINSTANCE hInstance);
+    static LRESULT CALLBACK OverflowWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+    static LRESULT CALLBACK OverflowEditProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
     void OnPaint(HWND hWnd);
     void OnSize(HWND hWnd);
@@ -35,26 +136,83 @@ private:
     void OnMouseHover(HWND hWnd, int x, int y);
     void OnLButtonUp(HWND hWnd, int x, int y);
     void OnMouseLeave(HWND hWnd);
+    void OnMouseWheel(HWND hWnd, int delta, bool isHorizontal);
     void OnDpiChanged(HWND hWnd, int dpi);
 
+    // ITabTextMeasurer
+    int MeasureText(const std::wstring& text) override;
+
     void RecalculateTabPositions();
+    // KvȍςĂ΃Rg[̍킹Đeɒm点
+    void UpdateControlHeight();
     int GetTabWidth(int index) const;
+    // ^CgTlC̃LbṼL[Bz[hł ID Ȃ̂ŃCfbNXg
+    UINT64 GetTabKey(int index) const;
     int HitTest(int x, int y, bool* isCloseButton, bool* isScrollLeft, bool* isScrollRight) const;
-    void DrawTab(HDC hdc, int index, const RECT& rect, bool isActive, bool isHovered, bool isCloseHovered);
+    void DrawTab(HDC hdc, int index, const RECT& rect, bool isActive, float hoverLevel, bool isCloseHovered);
+    // {^̈ʒuɃXsi[EǐEύX̓_̂ǂꂩ 1 `
+    void DrawTabStatus(HDC hdc, const TabAdornment& adornment, const RECT& rect, COLORREF bgColor);
 
     void CreateDragWindow(int tabIndex);
     void DestroyDragWindow();
     void DrawDragWindow(HDC hdc);
+    // hbO̓^ux`ĂA炵ē\荇킹
+    void RenderDragSnapshot(int contentLeft, int contentRight);
+    void ComposeDragSnapshot(HDC hdc, const RECT& rcClip);
+    // s[h rcClip ɂs̃^u`
+    void PaintRows(HDC hdc, const RECT& rcClip);
+    void PaintSoftware(HDC hdc, const RECT& rcPaint);
+    void InvalidateDragSpan(int oldTarget, int newTarget);
 
     void ShowCustomTooltip(int index, int x, int y);
+    void DrawPopupThumbnail(HDC hdc, const RECT& rect);
+    void OnThumbnailReady();
     void HideCustomTooltip();
 
+    // ^uꗗ (i荞݌t)
+    void ShowOverflowList();
+    void HideOverflowList();
+    void UpdateOverflowFilter();
+    // JĂԂɃ^uς̂ĂČ蒼
+    void RefreshOverflowList();
+    void ActivateOverflowItem(int item);
+    void DrawOverflowItem(const DRAWITEMSTRUCT* pDis);
+    // ꗗ̍ڂw^uB͈͊OȂ -1
+    int GetOverflowTabIndex(int item) const;
+
     void UpdateTheme(BOOL bIsDarkMode);
+    // (DPI, e[}) ̋L\[Xɐ؂ւBtHgςv
+    void AcquireResources(bool isDarkMode);
+    void RebuildGdiCache();
+    void InvalidateTab(int index);
+    // hbOɃ^u̕тeςA̕`ŃXibvVbg蒼
+    void InvalidateDragSnapshot();
+    // z[hŃ^ũCfbNXꂽƂɌĂ
+    void ClearVirtualThumbnails();
+    // parts  TAB_ADORN_PROGRESS / TAB_ADORN_STATUS ̑gݍ킹
+    void InvalidateAdornment(int index, int parts);
+    void InvalidateScrollButtons();
+
+    // Aj[VBt[ m_framePacer ݁AĂ̂ȂΎ~߂
+    void SmoothScrollBy(int delta);
+    void UpdateAutoScroll(int x);
+    void SetHoveredTab(int index);
+    int GetFrameInterval() const;
+    void StartAnimation();
+    void StopAnimation();
+    void OnAnimationFrame();
+    // DPI ςATẐ̕܂܂̃^u󂫎Ԃɏv
+    void StartIdleMeasure();
+    void OnIdleMeasureTimer();
+    // [J[Xbh̕ύX͂玟̃t[ł܂Ƃ߂Ĕf
+    void OnTabUpdatesPosted();
+    void ApplyTabUpdates();
+    void OnAdornmentFrame();
 
     HWND m_hWnd;
     HFONT m_hFont;
     int m_dpi;
-    std::vector<std::wstring> m_tabTitles;
+    TabLayoutEngine m_layout;
     int m_selectedTab;
     int m_hoveredTab;
     int m_hoveredCloseButtonTab;
@@ -63,14 +221,18 @@ private:
     bool m_isDragging;
     POINT m_dragStartPos;
 
-    int m_scrollOffset;
     bool m_isScrollLeftHovered;
     bool m_isScrollRightHovered;
-    int m_totalTabsWidth;
-    int m_scrollButtonWidth;
-    int m_scrollButtonHeight;
-    RECT m_scrollLeftRect;
-    RECT m_scrollRightRect;
+    bool m_isOverflowHovered;
+    int m_lastPaintTabCount;
+    int m_updateDepth;
+    bool m_isLayoutPending;
+    bool m_isEnsureVisiblePending;
+    TabAnimator m_animator;
+    TabFramePacer m_framePacer;
+    bool m_isAnimationRunning;
+    bool m_isAdornmentRunning;
+    POINT m_lastMousePos;
 
     COLORREF m_clrBg;
     COLORREF m_clrText;
@@ -83,6 +245,27 @@ private:
     COLORREF m_clrScrollButtonHoverBg;
     COLORREF m_clrTooltipBg;
     COLORREF m_clrTooltipText;
+    COLORREF m_clrAccent;
+    TabGdiCache m_gdiCache; // L\[XɂȂF (tF[hrȂ) 
+    const TabThemeResources* m_resources; // m_hFont ƔzF̎
+    TabTextCache m_textCache;
+    TabThumbnailCache m_thumbnails;
+    TabUpdateQueue m_updates;
+    std::atomic<bool> m_isVirtualMode; // PostAddTab [J[Xbh猩
+    std::vector<TabUpdate> m_drainedUpdates; // ApplyTabUpdates ̍Ɨ̈
+    TabAdornments m_adornments;
+    std::vector<TabAdornments::Dirty> m_dirtyAdornments; // OnAdornmentFrame ̍Ɨ̈
+    TabBackBuffer m_backBuffer;
+    HRGN m_hUpdateRgn; // OnPaint  BeginPaint ̑OɎXV[W
+    std::vector<BYTE> m_updateRgnData; // XV[W`ɕƗ̈
+    TabShapeMask m_tabShape;
+    TabBackBuffer m_dragSnapshot;
+    int m_dragSnapshotLeft;  // XibvVbg͈ (XN[O x W)
+    int m_dragSnapshotRight;
+    bool m_isSoftwareRendering;
+    TabRaster m_raster; // \tgEFA`̃obt@ (NCAgS)
+    TabSoftwareRenderer m_softRenderer;
+    TabGdiGlyphSource m_glyphSource;
 
     // Ǝc[`bvp̃oϐ
     HWND m_hDragWnd;
@@ -91,4 +274,22 @@ private:
     std::wstring m_popupText;
     int m_popupWidth;
     int m_popupHeight;
+    std::wstring m_popupTitle; // m_popupTextSize vƂ̃^Cg
+    SIZE m_popupTextSize;
+    bool m_hasPopupThumbnail;
+    UINT64 m_popupThumbnailKey;
+
+    // ^uꗗ̃|bvAbv
+    HWND m_hOverflowWnd;
+    HWND m_hOverflowEdit;
+    HWND m_hOverflowList;
+    WNDPROC m_pfnOverflowEditProc;
+    TabSearchIndex m_searchIndex;
+    bool m_hasSearchIndex; // ŏɕł܂ōȂ
+    bool m_isOverflowFiltered; // false Ȃꗗ͑S^ȕԂŕׂ
+    bool m_isOverflowRefreshPending; // BeginUpdate ̕ύX EndUpdate ł܂Ƃ߂Ď蒼
+
+#ifndef TAB_STATS_DISABLED
+    mutable TabStats m_stats;
+#endif
 };
\ No newline at end of file
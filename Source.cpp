@@ -18,6 +18,10 @@ LRESULT CALLBACK MainWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         BOOL isDarkMode = CUtil::IsSystemInDarkTheme() ? TRUE : FALSE;
         DwmSetWindowAttribute(hWnd, 20 /* DWMWA_USE_IMMERSIVE_DARK_MODE */, &isDarkMode, sizeof(isDarkMode));
         g_tabControl.Create(hWnd, 0, 0, 800, 40, 1000, isDarkMode);
+        // 表示の確認用。Segoe UI にない文字 (フォントリンクで描く) と整形の要る文字を含むタイトル
+        g_tabControl.AddTab(L"日本語のタイトル");
+        g_tabControl.AddTab(L"中文标题 / 한국어 제목");
+        g_tabControl.AddTab(L"مرحبا بالعالم");
 
         // レイアウトを更新
         RECT rc;
@@ -31,7 +35,7 @@ LRESULT CALLBACK MainWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             if (IsWindow(hTab)) {
                 RECT rc;
                 GetClientRect(hWnd, &rc);
-                SetWindowPos(hTab, NULL, 0, 0, rc.right, 40, SWP_NOZORDER);
+                SetWindowPos(hTab, NULL, 0, 0, rc.right, g_tabControl.GetRequiredHeight(), SWP_NOZORDER);
             }
         }
         return 0;
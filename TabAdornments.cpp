@@ -0,0 +1,108 @@
+﻿#include "TabAdornments.h"
+#include <algorithm>
+#include <cmath>
+
+static int GetChangedParts(const TabAdornment& from, const TabAdornment& to) {
+    int parts = 0;
+    if (std::max(from.progress, -1) != std::max(to.progress, -1)) {
+        parts |= TAB_ADORN_PROGRESS;
+    }
+    if (from.isBusy != to.isBusy || from.unreadCount != to.unreadCount || from.isModified != to.isModified) {
+        parts |= TAB_ADORN_STATUS;
+    }
+    return parts;
+}
+
+TabAdornments::TabAdornments() {
+}
+
+void TabAdornments::Set(unsigned long long key, const TabAdornment& adornment) {
+    static const TabAdornment s_empty = { -1, false, 0, false };
+    std::unordered_map<unsigned long long, Entry>::iterator it = m_entries.find(key);
+    const TabAdornment& old = it != m_entries.end() ? it->second.adornment : s_empty;
+    int parts = GetChangedParts(old, adornment);
+    if (parts == 0) {
+        return;
+    }
+    if (old.isBusy != adornment.isBusy) {
+        if (adornment.isBusy) {
+            m_busyKeys.push_back(key);
+        }
+        else {
+            m_busyKeys.erase(std::find(m_busyKeys.begin(), m_busyKeys.end(), key));
+        }
+    }
+    if (it == m_entries.end()) {
+        Entry entry = { adornment, 0 };
+        it = m_entries.emplace(key, entry).first;
+    }
+    else {
+        it->second.adornment = adornment;
+    }
+    if (it->second.dirtyParts == 0) {
+        m_dirtyKeys.push_back(key);
+    }
+    it->second.dirtyParts |= parts;
+}
+
+void TabAdornments::Remove(unsigned long long key) {
+    std::unordered_map<unsigned long long, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+    if (it->second.adornment.isBusy) {
+        m_busyKeys.erase(std::find(m_busyKeys.begin(), m_busyKeys.end(), key));
+    }
+    // m_dirtyKeys に残っていても CollectDirty で読み飛ばす
+    m_entries.erase(it);
+}
+
+void TabAdornments::Clear() {
+    m_entries.clear();
+    m_dirtyKeys.clear();
+    m_busyKeys.clear();
+}
+
+const TabAdornment* TabAdornments::Find(unsigned long long key) const {
+    std::unordered_map<unsigned long long, Entry>::const_iterator it = m_entries.find(key);
+    return it != m_entries.end() ? &it->second.adornment : nullptr;
+}
+
+void TabAdornments::CollectDirty(std::vector<Dirty>& dirty) {
+    dirty.clear();
+    // スピナーは変更がなくても毎フレーム描き直す
+    for (size_t i = 0; i < m_busyKeys.size(); ++i) {
+        Entry& entry = m_entries[m_busyKeys[i]];
+        Dirty d = { m_busyKeys[i], entry.dirtyParts | TAB_ADORN_STATUS };
+        dirty.push_back(d);
+        entry.dirtyParts = 0;
+    }
+    for (size_t i = 0; i < m_dirtyKeys.size(); ++i) {
+        std::unordered_map<unsigned long long, Entry>::iterator it = m_entries.find(m_dirtyKeys[i]);
+        // 削除されたものと、スピナーとして済ませたものは飛ばす
+        if (it == m_entries.end() || it->second.dirtyParts == 0) {
+            continue;
+        }
+        Dirty d = { it->first, it->second.dirtyParts };
+        dirty.push_back(d);
+        it->second.dirtyParts = 0;
+        // 何も出さなくなったものは、描き直しを済ませたら捨てる
+        if (IsEmpty(it->second.adornment)) {
+            m_entries.erase(it);
+        }
+    }
+    m_dirtyKeys.clear();
+}
+
+bool TabAdornments::IsAnimating() const {
+    return !m_dirtyKeys.empty() || !m_busyKeys.empty();
+}
+
+int TabAdornments::GetSpinnerHead(double now) {
+    double turns = now / TAB_SPINNER_PERIOD;
+    return (int)((turns - std::floor(turns)) * TAB_SPINNER_DOTS) % TAB_SPINNER_DOTS;
+}
+
+bool TabAdornments::IsEmpty(const TabAdornment& adornment) {
+    return adornment.progress < 0 && !adornment.isBusy && adornment.unreadCount <= 0 && !adornment.isModified;
+}
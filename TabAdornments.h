@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+// タブに重ねて出す状態表示
+struct TabAdornment {
+    int progress;     // 0 - 100。負なら出さない
+    bool isBusy;      // 閉じるボタンの位置にスピナー
+    int unreadCount;  // 0 より大きければ閉じるボタンの位置にバッジ
+    bool isModified;  // 閉じるボタンの位置に点
+};
+
+// 再描画する部分
+#define TAB_ADORN_PROGRESS 0x1 // タブの下端のバー
+#define TAB_ADORN_STATUS 0x2   // 閉じるボタンの位置のスピナー・バッジ・点
+
+// 描画の寸法 (96 DPI 基準)。GDI とソフトウェアの描画で共通
+#define ADORNMENT_BAR_HEIGHT 3
+#define ADORNMENT_SPINNER_RADIUS 6
+#define ADORNMENT_SPINNER_DOT 2
+#define ADORNMENT_BADGE_HEIGHT 16
+#define ADORNMENT_DOT_RADIUS 4
+
+// スピナーが 1 周する時間 (ミリ秒)
+#define TAB_SPINNER_PERIOD 1000.0
+#define TAB_SPINNER_DOTS 8
+
+// タブごとの状態表示と、次のフレームで描き直す部分を持つ。Windows API に依存しない。
+// 何度変更されても、描き直しは呼び出し側のタイマーで 1 フレームに 1 回にまとまる
+class TabAdornments {
+public:
+    struct Dirty {
+        unsigned long long key;
+        int parts;
+    };
+
+    TabAdornments();
+
+    // 変わった部分だけを次のフレームで描き直す
+    void Set(unsigned long long key, const TabAdornment& adornment);
+    void Remove(unsigned long long key);
+    void Clear();
+    // なければ nullptr
+    const TabAdornment* Find(unsigned long long key) const;
+
+    // 1 フレームに 1 回呼ぶ。前回から変わった部分と、回っているスピナーを返す
+    void CollectDirty(std::vector<Dirty>& dirty);
+    // false になったらタイマーを止めてよい
+    bool IsAnimating() const;
+
+    // 今いちばん明るいスピナーの点。時刻だけで決まるので、どのタブもそろって回る
+    static int GetSpinnerHead(double now);
+    static bool IsEmpty(const TabAdornment& adornment);
+
+private:
+    struct Entry {
+        TabAdornment adornment;
+        int dirtyParts;
+    };
+
+    std::unordered_map<unsigned long long, Entry> m_entries;
+    std::vector<unsigned long long> m_dirtyKeys;
+    std::vector<unsigned long long> m_busyKeys;
+};
@@ -0,0 +1,159 @@
+﻿#include "TabAnimator.h"
+#include <algorithm>
+#include <cmath>
+
+// スクロールが目標に近づく時定数 (ミリ秒)
+#define SCROLL_TIME_CONSTANT 60.0
+// ホバーのフェードにかける時間 (ミリ秒)
+#define HOVER_FADE_DURATION 150.0
+
+TabAnimator::TabAnimator()
+    : m_enabled(true), m_lastTime(-1.0), m_isScrolling(false),
+    m_scrollPos(0.0), m_scrollTarget(0.0), m_autoScrollVelocity(0.0) {
+}
+
+void TabAnimator::SetEnabled(bool enabled) {
+    m_enabled = enabled;
+    if (!m_enabled) {
+        for (HoverFade& fade : m_hovers) {
+            fade.level = fade.target;
+        }
+    }
+}
+
+bool TabAnimator::IsEnabled() const {
+    return m_enabled;
+}
+
+void TabAnimator::ScrollBy(double delta, int currentOffset, int maxOffset, double now) {
+    Wake(now);
+    if (!m_isScrolling) {
+        m_scrollPos = m_scrollTarget = currentOffset;
+    }
+    m_scrollTarget = std::min((double)maxOffset, std::max(0.0, m_scrollTarget + delta));
+    m_isScrolling = (m_scrollTarget != m_scrollPos);
+}
+
+void TabAnimator::SetAutoScrollVelocity(double pixelsPerSecond, double now) {
+    if (pixelsPerSecond != 0.0) {
+        Wake(now);
+    }
+    m_autoScrollVelocity = pixelsPerSecond;
+}
+
+void TabAnimator::StopScroll() {
+    m_isScrolling = false;
+    m_autoScrollVelocity = 0.0;
+}
+
+bool TabAnimator::IsScrolling() const {
+    return m_isScrolling || m_autoScrollVelocity != 0.0;
+}
+
+void TabAnimator::SetHover(int index, bool hovered, double now) {
+    if (index < 0) {
+        return;
+    }
+    float target = hovered ? 1.0f : 0.0f;
+    auto it = std::find_if(m_hovers.begin(), m_hovers.end(), [index](const HoverFade& fade) { return fade.index == index; });
+    if (it == m_hovers.end()) {
+        if (!hovered) {
+            return;
+        }
+        HoverFade fade = { index, 0.0f, target };
+        it = m_hovers.insert(m_hovers.end(), fade);
+    }
+    it->target = target;
+    if (!m_enabled) {
+        it->level = target;
+    }
+    else if (it->level != target) {
+        Wake(now);
+    }
+}
+
+void TabAnimator::ResetHover(int hoveredIndex) {
+    m_hovers.clear();
+    if (hoveredIndex >= 0) {
+        HoverFade fade = { hoveredIndex, 1.0f, 1.0f };
+        m_hovers.push_back(fade);
+    }
+}
+
+float TabAnimator::GetHoverLevel(int index) const {
+    for (const HoverFade& fade : m_hovers) {
+        if (fade.index == index) {
+            return fade.level;
+        }
+    }
+    return 0.0f;
+}
+
+bool TabAnimator::Tick(double now, int currentOffset, int maxOffset) {
+    double dt = m_lastTime < 0.0 ? 0.0 : std::max(0.0, now - m_lastTime);
+    m_lastTime = now;
+    m_fadedTabs.clear();
+
+    // スクロール中に外から位置を変えられたら (EnsureVisible など) そちらに合わせる
+    if (IsScrolling() && (int)std::floor(m_scrollPos + 0.5) != currentOffset) {
+        m_scrollPos = m_scrollTarget = currentOffset;
+        m_isScrolling = false;
+    }
+
+    bool wasScrolling = IsScrolling();
+    if (m_autoScrollVelocity != 0.0) {
+        m_scrollTarget = std::min((double)maxOffset, std::max(0.0, m_scrollTarget + m_autoScrollVelocity * dt / 1000.0));
+        m_scrollPos = m_scrollTarget;
+        m_isScrolling = false;
+    }
+    else if (m_isScrolling) {
+        m_scrollTarget = std::min((double)maxOffset, std::max(0.0, m_scrollTarget));
+        m_scrollPos += (m_scrollTarget - m_scrollPos) * (1.0 - std::exp(-dt / SCROLL_TIME_CONSTANT));
+        if (std::fabs(m_scrollTarget - m_scrollPos) < 0.5) {
+            m_scrollPos = m_scrollTarget;
+            m_isScrolling = false;
+        }
+    }
+
+    float step = (float)(dt / HOVER_FADE_DURATION);
+    for (HoverFade& fade : m_hovers) {
+        if (fade.level == fade.target) {
+            continue;
+        }
+        fade.level = fade.level < fade.target ? std::min(fade.target, fade.level + step) : std::max(fade.target, fade.level - step);
+        m_fadedTabs.push_back(fade.index);
+    }
+    m_hovers.erase(std::remove_if(m_hovers.begin(), m_hovers.end(),
+        [](const HoverFade& fade) { return fade.level == 0.0f && fade.target == 0.0f; }), m_hovers.end());
+
+    if (!IsAnimating()) {
+        m_lastTime = -1.0;
+    }
+    return wasScrolling && GetScrollOffset() != currentOffset;
+}
+
+int TabAnimator::GetScrollOffset() const {
+    return (int)std::floor(m_scrollPos + 0.5);
+}
+
+const std::vector<int>& TabAnimator::GetFadedTabs() const {
+    return m_fadedTabs;
+}
+
+bool TabAnimator::IsAnimating() const {
+    if (IsScrolling()) {
+        return true;
+    }
+    for (const HoverFade& fade : m_hovers) {
+        if (fade.level != fade.target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TabAnimator::Wake(double now) {
+    if (m_lastTime < 0.0) {
+        m_lastTime = now;
+    }
+}
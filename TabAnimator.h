@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <vector>
+
+// 時間で変化する表示 (なめらかなスクロール、ドラッグ中の端での自動スクロール、
+// ホバーのフェード) をまとめて進める。Windows API に依存しない。
+// 時刻はミリ秒で、呼び出し側のタイマーから 1 フレームごとに Tick を呼ぶ。
+// IsAnimating が false になったらタイマーを止めてよい。
+class TabAnimator {
+public:
+    TabAnimator();
+
+    // false にするとホバーはフェードせずに切り替わる
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+
+    // 目標位置を delta だけ動かし、そこへ減速しながら近づける
+    void ScrollBy(double delta, int currentOffset, int maxOffset, double now);
+    // 0 以外の間は一定の速度 (ピクセル/秒) でスクロールし続ける
+    void SetAutoScrollVelocity(double pixelsPerSecond, double now);
+    void StopScroll();
+    bool IsScrolling() const;
+
+    void SetHover(int index, bool hovered, double now);
+    // タブの並びが変わったときに、hoveredIndex だけを表示しきった状態にする
+    void ResetHover(int hoveredIndex);
+    // 0.0 (通常) から 1.0 (ホバー) まで
+    float GetHoverLevel(int index) const;
+
+    // 1 フレーム進める。スクロール位置が変わったら true を返す
+    bool Tick(double now, int currentOffset, int maxOffset);
+    int GetScrollOffset() const;
+    // 直前の Tick でホバーの度合いが変わったタブ
+    const std::vector<int>& GetFadedTabs() const;
+
+    bool IsAnimating() const;
+
+private:
+    struct HoverFade {
+        int index;
+        float level;
+        float target;
+    };
+
+    void Wake(double now);
+
+    bool m_enabled;
+    double m_lastTime;   // 止まっている間は負
+    bool m_isScrolling;
+    double m_scrollPos;
+    double m_scrollTarget;
+    double m_autoScrollVelocity;
+    std::vector<HoverFade> m_hovers;
+    std::vector<int> m_fadedTabs;
+};
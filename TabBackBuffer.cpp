@@ -0,0 +1,93 @@
+﻿#include "TabBackBuffer.h"
+
+// ウィンドウ幅のドラッグで毎回作り直さないよう、幅はこの単位で切り上げる
+#define BACK_BUFFER_WIDTH_STEP 256
+
+TabBackBuffer::TabBackBuffer()
+    : m_hdc(NULL), m_hBitmap(NULL), m_hOldBitmap(NULL), m_bits(NULL), m_width(0), m_height(0) {
+}
+
+TabBackBuffer::~TabBackBuffer() {
+    Release();
+}
+
+bool TabBackBuffer::Ensure(HDC hdcRef, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return m_hBitmap != NULL;
+    }
+    if (m_hBitmap && width <= m_width && height <= m_height) {
+        return true;
+    }
+
+    int newWidth = max(width, m_width);
+    newWidth = (newWidth + BACK_BUFFER_WIDTH_STEP - 1) / BACK_BUFFER_WIDTH_STEP * BACK_BUFFER_WIDTH_STEP;
+    int newHeight = max(height, m_height);
+    Release();
+
+    BITMAPINFO bmi = { 0 };
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = newWidth;
+    bmi.bmiHeader.biHeight = -newHeight; // トップダウン
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    m_hdc = CreateCompatibleDC(hdcRef);
+    if (!m_hdc) {
+        return false;
+    }
+    m_hBitmap = CreateDIBSection(hdcRef, &bmi, DIB_RGB_COLORS, &m_bits, NULL, 0);
+    if (!m_hBitmap) {
+        DeleteDC(m_hdc);
+        m_hdc = NULL;
+        m_bits = NULL;
+        return false;
+    }
+    m_hOldBitmap = (HBITMAP)SelectObject(m_hdc, m_hBitmap);
+    m_width = newWidth;
+    m_height = newHeight;
+    return true;
+}
+
+void TabBackBuffer::Release() {
+    if (m_hdc) {
+        SelectObject(m_hdc, m_hOldBitmap);
+        DeleteDC(m_hdc);
+    }
+    if (m_hBitmap) {
+        DeleteObject(m_hBitmap);
+    }
+    m_hdc = NULL;
+    m_hBitmap = NULL;
+    m_hOldBitmap = NULL;
+    m_bits = NULL;
+    m_width = 0;
+    m_height = 0;
+}
+
+HDC TabBackBuffer::GetDC() const {
+    return m_hdc;
+}
+
+void* TabBackBuffer::GetBits() const {
+    return m_bits;
+}
+
+int TabBackBuffer::GetStride() const {
+    return m_width * 4;
+}
+
+int TabBackBuffer::GetCapacityWidth() const {
+    return m_width;
+}
+
+int TabBackBuffer::GetCapacityHeight() const {
+    return m_height;
+}
+
+void TabBackBuffer::Present(HDC hdc, const RECT& rc) const {
+    if (!m_hdc) {
+        return;
+    }
+    BitBlt(hdc, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, m_hdc, rc.left, rc.top, SRCCOPY);
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <Windows.h>
+
+// 描画用の 32bpp DIB セクションとメモリ DC。
+// 容量を超えるサイズを要求されたときだけ作り直す。
+class TabBackBuffer {
+public:
+    TabBackBuffer();
+    ~TabBackBuffer();
+
+    bool Ensure(HDC hdcRef, int width, int height);
+    void Release();
+
+    HDC GetDC() const;
+    void* GetBits() const;
+    int GetStride() const;
+    int GetCapacityWidth() const;
+    int GetCapacityHeight() const;
+
+    // rc の範囲だけ hdc へ転送する
+    void Present(HDC hdc, const RECT& rc) const;
+
+private:
+    HDC m_hdc;
+    HBITMAP m_hBitmap;
+    HBITMAP m_hOldBitmap;
+    void* m_bits;
+    int m_width;
+    int m_height;
+};
@@ -0,0 +1,27 @@
+﻿#pragma once
+
+#include <string>
+
+// 省略記号を入れる位置
+enum TabEllipsisMode {
+    TAB_ELLIPSIS_END,    // "Long tab ti…"
+    TAB_ELLIPSIS_MIDDLE, // "C:\Users\…\file.txt" (パスや URL 向け)
+    TAB_ELLIPSIS_START   // "…tab title"
+};
+
+#define TAB_ELLIPSIS_CHAR L'\x2026'
+
+// index の前で文字列を切ってよいか。サロゲートペア・結合文字 (アラビア文字の母音記号、
+// インド系やタイ文字の記号、BMP の外の結合文字を含む)・異体字セレクタ・
+// ZWJ でつながった絵文字の途中では切らない
+bool IsTitleClusterBoundary(const std::wstring& text, int index);
+
+// 1 文字を 1 グリフとして左から並べるだけでは描けない文字か。右から左へ並べる文字、
+// 前後の文字で字形が変わる文字 (アラビア文字・インド系・東南アジアの文字など) と方向の制御文字
+bool IsComplexScriptChar(wchar_t c);
+
+// prefix[i] に text の先頭 i 文字の幅を持つ累積送り幅 (要素数は text.length() + 1) から、
+// maxWidth に収まる表示文字列を result に作る。切る位置は二分探索で求めるので
+// 計測済みなら O(log n)。Windows API に依存しない。切り詰めたときは true を返す
+bool FitTitleToWidth(const std::wstring& text, const int* prefix, int ellipsisWidth, int maxWidth,
+    TabEllipsisMode mode, std::wstring& result);
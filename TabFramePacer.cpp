@@ -0,0 +1,86 @@
+﻿#include "TabFramePacer.h"
+#include <dwmapi.h>
+
+#pragma comment(lib, "dwmapi.lib")
+
+// 合成が無効などで DwmFlush が失敗したときの間隔 (ミリ秒)
+#define FRAME_PACER_FALLBACK_INTERVAL 16
+
+TabFramePacer::TabFramePacer()
+    : m_hNotifyWnd(NULL), m_notifyMessage(0), m_isRunning(false), m_isStopping(false), m_isFramePending(false) {
+}
+
+TabFramePacer::~TabFramePacer() {
+    Stop();
+}
+
+void TabFramePacer::SetNotifyWindow(HWND hWnd, UINT message) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hNotifyWnd = hWnd;
+    m_notifyMessage = message;
+}
+
+void TabFramePacer::Start() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isRunning = true;
+        if (!m_thread.joinable()) {
+            m_isStopping = false;
+            m_thread = std::thread(&TabFramePacer::WorkerMain, this);
+        }
+    }
+    m_condition.notify_one();
+}
+
+void TabFramePacer::Pause() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isRunning = false;
+}
+
+void TabFramePacer::OnFrame() {
+    m_isFramePending = false;
+}
+
+void TabFramePacer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+        m_isRunning = false;
+    }
+    m_condition.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_isFramePending = false;
+}
+
+void TabFramePacer::WorkerMain() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_isStopping || m_isRunning; });
+            if (m_isStopping) {
+                return;
+            }
+        }
+
+        if (FAILED(DwmFlush())) {
+            Sleep(FRAME_PACER_FALLBACK_INTERVAL);
+        }
+
+        HWND hNotifyWnd;
+        UINT message;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_isStopping || !m_isRunning) {
+                continue;
+            }
+            hNotifyWnd = m_hNotifyWnd;
+            message = m_notifyMessage;
+        }
+        // UI スレッドが前のフレームを処理するまでは送らない
+        if (hNotifyWnd && !m_isFramePending.exchange(true)) {
+            PostMessageW(hNotifyWnd, message, 0, 0);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// アニメーションのフレームを DWM の合成に合わせて刻む。
+// SetTimer の分解能はシステムのタイマー (既定で約 15.6ms) なので 64Hz ほどが上限で、
+// それより速い画面ではコマ落ちする。ワーカースレッドで DwmFlush (次の合成まで待つ) を
+// 繰り返し、1 回ごとに通知先のウィンドウへ message を PostMessage する。
+// 前の通知を UI スレッドが OnFrame で受け取るまで次は送らないので、メッセージは溜まらない
+class TabFramePacer {
+public:
+    TabFramePacer();
+    ~TabFramePacer();
+
+    void SetNotifyWindow(HWND hWnd, UINT message);
+    // 初めて呼んだときにスレッドを作る
+    void Start();
+    // スレッドは残したまま通知を止める
+    void Pause();
+    // 通知を受けたら UI スレッドで呼ぶ
+    void OnFrame();
+    void Stop();
+
+private:
+    void WorkerMain();
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    HWND m_hNotifyWnd;
+    UINT m_notifyMessage;
+    bool m_isRunning;
+    bool m_isStopping;
+    std::atomic<bool> m_isFramePending;
+    std::thread m_thread;
+};
@@ -0,0 +1,99 @@
+﻿#include "TabGdiCache.h"
+
+TabGdiCache::TabGdiCache()
+    : m_dpi(0), m_shared(NULL), m_createdCount(0) {
+}
+
+TabGdiCache::~TabGdiCache() {
+    Clear();
+}
+
+void TabGdiCache::Rebuild(const COLORREF* brushColors, int brushCount, const COLORREF* penColors, int penCount, int dpi) {
+    std::vector<COLORREF> brushKey(brushColors, brushColors + brushCount);
+    std::vector<COLORREF> penKey(penColors, penColors + penCount);
+    if (brushKey == m_brushKey && penKey == m_penKey && dpi == m_dpi) {
+        return;
+    }
+    Clear();
+    m_brushKey.swap(brushKey);
+    m_penKey.swap(penKey);
+    m_dpi = dpi;
+    for (size_t i = 0; i < m_brushKey.size(); ++i) {
+        GetBrush(m_brushKey[i]);
+    }
+    for (size_t i = 0; i < m_penKey.size(); ++i) {
+        GetPen(m_penKey[i]);
+    }
+}
+
+void TabGdiCache::Clear() {
+    for (size_t i = 0; i < m_brushes.size(); ++i) {
+        DeleteObject(m_brushes[i].hBrush);
+    }
+    for (size_t i = 0; i < m_pens.size(); ++i) {
+        DeleteObject(m_pens[i].hPen);
+    }
+    m_brushes.clear();
+    m_pens.clear();
+    m_brushKey.clear();
+    m_penKey.clear();
+    m_dpi = 0;
+}
+
+void TabGdiCache::SetShared(const TabGdiCache* shared) {
+    m_shared = shared;
+}
+
+HBRUSH TabGdiCache::FindBrush(COLORREF color) const {
+    for (size_t i = 0; i < m_brushes.size(); ++i) {
+        if (m_brushes[i].color == color) {
+            return m_brushes[i].hBrush;
+        }
+    }
+    return NULL;
+}
+
+HPEN TabGdiCache::FindPen(COLORREF color) const {
+    for (size_t i = 0; i < m_pens.size(); ++i) {
+        if (m_pens[i].color == color) {
+            return m_pens[i].hPen;
+        }
+    }
+    return NULL;
+}
+
+HBRUSH TabGdiCache::GetBrush(COLORREF color) {
+    HBRUSH hBrush = m_shared ? m_shared->FindBrush(color) : NULL;
+    if (!hBrush) {
+        hBrush = FindBrush(color);
+    }
+    if (hBrush) {
+        return hBrush;
+    }
+    BrushEntry entry = { color, CreateSolidBrush(color) };
+    m_brushes.push_back(entry);
+    m_createdCount++;
+    return entry.hBrush;
+}
+
+HPEN TabGdiCache::GetPen(COLORREF color) {
+    HPEN hPen = m_shared ? m_shared->FindPen(color) : NULL;
+    if (!hPen) {
+        hPen = FindPen(color);
+    }
+    if (hPen) {
+        return hPen;
+    }
+    PenEntry entry = { color, CreatePen(PS_SOLID, 1, color) };
+    m_pens.push_back(entry);
+    m_createdCount++;
+    return entry.hPen;
+}
+
+int TabGdiCache::GetObjectCount() const {
+    return (int)(m_brushes.size() + m_pens.size());
+}
+
+unsigned long long TabGdiCache::GetCreatedCount() const {
+    return m_createdCount;
+}
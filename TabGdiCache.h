@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include <vector>
+
+// 配色 (と DPI) をキーにしたブラシ・ペンのキャッシュ。
+// 描画コードはここからハンドルを借りるだけで、作成・削除はしない。
+class TabGdiCache {
+public:
+    TabGdiCache();
+    ~TabGdiCache();
+
+    // キーが変わったときだけ作り直す
+    void Rebuild(const COLORREF* brushColors, int brushCount, const COLORREF* penColors, int penCount, int dpi);
+    void Clear();
+
+    // 共有の (読むだけの) キャッシュを先に探し、なければこのキャッシュに作る。
+    // shared は Rebuild を済ませたものを渡し、以降は変更しないこと
+    void SetShared(const TabGdiCache* shared);
+    // 作成済みのハンドルを探すだけ。なければ NULL
+    HBRUSH FindBrush(COLORREF color) const;
+    HPEN FindPen(COLORREF color) const;
+
+    // 配色にない色は初回に作成してキャッシュに加える
+    HBRUSH GetBrush(COLORREF color);
+    HPEN GetPen(COLORREF color);
+
+    int GetObjectCount() const;
+    // これまでに作成したオブジェクトの累計 (フレームごとの作成数の計測用)
+    unsigned long long GetCreatedCount() const;
+
+private:
+    struct BrushEntry {
+        COLORREF color;
+        HBRUSH hBrush;
+    };
+    struct PenEntry {
+        COLORREF color;
+        HPEN hPen;
+    };
+
+    std::vector<COLORREF> m_brushKey;
+    std::vector<COLORREF> m_penKey;
+    int m_dpi;
+    std::vector<BrushEntry> m_brushes;
+    std::vector<PenEntry> m_pens;
+    const TabGdiCache* m_shared;
+    unsigned long long m_createdCount;
+};
@@ -0,0 +1,111 @@
+﻿#include "TabGdiGlyphSource.h"
+#include "TabEllipsis.h"
+
+TabGdiGlyphSource::TabGdiGlyphSource()
+    : m_hdc(NULL), m_hFont(NULL), m_hOldFont(NULL), m_ascent(0), m_lineHeight(0) {
+}
+
+TabGdiGlyphSource::~TabGdiGlyphSource() {
+    if (m_hdc) {
+        SelectObject(m_hdc, m_hOldFont);
+        DeleteDC(m_hdc);
+    }
+}
+
+void TabGdiGlyphSource::SetFont(HFONT hFont) {
+    if (hFont == m_hFont) {
+        return;
+    }
+    m_glyphs.clear();
+    m_missing.clear();
+    m_hFont = hFont;
+    if (!hFont) {
+        // フォントを消す前に呼ぶ。元のフォントに戻して DC を片付ける
+        if (m_hdc) {
+            SelectObject(m_hdc, m_hOldFont);
+            DeleteDC(m_hdc);
+            m_hdc = NULL;
+        }
+        m_ascent = 0;
+        m_lineHeight = 0;
+        return;
+    }
+    if (!m_hdc) {
+        m_hdc = CreateCompatibleDC(NULL);
+        if (!m_hdc) {
+            return;
+        }
+        m_hOldFont = SelectObject(m_hdc, hFont);
+    }
+    else {
+        SelectObject(m_hdc, hFont);
+    }
+    TEXTMETRICW tm;
+    GetTextMetricsW(m_hdc, &tm);
+    m_ascent = tm.tmAscent;
+    m_lineHeight = tm.tmHeight;
+}
+
+const TabGlyph* TabGdiGlyphSource::GetGlyph(wchar_t c) {
+    auto it = m_glyphs.find(c);
+    if (it != m_glyphs.end()) {
+        return &it->second;
+    }
+    if (!m_hdc || m_missing.count(c) != 0) {
+        return nullptr;
+    }
+    // GetGlyphOutlineW はフォントにない文字でも代わりの四角を返すので、先に確かめる
+    WORD index = 0;
+    if ((c >= 0xD800 && c <= 0xDFFF) || IsComplexScriptChar(c) ||
+        GetGlyphIndicesW(m_hdc, &c, 1, &index, GGI_MARK_NONEXISTING_GLYPHS) == GDI_ERROR || index == 0xFFFF) {
+        m_missing.insert(c);
+        return nullptr;
+    }
+
+    static const MAT2 s_identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+    GLYPHMETRICS gm;
+    DWORD size = GetGlyphOutlineW(m_hdc, c, GGO_GRAY8_BITMAP, &gm, 0, NULL, &s_identity);
+    if (size == GDI_ERROR) {
+        return nullptr;
+    }
+    TabGlyph& glyph = m_glyphs[c];
+    glyph.advance = gm.gmCellIncX;
+    glyph.left = gm.gmptGlyphOrigin.x;
+    glyph.top = gm.gmptGlyphOrigin.y;
+    glyph.width = 0;
+    glyph.height = 0;
+    // 空白は大きさ 0 で返る
+    if (size == 0) {
+        return &glyph;
+    }
+    m_buffer.resize(size);
+    if (GetGlyphOutlineW(m_hdc, c, GGO_GRAY8_BITMAP, &gm, size, m_buffer.data(), &s_identity) == GDI_ERROR) {
+        return &glyph;
+    }
+
+    // 行は 4 バイト境界にそろえてあり、値は 0 - 64
+    int width = (int)gm.gmBlackBoxX;
+    int height = (int)gm.gmBlackBoxY;
+    int pitch = (width + 3) & ~3;
+    if ((size_t)pitch * height > m_buffer.size()) {
+        return &glyph;
+    }
+    glyph.width = width;
+    glyph.height = height;
+    glyph.coverage.resize((size_t)width * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int level = m_buffer[(size_t)y * pitch + x];
+            glyph.coverage[(size_t)y * width + x] = (uint8_t)((level * 255 + 32) / 64);
+        }
+    }
+    return &glyph;
+}
+
+int TabGdiGlyphSource::GetAscent() {
+    return m_ascent;
+}
+
+int TabGdiGlyphSource::GetLineHeight() {
+    return m_lineHeight;
+}
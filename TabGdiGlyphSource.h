@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "TabSoftwareRenderer.h"
+
+// GetGlyphOutlineW (GGO_GRAY8_BITMAP) でフォントのグリフを 8 ビットのカバレッジにする。
+// 文字ごとに一度だけ作り、フォントが変わるまで持っておく。
+// 1 文字を 1 グリフとして左から並べるだけなので、次の文字は描けず nullptr を返す
+// (そのタイトルは CustomTabControl が GDI で描く)。
+//  - サロゲートペア (BMP の外の文字)
+//  - 選んだフォントにない文字。GDI ならフォントリンクで別のフォントから出せる
+//  - 字形の選択や並べ替えが要る文字 (ヘブライ文字・アラビア文字・インド系・東南アジアの文字など)
+class TabGdiGlyphSource : public ITabGlyphSource {
+public:
+    TabGdiGlyphSource();
+    ~TabGdiGlyphSource();
+
+    // フォントを変えるとグリフを作り直す。NULL にすると DC からフォントを外して片付ける。
+    // フォントは DC に選んだままになるので、DeleteObject する前に別のフォントか NULL に変えること
+    void SetFont(HFONT hFont);
+
+    const TabGlyph* GetGlyph(wchar_t c) override;
+    int GetAscent() override;
+    int GetLineHeight() override;
+
+private:
+    HDC m_hdc;
+    HFONT m_hFont;
+    HGDIOBJ m_hOldFont;
+    int m_ascent;
+    int m_lineHeight;
+    std::unordered_map<wchar_t, TabGlyph> m_glyphs;
+    std::unordered_set<wchar_t> m_missing; // 描けないと分かった文字
+    std::vector<BYTE> m_buffer;
+};
@@ -0,0 +1,789 @@
+﻿#include "TabLayoutEngine.h"
+#include <algorithm>
+#include <iterator>
+
+// Win32 の MulDiv と同じく四捨五入する
+static int MulDivRound(int number, int numerator, int denominator) {
+    long long product = (long long)number * numerator;
+    long long half = denominator / 2;
+    return (int)(product >= 0 ? (product + half) / denominator : (product - half) / denominator);
+}
+
+TabLayoutEngine::TabLayoutEngine()
+    : m_measurer(nullptr), m_dpi(96), m_hasIdleMeasure(false), m_isVisibleMeasurePending(false), m_idleCursor(0), m_clientWidth(0), m_scrollOffset(0),
+    m_deferMeasure(false), m_hasPendingMeasure(false), m_dataSource(nullptr), m_nextId(1),
+    m_isMultiRow(false), m_widthCacheHits(0), m_widthCacheMisses(0) {
+}
+
+void TabLayoutEngine::SetTextMeasurer(ITabTextMeasurer* measurer) {
+    m_measurer = measurer;
+}
+
+void TabLayoutEngine::SetDpi(int dpi) {
+    if (dpi == m_dpi) {
+        return;
+    }
+    int oldPadding = Scale(TAB_PADDING_X) + GetCloseButtonWidth();
+    int oldDpi = m_dpi;
+    m_dpi = dpi;
+    int padding = Scale(TAB_PADDING_X) + GetCloseButtonWidth();
+    int n = GetTabCount();
+    if (n == 0) {
+        return;
+    }
+    // ここでは計測しない。移動直後のフォントはまだ前の DPI のものかもしれない
+    std::vector<int> widths(n);
+    m_widths.GetRange(0, n, widths.data());
+    for (int i = 0; i < n; ++i) {
+        if (widths[i] == 0) {
+            // 計測を保留しているタブは保留のまま
+            continue;
+        }
+        // 仮想モードではタイトルを問い合わせず、概算にして MeasureIdle に任せる
+        // (MeasureIdle は計測するタブのタイトルだけを取る)
+        int textWidth = 0;
+        if (m_dataSource || !m_measureCache.Find(m_dpi, GetTitle(i), &textWidth)) {
+            textWidth = MulDivRound(std::max(widths[i] - oldPadding, 0), m_dpi, oldDpi);
+            m_hasIdleMeasure = true;
+        }
+        widths[i] = textWidth + padding;
+    }
+    m_widths.Assign(widths);
+    m_idleCursor = 0;
+    ReflowAllRows();
+    ClampScrollOffset();
+}
+
+int TabLayoutEngine::GetDpi() const {
+    return m_dpi;
+}
+
+void TabLayoutEngine::SetClientWidth(int width) {
+    if (width != m_clientWidth) {
+        m_clientWidth = width;
+        ReflowAllRows();
+    }
+    ClampScrollOffset();
+}
+
+int TabLayoutEngine::GetClientWidth() const {
+    return m_clientWidth;
+}
+
+unsigned long long TabLayoutEngine::AddTab(const std::wstring& title, std::intptr_t userData, unsigned long long reservedId) {
+    if (m_dataSource) {
+        return 0;
+    }
+    TabRecord tab = { reservedId != 0 ? reservedId : m_nextId++, title, userData };
+    m_measureCache.SetTitleCount(GetTabCount() + 1);
+    m_indexById[tab.id] = (int)m_tabs.size();
+    m_widths.PushBack(MeasureTab(tab.title));
+    m_tabs.push_back(std::move(tab));
+    ReflowRows((int)m_tabs.size() - 1, (int)m_tabs.size() - 1, 1);
+    return m_tabs.back().id;
+}
+
+unsigned long long TabLayoutEngine::InsertTabs(int index, const std::vector<std::wstring>& titles) {
+    if (titles.empty() || m_dataSource) {
+        return m_nextId.load();
+    }
+    // 連番をまとめて取る。間にほかのスレッドの ReserveTabId が入っても番号は飛ばない
+    unsigned long long firstId = m_nextId.fetch_add(titles.size());
+    index = std::min(std::max(index, 0), (int)m_tabs.size());
+    // 計測の表の上限はタブ数から決まるので、計測する前に増えた後の数を渡す
+    m_measureCache.SetTitleCount(GetTabCount() + (int)titles.size());
+    std::vector<TabRecord> tabs(titles.size());
+    std::vector<int> widths(titles.size());
+    for (size_t i = 0; i < titles.size(); ++i) {
+        tabs[i].id = firstId + i;
+        tabs[i].title = titles[i];
+        tabs[i].userData = 0;
+        widths[i] = MeasureTab(titles[i]);
+    }
+    m_tabs.insert(m_tabs.begin() + index, std::make_move_iterator(tabs.begin()), std::make_move_iterator(tabs.end()));
+    m_widths.InsertRange(index, widths.data(), (int)widths.size());
+    UpdateIndexMap(index, (int)m_tabs.size() - 1);
+    ReflowRows(index, index + (int)titles.size() - 1, (int)titles.size());
+    ClampScrollOffset();
+    return firstId;
+}
+
+void TabLayoutEngine::RemoveTab(int index) {
+    if (index < 0 || index >= GetTabCount()) {
+        return;
+    }
+    m_idleCursor = std::min(m_idleCursor, index);
+    if (m_dataSource) {
+        m_widths.Erase(index);
+        m_measureCache.SetTitleCount(GetTabCount());
+        ReflowRows(index, index - 1, -1);
+        ClampScrollOffset();
+        return;
+    }
+    m_indexById.erase(m_tabs[index].id);
+    m_tabs.erase(m_tabs.begin() + index);
+    m_widths.Erase(index);
+    m_measureCache.SetTitleCount(GetTabCount());
+    UpdateIndexMap(index, (int)m_tabs.size() - 1);
+    ReflowRows(index, index - 1, -1);
+    ClampScrollOffset();
+}
+
+void TabLayoutEngine::RemoveTabs(int index, int count) {
+    int n = GetTabCount();
+    if (index < 0 || index >= n || count <= 0) {
+        return;
+    }
+    count = std::min(count, n - index);
+    m_idleCursor = std::min(m_idleCursor, index);
+    if (m_dataSource) {
+        m_widths.EraseRange(index, count);
+        m_measureCache.SetTitleCount(GetTabCount());
+        ReflowRows(index, index - 1, -count);
+        ClampScrollOffset();
+        return;
+    }
+    for (int i = index; i < index + count; ++i) {
+        m_indexById.erase(m_tabs[i].id);
+    }
+    m_tabs.erase(m_tabs.begin() + index, m_tabs.begin() + index + count);
+    m_widths.EraseRange(index, count);
+    m_measureCache.SetTitleCount(GetTabCount());
+    UpdateIndexMap(index, (int)m_tabs.size() - 1);
+    ReflowRows(index, index - 1, -count);
+    ClampScrollOffset();
+}
+
+void TabLayoutEngine::RenameTab(int index, const std::wstring& title) {
+    if (m_dataSource || index < 0 || index >= (int)m_tabs.size()) {
+        return;
+    }
+    m_tabs[index].title = title;
+    m_widths.Set(index, MeasureTab(title));
+    ReflowRows(index, index, 0);
+    ClampScrollOffset();
+}
+
+void TabLayoutEngine::MoveTab(int from, int to) {
+    int n = GetTabCount();
+    if (from == to || from < 0 || to < 0 || from >= n || to >= n) {
+        return;
+    }
+    m_idleCursor = std::min(m_idleCursor, std::min(from, to));
+    if (m_dataSource) {
+        m_widths.Move(from, to);
+        ReflowRows(std::min(from, to), std::max(from, to), 0);
+        return;
+    }
+    // 間のタブを 1 つずつずらすだけで、文字列はコピーしない
+    if (from < to) {
+        std::rotate(m_tabs.begin() + from, m_tabs.begin() + from + 1, m_tabs.begin() + to + 1);
+    }
+    else {
+        std::rotate(m_tabs.begin() + to, m_tabs.begin() + from, m_tabs.begin() + from + 1);
+    }
+    m_widths.Move(from, to);
+    UpdateIndexMap(std::min(from, to), std::max(from, to));
+    ReflowRows(std::min(from, to), std::max(from, to), 0);
+}
+
+void TabLayoutEngine::RemeasureAll() {
+    m_measureCache.Clear();
+    m_hasIdleMeasure = false;
+    if (m_deferMeasure) {
+        m_widths.Assign(std::vector<int>(GetTabCount(), 0));
+        m_hasPendingMeasure = GetTabCount() > 0;
+        ReflowAllRows();
+        return;
+    }
+    std::vector<int> widths(GetTabCount());
+    for (int i = 0; i < (int)widths.size(); ++i) {
+        widths[i] = MeasureTabAt(i);
+    }
+    m_widths.Assign(widths);
+    ReflowAllRows();
+    ClampScrollOffset();
+}
+
+void TabLayoutEngine::SetDeferMeasure(bool defer) {
+    m_deferMeasure = defer;
+    if (!defer && m_hasPendingMeasure) {
+        MeasurePending();
+    }
+}
+
+int TabLayoutEngine::GetTabCount() const {
+    return m_widths.Size();
+}
+
+const std::wstring& TabLayoutEngine::GetTitle(int index) const {
+    if (m_dataSource) {
+        m_titleBuffer.clear();
+        m_dataSource->GetTabTitle(index, m_titleBuffer);
+        return m_titleBuffer;
+    }
+    return m_tabs[index].title;
+}
+
+void TabLayoutEngine::SetDataSource(ITabDataSource* dataSource, int count) {
+    // 通常モードのタブはすべて捨てる
+    std::vector<TabRecord>().swap(m_tabs);
+    std::unordered_map<unsigned long long, int>().swap(m_indexById);
+    m_widths.Clear();
+    m_measureCache.SetTitleCount(0);
+    m_hasIdleMeasure = false;
+    m_idleCursor = 0;
+    m_dataSource = dataSource;
+    if (m_dataSource) {
+        InsertVirtualTabs(0, count);
+    }
+    ReflowAllRows();
+    ClampScrollOffset();
+}
+
+ITabDataSource* TabLayoutEngine::GetDataSource() const {
+    return m_dataSource;
+}
+
+void TabLayoutEngine::InsertVirtualTabs(int index, int count) {
+    if (!m_dataSource || count <= 0) {
+        return;
+    }
+    index = std::min(std::max(index, 0), GetTabCount());
+    // 数万件のタイトルをここで全部引くと重いので、仮の幅で入れて MeasureIdle で少しずつ計測する。
+    // 保留中なら 0 (保留) のままにしておく
+    int width = 0;
+    if (m_deferMeasure) {
+        m_hasPendingMeasure = true;
+    }
+    else {
+        width = Scale(VIRTUAL_TAB_TEXT_WIDTH) + Scale(TAB_PADDING_X) + GetCloseButtonWidth();
+        m_hasIdleMeasure = true;
+        m_isVisibleMeasurePending = true;
+        m_idleCursor = std::min(m_idleCursor, index);
+    }
+    std::vector<int> widths(count, width);
+    m_widths.InsertRange(index, widths.data(), count);
+    m_measureCache.SetTitleCount(GetTabCount());
+    ReflowRows(index, index + count - 1, count);
+    ClampScrollOffset();
+}
+
+void TabLayoutEngine::RemeasureTab(int index) {
+    if (index < 0 || index >= GetTabCount()) {
+        return;
+    }
+    m_widths.Set(index, MeasureTabAt(index));
+    ReflowRows(index, index, 0);
+    ClampScrollOffset();
+}
+
+unsigned long long TabLayoutEngine::GetTabId(int index) const {
+    if (index < 0 || index >= (int)m_tabs.size()) {
+        return 0;
+    }
+    return m_tabs[index].id;
+}
+
+unsigned long long TabLayoutEngine::ReserveTabId() {
+    return m_nextId++;
+}
+
+unsigned long long TabLayoutEngine::GetTabKey(int index) const {
+    if (m_dataSource) {
+        return (unsigned long long)index | (1ULL << 63);
+    }
+    return GetTabId(index);
+}
+
+int TabLayoutEngine::FindTab(unsigned long long id) const {
+    auto it = m_indexById.find(id);
+    return it != m_indexById.end() ? it->second : -1;
+}
+
+std::intptr_t TabLayoutEngine::GetUserData(int index) const {
+    if (index < 0 || index >= (int)m_tabs.size()) {
+        return 0;
+    }
+    return m_tabs[index].userData;
+}
+
+void TabLayoutEngine::SetUserData(int index, std::intptr_t userData) {
+    if (index >= 0 && index < (int)m_tabs.size()) {
+        m_tabs[index].userData = userData;
+    }
+}
+
+int TabLayoutEngine::Scale(int value) const {
+    return MulDivRound(value, m_dpi, 96);
+}
+
+int TabLayoutEngine::GetTabHeight() const {
+    return MulDivRound(FONT_SIZE, m_dpi, 72) + Scale(TAB_PADDING_Y * 2);
+}
+
+int TabLayoutEngine::GetCloseButtonWidth() const {
+    return GetTabHeight();
+}
+
+int TabLayoutEngine::GetScrollButtonWidth() const {
+    return Scale(SCROLL_BUTTON_WIDTH);
+}
+
+int TabLayoutEngine::GetTabWidth(int index) const {
+    if (index < 0 || index >= GetTabCount()) {
+        return 0;
+    }
+    m_widthCacheHits++;
+    return m_widths.Get(index);
+}
+
+int TabLayoutEngine::GetTabOffset(int index) const {
+    return m_widths.PrefixSum(index);
+}
+
+int TabLayoutEngine::GetTotalWidth() const {
+    return m_widths.Total();
+}
+
+bool TabLayoutEngine::HasScrollButtons() const {
+    return !m_isMultiRow && m_widths.Total() > m_clientWidth;
+}
+
+int TabLayoutEngine::GetViewWidth() const {
+    return HasScrollButtons() ? m_clientWidth - GetScrollButtonWidth() * 3 : m_clientWidth;
+}
+
+TabRect TabLayoutEngine::GetTabRect(int index) const {
+    if (m_isMultiRow) {
+        int row = GetRowOfTab(index);
+        int left = GetTabOffset(index) - GetTabOffset(m_rowStarts[row]);
+        int top = row * GetTabHeight();
+        TabRect rect = { left, top, left + GetTabWidth(index), top + GetTabHeight() };
+        return rect;
+    }
+    int left = GetTabOffset(index) - m_scrollOffset;
+    TabRect rect = { left, 0, left + GetTabWidth(index), GetTabHeight() };
+    return rect;
+}
+
+TabRect TabLayoutEngine::GetCloseButtonRect(const TabRect& tabRect) const {
+    int closeBtnW = tabRect.bottom - tabRect.top;
+    TabRect rect = { tabRect.right - closeBtnW, tabRect.top, tabRect.right, tabRect.bottom };
+    return rect;
+}
+
+TabRect TabLayoutEngine::GetTextRect(const TabRect& tabRect) const {
+    TabRect rect = tabRect;
+    rect.left += Scale(TAB_PADDING_X) / 2;
+    rect.right -= tabRect.bottom - tabRect.top;
+    return rect;
+}
+
+TabRect TabLayoutEngine::GetScrollLeftRect() const {
+    int buttonW = GetScrollButtonWidth();
+    TabRect rect = { m_clientWidth - buttonW * 3, 0, m_clientWidth - buttonW * 2, GetTabHeight() };
+    return rect;
+}
+
+TabRect TabLayoutEngine::GetScrollRightRect() const {
+    int buttonW = GetScrollButtonWidth();
+    TabRect rect = { m_clientWidth - buttonW * 2, 0, m_clientWidth - buttonW, GetTabHeight() };
+    return rect;
+}
+
+TabRect TabLayoutEngine::GetOverflowButtonRect() const {
+    int buttonW = GetScrollButtonWidth();
+    TabRect rect = { m_clientWidth - buttonW, 0, m_clientWidth, GetTabHeight() };
+    return rect;
+}
+
+void TabLayoutEngine::GetVisibleRange(int* first, int* last) const {
+    GetTabsInRange(0, GetViewWidth(), first, last);
+}
+
+void TabLayoutEngine::GetTabsInRange(int left, int right, int* first, int* last) const {
+    *first = 0;
+    *last = -1;
+    int n = GetTabCount();
+    int stripLeft = std::max(0, left + m_scrollOffset);
+    int stripRight = right + m_scrollOffset;
+    if (n == 0 || stripLeft >= stripRight || stripLeft >= m_widths.Total()) {
+        return;
+    }
+    int lastIndex = m_widths.FindIndex(stripRight - 1);
+    *first = m_widths.FindIndex(stripLeft);
+    *last = lastIndex == -1 ? n - 1 : lastIndex;
+}
+
+int TabLayoutEngine::GetDragShift(int index, int draggedIndex, int targetIndex) const {
+    if (index == draggedIndex) {
+        return 0;
+    }
+    int draggedTabWidth = GetTabWidth(draggedIndex);
+    if (draggedIndex < targetIndex) {
+        if (index > draggedIndex && index <= targetIndex) {
+            return -draggedTabWidth;
+        }
+    }
+    else if (draggedIndex > targetIndex) {
+        if (index >= targetIndex && index < draggedIndex) {
+            return draggedTabWidth;
+        }
+    }
+    return 0;
+}
+
+void TabLayoutEngine::SetMultiRow(bool multiRow) {
+    if (multiRow == m_isMultiRow) {
+        return;
+    }
+    m_isMultiRow = multiRow;
+    m_rowStarts.clear();
+    ReflowAllRows();
+    ClampScrollOffset();
+}
+
+bool TabLayoutEngine::IsMultiRow() const {
+    return m_isMultiRow;
+}
+
+int TabLayoutEngine::GetRowCount() const {
+    return m_isMultiRow ? std::max(1, (int)m_rowStarts.size()) : 1;
+}
+
+int TabLayoutEngine::GetRowOfTab(int index) const {
+    if (!m_isMultiRow || m_rowStarts.empty()) {
+        return 0;
+    }
+    int row = (int)(std::upper_bound(m_rowStarts.begin(), m_rowStarts.end(), index) - m_rowStarts.begin()) - 1;
+    return std::max(row, 0);
+}
+
+void TabLayoutEngine::GetRowRange(int row, int* first, int* last) const {
+    int n = GetTabCount();
+    if (!m_isMultiRow) {
+        *first = 0;
+        *last = row == 0 ? n - 1 : -1;
+        return;
+    }
+    if (row < 0 || row >= (int)m_rowStarts.size()) {
+        *first = 0;
+        *last = -1;
+        return;
+    }
+    *first = m_rowStarts[row];
+    *last = (row + 1 < (int)m_rowStarts.size() ? m_rowStarts[row + 1] : n) - 1;
+}
+
+int TabLayoutEngine::GetRequiredHeight() const {
+    return GetRowCount() * GetTabHeight();
+}
+
+int TabLayoutEngine::GetScrollOffset() const {
+    return m_scrollOffset;
+}
+
+int TabLayoutEngine::GetMaxScrollOffset() const {
+    if (m_isMultiRow) {
+        return 0;
+    }
+    return std::max(0, m_widths.Total() - GetViewWidth());
+}
+
+void TabLayoutEngine::SetScrollOffset(int offset) {
+    offset = std::min(GetMaxScrollOffset(), std::max(0, offset));
+    if (offset != m_scrollOffset && m_hasIdleMeasure) {
+        m_isVisibleMeasurePending = true;
+    }
+    m_scrollOffset = offset;
+}
+
+void TabLayoutEngine::ScrollBy(int delta) {
+    SetScrollOffset(m_scrollOffset + delta);
+}
+
+void TabLayoutEngine::EnsureVisible(int index) {
+    if (m_isMultiRow || index < 0 || index >= GetTabCount()) {
+        return;
+    }
+    int tabLeft = GetTabOffset(index);
+    int tabWidth = GetTabWidth(index);
+    int viewWidth = GetViewWidth();
+    if (tabLeft < m_scrollOffset) {
+        SetScrollOffset(tabLeft);
+    }
+    else if (tabLeft + tabWidth > m_scrollOffset + viewWidth) {
+        SetScrollOffset(tabLeft + tabWidth - viewWidth);
+    }
+}
+
+int TabLayoutEngine::HitTest(int x, int y, bool isDragging, bool* isCloseButton, bool* isScrollLeft, bool* isScrollRight) const {
+    if (isCloseButton) *isCloseButton = false;
+    if (isScrollLeft) *isScrollLeft = false;
+    if (isScrollRight) *isScrollRight = false;
+
+    int viewWidth = GetViewWidth();
+    if (HasScrollButtons()) {
+        // 一覧ボタンは呼び出し側で判定する
+        if (x >= GetOverflowButtonRect().left) {
+            return -1;
+        }
+        TabRect rcRight = GetScrollRightRect();
+        if (x >= rcRight.left && x <= rcRight.right) {
+            if (isScrollRight) *isScrollRight = true;
+            return -1;
+        }
+        TabRect rcLeft = GetScrollLeftRect();
+        if (x >= rcLeft.left && x <= rcLeft.right) {
+            if (isScrollLeft) *isScrollLeft = true;
+            return -1;
+        }
+    }
+
+    if (m_isMultiRow) {
+        // 行は同じ高さなので行番号は割り算で、行内は累積幅の二分探索で求める
+        int tabHeight = GetTabHeight();
+        int row = y >= 0 ? y / tabHeight : -1;
+        if (isDragging) {
+            row = std::min(std::max(row, 0), GetRowCount() - 1);
+        }
+        int first = 0;
+        int last = -1;
+        GetRowRange(row, &first, &last);
+        if (first > last) {
+            return -1;
+        }
+        int rowLeft = GetTabOffset(first);
+        int index = x >= 0 ? m_widths.FindIndex(x + rowLeft) : -1;
+        if (index == -1 || index > last) {
+            if (!isDragging) {
+                return -1;
+            }
+            index = x < 0 ? first : last;
+        }
+        if (isCloseButton) {
+            *isCloseButton = (x >= GetCloseButtonRect(GetTabRect(index)).left);
+        }
+        return index;
+    }
+
+    if (isDragging) {
+        if (x < -m_scrollOffset) {
+            return 0;
+        }
+        if (x > m_widths.Total() - m_scrollOffset) {
+            return GetTabCount() - 1;
+        }
+    }
+
+    if (x > viewWidth) {
+        return -1;
+    }
+
+    // 累積幅の二分探索で x を含むタブを求める
+    int index = m_widths.FindIndex(x + m_scrollOffset);
+    if (index == -1) {
+        return -1;
+    }
+    TabRect tabRect = GetTabRect(index);
+    if (tabRect.right <= 0 || tabRect.left >= viewWidth) {
+        return -1;
+    }
+    if (isCloseButton) {
+        *isCloseButton = (x >= GetCloseButtonRect(tabRect).left);
+    }
+    return index;
+}
+
+int TabLayoutEngine::GetDropIndex(int x, int y, int hoveredTab, int draggedTab) const {
+    int dropIndex = -1;
+    if (m_isMultiRow) {
+        dropIndex = HitTest(x, y, true, nullptr, nullptr, nullptr);
+    }
+    else if (hoveredTab == -1 && x > m_widths.Total() - m_scrollOffset) {
+        dropIndex = GetTabCount() - 1;
+    }
+    else {
+        dropIndex = HitTest(x, y, true, nullptr, nullptr, nullptr);
+    }
+    if (dropIndex == -1) {
+        dropIndex = draggedTab;
+    }
+    return dropIndex;
+}
+
+unsigned long long TabLayoutEngine::GetWidthCacheHits() const {
+    return m_widthCacheHits;
+}
+
+unsigned long long TabLayoutEngine::GetWidthCacheMisses() const {
+    return m_widthCacheMisses;
+}
+
+bool TabLayoutEngine::MeasureIdle(int maxTabs, bool* isChanged) {
+    *isChanged = false;
+    if (!m_hasIdleMeasure || m_deferMeasure) {
+        return m_hasIdleMeasure;
+    }
+    int n = GetTabCount();
+    int first = n;
+    int last = -1;
+    if (m_isVisibleMeasurePending) {
+        // 見えているタブを先に計測する
+        m_isVisibleMeasurePending = false;
+        int visibleFirst = 0;
+        int visibleLast = -1;
+        GetVisibleRange(&visibleFirst, &visibleLast);
+        RemeasureRange(visibleFirst, visibleLast + 1, &first, &last);
+    }
+    int end = std::min(m_idleCursor + maxTabs, n);
+    RemeasureRange(m_idleCursor, end, &first, &last);
+    m_idleCursor = end;
+    if (last >= 0) {
+        ReflowRows(first, last, 0);
+        ClampScrollOffset();
+        *isChanged = true;
+    }
+    if (m_idleCursor >= n) {
+        m_hasIdleMeasure = false;
+    }
+    return m_hasIdleMeasure;
+}
+
+void TabLayoutEngine::RemeasureRange(int from, int to, int* first, int* last) {
+    if (from >= to) {
+        return;
+    }
+    // 1 つずつ Get と Set をすると O(count log n) なので、まとめて読んで変わっていれば書き戻す
+    m_rangeWidths.resize(to - from);
+    m_widths.GetRange(from, to - from, m_rangeWidths.data());
+    bool isChanged = false;
+    for (int i = from; i < to; ++i) {
+        // 表にあるものはそのまま。ないものが SetDpi で概算にしたタブや仮の幅の仮想タブ
+        int width = MeasureTabAt(i);
+        if (width != m_rangeWidths[i - from]) {
+            m_rangeWidths[i - from] = width;
+            isChanged = true;
+            *first = std::min(*first, i);
+            *last = std::max(*last, i);
+        }
+    }
+    if (isChanged) {
+        m_widths.SetRange(from, m_rangeWidths.data(), to - from);
+    }
+}
+
+bool TabLayoutEngine::HasIdleMeasure() const {
+    return m_hasIdleMeasure;
+}
+
+void TabLayoutEngine::SetMeasureCacheBudget(size_t bytes) {
+    m_measureCache.SetBudget(bytes);
+}
+
+int TabLayoutEngine::MeasureTab(const std::wstring& title) {
+    if (m_deferMeasure) {
+        // 計測済みの幅は必ず正なので、0 を未計測の印にする
+        m_hasPendingMeasure = true;
+        return 0;
+    }
+    int textWidth = 0;
+    if (!m_measureCache.Find(m_dpi, title, &textWidth)) {
+        m_widthCacheMisses++;
+        textWidth = m_measurer ? m_measurer->MeasureText(title) : 0;
+        if (m_measurer) {
+            m_measureCache.Insert(m_dpi, title, textWidth);
+        }
+    }
+    return textWidth + Scale(TAB_PADDING_X) + GetCloseButtonWidth();
+}
+
+int TabLayoutEngine::MeasureTabAt(int index) {
+    if (m_deferMeasure) {
+        // 保留中は仮想モードのタイトルも問い合わせない
+        m_hasPendingMeasure = true;
+        return 0;
+    }
+    return MeasureTab(GetTitle(index));
+}
+
+void TabLayoutEngine::MeasurePending() {
+    std::vector<int> widths(GetTabCount());
+    m_widths.GetRange(0, (int)widths.size(), widths.data());
+    for (int i = 0; i < (int)widths.size(); ++i) {
+        if (widths[i] == 0) {
+            widths[i] = MeasureTabAt(i);
+        }
+    }
+    m_widths.Assign(widths);
+    m_hasPendingMeasure = false;
+    ReflowAllRows();
+    ClampScrollOffset();
+}
+
+void TabLayoutEngine::ClampScrollOffset() {
+    SetScrollOffset(m_scrollOffset);
+}
+
+void TabLayoutEngine::UpdateIndexMap(int first, int last) {
+    for (int i = first; i <= last; ++i) {
+        m_indexById[m_tabs[i].id] = i;
+    }
+}
+
+void TabLayoutEngine::ReflowRows(int first, int last, int delta) {
+    if (!m_isMultiRow) {
+        return;
+    }
+    // first より前のタブは変わっていないので、その行までは使える。ただし first が
+    // 行頭なら縮んだタブが前の行に収まるかもしれないので、first - 1 の行から組む
+    int row = 0;
+    if (!m_rowStarts.empty() && first > 0) {
+        row = GetRowOfTab(first - 1);
+    }
+    m_oldRowStarts.assign(m_rowStarts.begin() + std::min((int)m_rowStarts.size(), row + 1), m_rowStarts.end());
+    m_rowStarts.resize(row + 1);
+    m_rowStarts[0] = 0;
+
+    int n = GetTabCount();
+    size_t old = 0;
+    int start = m_rowStarts.back();
+    for (;;) {
+        int next = FindRowEnd(start);
+        if (next >= n) {
+            break;
+        }
+        // 変わったタブより後ろで以前と同じ位置から行が始まれば、そこから先の区切りも同じ
+        while (old < m_oldRowStarts.size() && m_oldRowStarts[old] + delta < next) {
+            old++;
+        }
+        if (next > last && old < m_oldRowStarts.size() && m_oldRowStarts[old] + delta == next) {
+            for (; old < m_oldRowStarts.size(); ++old) {
+                m_rowStarts.push_back(m_oldRowStarts[old] + delta);
+            }
+            return;
+        }
+        m_rowStarts.push_back(next);
+        start = next;
+    }
+}
+
+void TabLayoutEngine::ReflowAllRows() {
+    m_rowStarts.clear();
+    ReflowRows(0, GetTabCount() - 1, 0);
+}
+
+int TabLayoutEngine::FindRowEnd(int start) const {
+    int n = GetTabCount();
+    int limit = GetTabOffset(start) + m_clientWidth;
+    if (limit >= m_widths.Total()) {
+        return n;
+    }
+    // limit を含むタブは収まらないので次の行に送る。1 つも収まらなくても 1 つは置く
+    int next = m_widths.FindIndex(limit);
+    if (next == -1) {
+        return n;
+    }
+    return std::max(next, start + 1);
+}
@@ -0,0 +1,198 @@
+﻿#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "TabWidthTree.h"
+#include "TabMeasureCache.h"
+
+// レイアウト定数 (96 DPI 基準)
+#define TAB_PADDING_X 16
+#define TAB_PADDING_Y 8
+#define TAB_ROUND_RADIUS 8
+#define FONT_SIZE 16
+#define SCROLL_BUTTON_WIDTH 30
+#define VIRTUAL_TAB_TEXT_WIDTH 100 // 仮想タブを計測するまでの仮の文字幅 (96 DPI)
+
+// 仮想モードでタイトルを提供するインターフェース。コントロールは
+// タイトルを保持せず、描画・計測・ツールチップのときだけ問い合わせる。
+// OnTabMoved / OnTabClosed はユーザー操作 (ドラッグ・閉じるボタン) で
+// コントロール側の並びが変わった後に呼ばれるので、モデルを合わせること。
+class ITabDataSource {
+public:
+    virtual ~ITabDataSource() {}
+    virtual void GetTabTitle(int index, std::wstring& title) = 0;
+    virtual void OnTabMoved(int /*from*/, int /*to*/) {}
+    virtual void OnTabClosed(int /*index*/) {}
+};
+
+// タブ 1 つ分の情報。ID は追加時に振られ、並べ替えや他のタブの削除では変わらない
+struct TabRecord {
+    unsigned long long id;
+    std::wstring title;
+    std::intptr_t userData;
+};
+
+struct TabRect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+// タイトル文字列の幅を返す計測インターフェース。
+// Win32 では GDI、テストやベンチマークでは固定幅の実装を差し込む。
+class ITabTextMeasurer {
+public:
+    virtual ~ITabTextMeasurer() {}
+    virtual int MeasureText(const std::wstring& text) = 0;
+};
+
+// タブ列のレイアウト計算。Windows API に依存しない。
+// 座標はすべてコントロールのクライアント座標 (スクロール適用後)。
+class TabLayoutEngine {
+public:
+    TabLayoutEngine();
+
+    void SetTextMeasurer(ITabTextMeasurer* measurer);
+    // DPI が変わったら、その DPI で計測済みのタイトルは表から引き、
+    // ないものは前の DPI の幅を拡大縮小した概算にしておく。概算は MeasureIdle で計測し直す
+    void SetDpi(int dpi);
+    int GetDpi() const;
+    void SetClientWidth(int width);
+    int GetClientWidth() const;
+
+    // タブの追加・削除・変更。計測は変化したタブだけ行う。
+    // 追加したタブの ID (複数なら先頭の ID、以降は連番) を返す。
+    // reservedId を渡すと ReserveTabId で取っておいた ID を使う
+    unsigned long long AddTab(const std::wstring& title, std::intptr_t userData = 0, unsigned long long reservedId = 0);
+    unsigned long long InsertTabs(int index, const std::vector<std::wstring>& titles);
+    void RemoveTab(int index);
+    void RemoveTabs(int index, int count);
+    void RenameTab(int index, const std::wstring& title);
+    void MoveTab(int from, int to);
+    // フォントが変わったときに呼ぶ。DPI ごとの計測結果も捨てる
+    void RemeasureAll();
+    // 計測を保留する。保留中に追加・変更したタブは幅 0 のまま置いておき、
+    // 保留を解除したときにまとめて計測してレイアウトを 1 回で作り直す
+    void SetDeferMeasure(bool defer);
+    int GetTabCount() const;
+    // 仮想モードでは内部のバッファを返すので、次の呼び出しまでしか有効でない
+    const std::wstring& GetTitle(int index) const;
+
+    // 仮想モード。dataSource を設定するとタブの情報は幅だけを持ち、
+    // AddTab / InsertTabs / RenameTab は無視される。nullptr で通常モードに戻る (タブは空)
+    void SetDataSource(ITabDataSource* dataSource, int count);
+    ITabDataSource* GetDataSource() const;
+    void InsertVirtualTabs(int index, int count);
+    // index のタイトルが変わったときに計測し直す (両モード共通)
+    void RemeasureTab(int index);
+    unsigned long long GetTabId(int index) const;
+    // 追加より先に ID だけを取る。どのスレッドから呼んでもよい
+    unsigned long long ReserveTabId();
+    // 描画用のキャッシュや状態表示のキー。通常モードでは ID、仮想モードでは最上位ビットを立てたインデックス
+    unsigned long long GetTabKey(int index) const;
+    // ID からインデックスを O(1) で引く。なければ -1
+    int FindTab(unsigned long long id) const;
+    std::intptr_t GetUserData(int index) const;
+    void SetUserData(int index, std::intptr_t userData);
+
+    int Scale(int value) const;
+    int GetTabHeight() const;
+    int GetCloseButtonWidth() const;
+    int GetScrollButtonWidth() const;
+
+    int GetTabWidth(int index) const;
+    int GetTabOffset(int index) const;
+    int GetTotalWidth() const;
+    bool HasScrollButtons() const;
+    int GetViewWidth() const;
+    TabRect GetTabRect(int index) const;
+    TabRect GetCloseButtonRect(const TabRect& tabRect) const;
+    TabRect GetTextRect(const TabRect& tabRect) const;
+    TabRect GetScrollLeftRect() const;
+    TabRect GetScrollRightRect() const;
+    // タブがはみ出したときにスクロールボタンの右に出すタブ一覧ボタン
+    TabRect GetOverflowButtonRect() const;
+    // 表示領域に少しでもかかるタブの範囲。なければ *first > *last
+    void GetVisibleRange(int* first, int* last) const;
+    // クライアント座標 [left, right) にかかるタブの範囲。なければ *first > *last
+    void GetTabsInRange(int left, int right, int* first, int* last) const;
+    // ドラッグ中に targetIndex へ挿入するとき、index のタブがずれる量
+    int GetDragShift(int index, int draggedIndex, int targetIndex) const;
+
+    // 複数行モード (TCS_MULTILINE 相当)。タブを折り返して並べ、スクロールはしない。
+    // 行の区切りは変更のあったタブの行から後ろだけ計算し直す
+    void SetMultiRow(bool multiRow);
+    bool IsMultiRow() const;
+    int GetRowCount() const;
+    int GetRowOfTab(int index) const;
+    // row 行目のタブの範囲。なければ *first > *last
+    void GetRowRange(int row, int* first, int* last) const;
+    // すべてのタブを表示するのに必要な高さ。1 行モードではタブの高さ
+    int GetRequiredHeight() const;
+
+    int GetScrollOffset() const;
+    int GetMaxScrollOffset() const;
+    void SetScrollOffset(int offset);
+    void ScrollBy(int delta);
+    void EnsureVisible(int index);
+
+    int HitTest(int x, int y, bool isDragging, bool* isCloseButton, bool* isScrollLeft, bool* isScrollRight) const;
+    int GetDropIndex(int x, int y, int hoveredTab, int draggedTab) const;
+
+    unsigned long long GetWidthCacheHits() const;
+    unsigned long long GetWidthCacheMisses() const;
+
+    // SetDpi で概算にしたタブや仮の幅で追加した仮想タブを最大 maxTabs 個計測する。
+    // スクロールなどで見えるようになったタブは先に計測する。幅が変わったら *isChanged を true にする。
+    // まだ残っていれば true
+    bool MeasureIdle(int maxTabs, bool* isChanged);
+    bool HasIdleMeasure() const;
+    // 0 (既定) ならタブ数から自動で決める (TabMeasureCache::SetBudget)
+    void SetMeasureCacheBudget(size_t bytes);
+
+private:
+    int MeasureTab(const std::wstring& title);
+    int MeasureTabAt(int index);
+    void MeasurePending();
+    // [from, to) のタブを計測し直し、幅が変わった範囲を *first, *last に広げる
+    void RemeasureRange(int from, int to, int* first, int* last);
+    void ClampScrollOffset();
+    // [first, last] のタブの ID → インデックスを振り直す
+    void UpdateIndexMap(int first, int last);
+    // [first, last] のタブが変わり、その後ろのタブが delta 個ずれたときに行を組み直す
+    void ReflowRows(int first, int last, int delta);
+    void ReflowAllRows();
+    // start から始まる行の次の行の先頭
+    int FindRowEnd(int start) const;
+
+    ITabTextMeasurer* m_measurer;
+    int m_dpi;
+    TabMeasureCache m_measureCache;
+    bool m_hasIdleMeasure;
+    bool m_isVisibleMeasurePending; // 表示範囲のタブを次の MeasureIdle で先に計測する
+    int m_idleCursor; // MeasureIdle で次に調べるタブ
+    int m_clientWidth;
+    int m_scrollOffset;
+    bool m_deferMeasure;
+    bool m_hasPendingMeasure;
+    ITabDataSource* m_dataSource;
+    mutable std::wstring m_titleBuffer;
+    // タブは並び順の配列に持ち、ID → インデックスの表で FindTab を O(1) にしている。
+    // その代わり途中への挿入・削除・移動は、配列の詰め直しと後ろのタブの表の振り直しで O(n) かかる
+    // (10 万タブで先頭の削除が 1 ms 台)。並びを木に持てば O(log n) にできるが、FindTab と
+    // インデックスからの参照が O(log n) になり、描画のたびに呼ぶ側が遅くなるのでこちらを選んでいる
+    std::vector<TabRecord> m_tabs;
+    std::unordered_map<unsigned long long, int> m_indexById;
+    std::atomic<unsigned long long> m_nextId; // ReserveTabId はワーカースレッドからも呼ばれる
+    TabWidthTree m_widths; // m_tabs と同じ並びの計測済みタブ幅
+    bool m_isMultiRow;
+    std::vector<int> m_rowStarts; // 各行の先頭のタブ (複数行モードのみ)
+    std::vector<int> m_oldRowStarts; // 組み直し用の作業領域
+    std::vector<int> m_rangeWidths; // RemeasureRange の作業領域
+    mutable unsigned long long m_widthCacheHits;
+    unsigned long long m_widthCacheMisses;
+};
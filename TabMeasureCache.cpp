@@ -0,0 +1,127 @@
+﻿#include "TabMeasureCache.h"
+#include <algorithm>
+
+// ハッシュ表のノードと文字列のヘッダーの概算
+#define MEASURE_ENTRY_OVERHEAD 64
+// まだ何も覚えていないときに見込む 1 件のタイトルの長さ
+#define MEASURE_TYPICAL_TITLE_LENGTH 30
+
+static size_t GetEntrySize(const std::wstring& title) {
+    return (title.length() + 1) * sizeof(wchar_t) + MEASURE_ENTRY_OVERHEAD;
+}
+
+TabMeasureCache::TabMeasureCache()
+    : m_budget(0), m_titleCount(0), m_entryCount(0), m_usedBytes(0), m_useCount(0) {
+}
+
+void TabMeasureCache::SetBudget(size_t bytes) {
+    m_budget = bytes;
+    MakeRoom(-1, 0);
+}
+
+void TabMeasureCache::SetTitleCount(int count) {
+    m_titleCount = count;
+}
+
+size_t TabMeasureCache::GetBudget() const {
+    return GetEffectiveBudget();
+}
+
+size_t TabMeasureCache::GetEffectiveBudget() const {
+    if (m_budget != 0) {
+        return m_budget;
+    }
+    size_t entrySize = m_entryCount > 0 ? m_usedBytes / m_entryCount
+        : (MEASURE_TYPICAL_TITLE_LENGTH + 1) * sizeof(wchar_t) + MEASURE_ENTRY_OVERHEAD;
+    size_t budget = (size_t)m_titleCount * entrySize * TAB_MEASURE_CACHE_DPI_COUNT;
+    budget += budget / 4;
+    return std::min(std::max(budget, (size_t)TAB_MEASURE_CACHE_BUDGET), (size_t)TAB_MEASURE_CACHE_MAX_BUDGET);
+}
+
+size_t TabMeasureCache::GetUsedBytes() const {
+    return m_usedBytes;
+}
+
+int TabMeasureCache::GetDpiCount() const {
+    return (int)m_tables.size();
+}
+
+bool TabMeasureCache::Find(int dpi, const std::wstring& title, int* width) {
+    Table* table = FindTable(dpi);
+    if (!table) {
+        return false;
+    }
+    std::unordered_map<std::wstring, int>::const_iterator it = table->widths.find(title);
+    if (it == table->widths.end()) {
+        return false;
+    }
+    table->lastUse = ++m_useCount;
+    *width = it->second;
+    return true;
+}
+
+void TabMeasureCache::Insert(int dpi, const std::wstring& title, int width) {
+    Table* table = FindTable(dpi);
+    if (table) {
+        std::unordered_map<std::wstring, int>::iterator it = table->widths.find(title);
+        if (it != table->widths.end()) {
+            it->second = width;
+            table->lastUse = ++m_useCount;
+            return;
+        }
+    }
+    size_t size = GetEntrySize(title);
+    if (!MakeRoom(dpi, size)) {
+        // 今の DPI だけで上限に達したら、それ以上は覚えない
+        return;
+    }
+    // MakeRoom で表が捨てられると位置が変わるので引き直す
+    table = FindTable(dpi);
+    if (!table) {
+        Table newTable;
+        newTable.dpi = dpi;
+        newTable.lastUse = 0;
+        newTable.bytes = 0;
+        m_tables.push_back(std::move(newTable));
+        table = &m_tables.back();
+    }
+    table->widths.emplace(title, width);
+    table->bytes += size;
+    table->lastUse = ++m_useCount;
+    m_usedBytes += size;
+    m_entryCount++;
+}
+
+void TabMeasureCache::Clear() {
+    m_tables.clear();
+    m_usedBytes = 0;
+    m_entryCount = 0;
+}
+
+TabMeasureCache::Table* TabMeasureCache::FindTable(int dpi) {
+    for (size_t i = 0; i < m_tables.size(); ++i) {
+        if (m_tables[i].dpi == dpi) {
+            return &m_tables[i];
+        }
+    }
+    return nullptr;
+}
+
+bool TabMeasureCache::MakeRoom(int keepDpi, size_t size) {
+    size_t budget = GetEffectiveBudget();
+    while (m_usedBytes + size > budget) {
+        int oldest = -1;
+        for (int i = 0; i < (int)m_tables.size(); ++i) {
+            if (m_tables[i].dpi != keepDpi && (oldest < 0 || m_tables[i].lastUse < m_tables[oldest].lastUse)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return false;
+        }
+        m_usedBytes -= m_tables[oldest].bytes;
+        m_entryCount -= m_tables[oldest].widths.size();
+        m_tables.erase(m_tables.begin() + oldest);
+    }
+    return true;
+}
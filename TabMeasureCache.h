@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// 自動で決める上限の下限と上限。タイトル 30 文字なら 2 MB で 2 万件ほど
+#define TAB_MEASURE_CACHE_BUDGET (2 * 1024 * 1024)
+#define TAB_MEASURE_CACHE_MAX_BUDGET (64 * 1024 * 1024)
+// 自動の上限で全タブを覚えておく DPI の数 (2 台のモニターを行き来する分)。
+// 1 件の大きさは平均なので、実際には 1/4 の余裕を足す
+#define TAB_MEASURE_CACHE_DPI_COUNT 2
+
+// DPI ごとのタイトル → 文字列幅の表。モニター間を行き来しても、
+// 一度計測した DPI では計測し直さずに表から引く。Windows API に依存しない。
+// 幅はタイトルと DPI だけで決まるものとする (フォントの種類を変えたら Clear)
+class TabMeasureCache {
+public:
+    TabMeasureCache();
+
+    // 上限を超えたら最後に使ってから最も時間のたった DPI の表から捨てる。
+    // 0 (既定) なら上限は自動で、タブ数 x 1 件の平均バイト数 x TAB_MEASURE_CACHE_DPI_COUNT (と余裕) を
+    // TAB_MEASURE_CACHE_BUDGET から TAB_MEASURE_CACHE_MAX_BUDGET の間に収めたもの。
+    // 0 以外なら固定で、全タブの 2 つの DPI 分に足りなければ、戻ったモニターでは計測し直しになる
+    void SetBudget(size_t bytes);
+    // 自動の上限に使うタブ数
+    void SetTitleCount(int count);
+    size_t GetBudget() const;
+    size_t GetUsedBytes() const;
+    int GetDpiCount() const;
+
+    bool Find(int dpi, const std::wstring& title, int* width);
+    void Insert(int dpi, const std::wstring& title, int width);
+    void Clear();
+
+private:
+    struct Table {
+        int dpi;
+        unsigned long long lastUse;
+        size_t bytes;
+        std::unordered_map<std::wstring, int> widths;
+    };
+
+    Table* FindTable(int dpi);
+    // keepDpi 以外の表を古い順に捨て、size バイト入る余地を作る
+    bool MakeRoom(int keepDpi, size_t size);
+
+    size_t GetEffectiveBudget() const;
+
+    std::vector<Table> m_tables;
+    size_t m_budget; // 0 なら自動
+    int m_titleCount;
+    size_t m_entryCount;
+    size_t m_usedBytes;
+    unsigned long long m_useCount;
+};
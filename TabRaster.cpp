@@ -0,0 +1,499 @@
+﻿#include "TabRaster.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// 使う命令セットはコンパイル時に決める。TAB_RASTER_NO_SIMD でスカラー版に固定できる
+#if !defined(TAB_RASTER_NO_SIMD) && defined(__AVX2__)
+#define TAB_RASTER_AVX2
+#include <immintrin.h>
+#elif !defined(TAB_RASTER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TAB_RASTER_SSE2
+#include <emmintrin.h>
+#endif
+
+// アンチエイリアスの 1 辺あたりのサンプル数
+#define RASTER_SAMPLES 4
+// 使い回すマスクの数
+#define RASTER_MASK_CACHE_SIZE 8
+#define RASTER_MASK_CROSS 1
+#define RASTER_MASK_TRIANGLE 2
+#define RASTER_MASK_ROUND_RECT 3
+
+// a * b / 255 を丸めたもの。SIMD 版も 16 ビットの同じ式で計算する
+static inline uint32_t Mul255(uint32_t a, uint32_t b) {
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline uint32_t ScalePixel(uint32_t color, uint32_t scale) {
+    return (Mul255(color >> 24, scale) << 24) | (Mul255((color >> 16) & 0xff, scale) << 16) |
+        (Mul255((color >> 8) & 0xff, scale) << 8) | Mul255(color & 0xff, scale);
+}
+
+// 乗算済みアルファの src over dst。チャンネルごとに 255 で飽和させる
+static inline uint32_t BlendPixel(uint32_t dst, uint32_t src) {
+    uint32_t inv = 255 - (src >> 24);
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t c = ((src >> shift) & 0xff) + Mul255((dst >> shift) & 0xff, inv);
+        result |= std::min(c, 255u) << shift;
+    }
+    return result;
+}
+
+static inline uint8_t SamplesToCoverage(int samples) {
+    return (uint8_t)((samples * 255 + RASTER_SAMPLES * RASTER_SAMPLES / 2) / (RASTER_SAMPLES * RASTER_SAMPLES));
+}
+
+// AVX2 でも 8 ピクセルに満たない残り (グリフの行など) は SSE2 で 4 ピクセルずつ処理する
+#if defined(TAB_RASTER_AVX2) || defined(TAB_RASTER_SSE2)
+#define TAB_RASTER_SIMD128
+#endif
+
+#if defined(TAB_RASTER_AVX2)
+
+static inline __m256i Mul255x16(__m256i a, __m256i b) {
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// 16 ビットに広げたピクセルのアルファを各チャンネルに配る
+static inline __m256i BroadcastAlpha(__m256i pixels) {
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, 0xFF), 0xFF);
+}
+
+#endif
+
+#if defined(TAB_RASTER_SIMD128)
+
+static inline __m128i Mul255x8(__m128i a, __m128i b) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static inline __m128i BroadcastAlpha(__m128i pixels) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xFF), 0xFF);
+}
+
+#endif
+
+void TabFillSpan(uint32_t* dst, int count, uint32_t color) {
+    int i = 0;
+#if defined(TAB_RASTER_AVX2)
+    __m256i c = _mm256_set1_epi32((int)color);
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i*)(dst + i), c);
+    }
+#endif
+#if defined(TAB_RASTER_SIMD128)
+    __m128i c4 = _mm_set1_epi32((int)color);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(dst + i), c4);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = color;
+    }
+}
+
+void TabBlendSpan(uint32_t* dst, int count, uint32_t color) {
+    uint32_t alpha = color >> 24;
+    if (alpha == 255) {
+        TabFillSpan(dst, count, color);
+        return;
+    }
+    if (color == 0) {
+        return;
+    }
+    int i = 0;
+#if defined(TAB_RASTER_AVX2)
+    __m256i zero8 = _mm256_setzero_si256();
+    __m256i src8 = _mm256_set1_epi32((int)color);
+    __m256i inv8 = _mm256_set1_epi16((short)(255 - alpha));
+    for (; i + 8 <= count; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i lo = Mul255x16(_mm256_unpacklo_epi8(d, zero8), inv8);
+        __m256i hi = Mul255x16(_mm256_unpackhi_epi8(d, zero8), inv8);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_adds_epu8(src8, _mm256_packus_epi16(lo, hi)));
+    }
+#endif
+#if defined(TAB_RASTER_SIMD128)
+    __m128i zero = _mm_setzero_si128();
+    __m128i src = _mm_set1_epi32((int)color);
+    __m128i inv = _mm_set1_epi16((short)(255 - alpha));
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = Mul255x8(_mm_unpacklo_epi8(d, zero), inv);
+        __m128i hi = Mul255x8(_mm_unpackhi_epi8(d, zero), inv);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(src, _mm_packus_epi16(lo, hi)));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = BlendPixel(dst[i], color);
+    }
+}
+
+void TabBlendSpanMask(uint32_t* dst, int count, uint32_t color, const uint8_t* coverage) {
+    int i = 0;
+#if defined(TAB_RASTER_AVX2)
+    __m256i zero8 = _mm256_setzero_si256();
+    __m256i full8 = _mm256_set1_epi16(255);
+    __m256i color8 = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero8);
+    for (; i + 8 <= count; i += 8) {
+        __m128i bytes = _mm_loadl_epi64((const __m128i*)(coverage + i));
+        if (_mm_cvtsi128_si32(bytes) == 0 && _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4)) == 0) {
+            continue;
+        }
+        // 8 個のカバレッジをそれぞれのピクセルの 4 バイトに配る
+        __m256i cov = _mm256_cvtepu8_epi32(bytes);
+        cov = _mm256_or_si256(cov, _mm256_slli_epi32(cov, 8));
+        cov = _mm256_or_si256(cov, _mm256_slli_epi32(cov, 16));
+        __m256i srcLo = Mul255x16(color8, _mm256_unpacklo_epi8(cov, zero8));
+        __m256i srcHi = Mul255x16(color8, _mm256_unpackhi_epi8(cov, zero8));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i lo = Mul255x16(_mm256_unpacklo_epi8(d, zero8), _mm256_sub_epi16(full8, BroadcastAlpha(srcLo)));
+        __m256i hi = Mul255x16(_mm256_unpackhi_epi8(d, zero8), _mm256_sub_epi16(full8, BroadcastAlpha(srcHi)));
+        lo = _mm256_add_epi16(lo, srcLo);
+        hi = _mm256_add_epi16(hi, srcHi);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+#endif
+#if defined(TAB_RASTER_SIMD128)
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi16(255);
+    __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    for (; i + 4 <= count; i += 4) {
+        int bytes;
+        memcpy(&bytes, coverage + i, sizeof(bytes));
+        if (bytes == 0) {
+            continue;
+        }
+        // 4 個のカバレッジをそれぞれのピクセルの 4 バイトに配る
+        __m128i cov = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+        cov = _mm_or_si128(cov, _mm_slli_epi32(cov, 8));
+        cov = _mm_or_si128(cov, _mm_slli_epi32(cov, 16));
+        __m128i srcLo = Mul255x8(color16, _mm_unpacklo_epi8(cov, zero));
+        __m128i srcHi = Mul255x8(color16, _mm_unpackhi_epi8(cov, zero));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = Mul255x8(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(full, BroadcastAlpha(srcLo)));
+        __m128i hi = Mul255x8(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(full, BroadcastAlpha(srcHi)));
+        lo = _mm_add_epi16(lo, srcLo);
+        hi = _mm_add_epi16(hi, srcHi);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; ++i) {
+        uint32_t c = coverage[i];
+        if (c != 0) {
+            dst[i] = BlendPixel(dst[i], ScalePixel(color, c));
+        }
+    }
+}
+
+const char* TabGetRasterSimdName() {
+#if defined(TAB_RASTER_AVX2)
+    return "avx2";
+#elif defined(TAB_RASTER_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+TabRaster::TabRaster()
+    : m_pixels(NULL), m_width(0), m_height(0), m_stride(0),
+    m_clipLeft(0), m_clipTop(0), m_clipRight(0), m_clipBottom(0),
+    m_cornerDiameter(-1), m_cornerSize(0), m_nextMask(0) {
+}
+
+void TabRaster::Resize(int width, int height) {
+    width = std::max(width, 0);
+    height = std::max(height, 0);
+    size_t size = (size_t)width * height;
+    if (m_storage.size() < size) {
+        m_storage.resize(size);
+    }
+    Attach(m_storage.empty() ? NULL : m_storage.data(), width, height, width);
+}
+
+void TabRaster::Attach(uint32_t* pixels, int width, int height, int stride) {
+    m_pixels = pixels;
+    m_width = width;
+    m_height = height;
+    m_stride = stride;
+    SetClip(0, 0, width, height);
+}
+
+uint32_t* TabRaster::GetPixels() const {
+    return m_pixels;
+}
+
+int TabRaster::GetWidth() const {
+    return m_width;
+}
+
+int TabRaster::GetHeight() const {
+    return m_height;
+}
+
+int TabRaster::GetStride() const {
+    return m_stride;
+}
+
+void TabRaster::SetClip(int left, int top, int right, int bottom) {
+    m_clipLeft = std::max(left, 0);
+    m_clipTop = std::max(top, 0);
+    m_clipRight = std::max(std::min(right, m_width), m_clipLeft);
+    m_clipBottom = std::max(std::min(bottom, m_height), m_clipTop);
+}
+
+void TabRaster::IntersectClip(int left, int top, int right, int bottom) {
+    SetClip(std::max(left, m_clipLeft), std::max(top, m_clipTop), std::min(right, m_clipRight), std::min(bottom, m_clipBottom));
+}
+
+void TabRaster::GetClip(int* left, int* top, int* right, int* bottom) const {
+    *left = m_clipLeft;
+    *top = m_clipTop;
+    *right = m_clipRight;
+    *bottom = m_clipBottom;
+}
+
+bool TabRaster::IsClipEmpty() const {
+    return m_clipLeft >= m_clipRight || m_clipTop >= m_clipBottom;
+}
+
+void TabRaster::FillRow(int y, int left, int right, uint32_t color) {
+    if (y < m_clipTop || y >= m_clipBottom) {
+        return;
+    }
+    left = std::max(left, m_clipLeft);
+    right = std::min(right, m_clipRight);
+    if (left < right) {
+        TabBlendSpan(m_pixels + (size_t)y * m_stride + left, right - left, color);
+    }
+}
+
+void TabRaster::BlendRow(int y, int left, int count, const uint8_t* coverage, uint32_t color) {
+    if (y < m_clipTop || y >= m_clipBottom) {
+        return;
+    }
+    int right = std::min(left + count, m_clipRight);
+    if (left < m_clipLeft) {
+        coverage += m_clipLeft - left;
+        left = m_clipLeft;
+    }
+    if (left < right) {
+        TabBlendSpanMask(m_pixels + (size_t)y * m_stride + left, right - left, color, coverage);
+    }
+}
+
+void TabRaster::FillRect(int left, int top, int right, int bottom, uint32_t color) {
+    top = std::max(top, m_clipTop);
+    bottom = std::min(bottom, m_clipBottom);
+    for (int y = top; y < bottom; ++y) {
+        FillRow(y, left, right, color);
+    }
+}
+
+void TabRaster::BuildCorner(int diameter) {
+    if (diameter == m_cornerDiameter) {
+        return;
+    }
+    // 直径 diameter の円を左上に置いたときの、角の部分のカバレッジ
+    m_cornerDiameter = diameter;
+    m_cornerSize = (diameter + 1) / 2;
+    m_cornerLeft.assign((size_t)m_cornerSize * m_cornerSize, 255);
+    m_cornerRight.assign(m_cornerLeft.size(), 255);
+    double radius = diameter / 2.0;
+    for (int y = 0; y < m_cornerSize; ++y) {
+        for (int x = 0; x < m_cornerSize; ++x) {
+            int samples = 0;
+            for (int sy = 0; sy < RASTER_SAMPLES; ++sy) {
+                double dy = radius - (y + (sy + 0.5) / RASTER_SAMPLES);
+                for (int sx = 0; sx < RASTER_SAMPLES; ++sx) {
+                    double dx = radius - (x + (sx + 0.5) / RASTER_SAMPLES);
+                    if (dx <= 0.0 || dy <= 0.0 || dx * dx + dy * dy <= radius * radius) {
+                        samples++;
+                    }
+                }
+            }
+            m_cornerLeft[(size_t)y * m_cornerSize + x] = SamplesToCoverage(samples);
+            m_cornerRight[(size_t)y * m_cornerSize + (m_cornerSize - 1 - x)] = SamplesToCoverage(samples);
+        }
+    }
+}
+
+void TabRaster::FillRoundedTab(int left, int top, int right, int bottom, int diameter, uint32_t color) {
+    BuildCorner(std::max(diameter, 0));
+    int width = right - left;
+    if (width <= 0) {
+        return;
+    }
+    // 角の部分の行だけカバレッジで重ね、残りは 1 回で塗る
+    int leftCount = std::min(m_cornerSize, (width + 1) / 2);
+    int rightCount = std::min(m_cornerSize, width / 2);
+    int cornerRows = std::min(m_cornerSize, bottom - top);
+    for (int row = 0; row < cornerRows; ++row) {
+        int y = top + row;
+        if (y < m_clipTop || y >= m_clipBottom) {
+            continue;
+        }
+        const uint8_t* coverageLeft = &m_cornerLeft[(size_t)row * m_cornerSize];
+        const uint8_t* coverageRight = &m_cornerRight[(size_t)row * m_cornerSize + (m_cornerSize - rightCount)];
+        BlendRow(y, left, leftCount, coverageLeft, color);
+        FillRow(y, left + leftCount, right - rightCount, color);
+        BlendRow(y, right - rightCount, rightCount, coverageRight, color);
+    }
+    FillRect(left, top + cornerRows, right, bottom, color);
+}
+
+void TabRaster::FillRoundRect(double left, double top, double right, double bottom, double radius, uint32_t color) {
+    radius = std::max(0.0, std::min(radius, std::min(right - left, bottom - top) / 2.0));
+    int x0 = (int)std::floor(left);
+    int y0 = (int)std::floor(top);
+    int width = (int)std::ceil(right) - x0;
+    int height = (int)std::ceil(bottom) - y0;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    double key[6] = { left - x0, top - y0, right - x0, bottom - y0, radius, 0.0 };
+    bool isNew = false;
+    Mask* mask = FindMask(RASTER_MASK_ROUND_RECT, key, width, height, &isNew);
+    if (isNew) {
+        double l = key[0];
+        double t = key[1];
+        double r = key[2];
+        double b = key[3];
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                int samples = 0;
+                for (int sy = 0; sy < RASTER_SAMPLES; ++sy) {
+                    double py = y + (sy + 0.5) / RASTER_SAMPLES;
+                    for (int sx = 0; sx < RASTER_SAMPLES; ++sx) {
+                        double px = x + (sx + 0.5) / RASTER_SAMPLES;
+                        if (px < l || px > r || py < t || py > b) {
+                            continue;
+                        }
+                        // 角の円の中心からの距離 (角以外では 0)
+                        double dx = px - std::max(l + radius, std::min(px, r - radius));
+                        double dy = py - std::max(t + radius, std::min(py, b - radius));
+                        if (dx * dx + dy * dy <= radius * radius) {
+                            samples++;
+                        }
+                    }
+                }
+                mask->coverage[(size_t)y * width + x] = SamplesToCoverage(samples);
+            }
+        }
+    }
+    BlitMask(x0, y0, mask->coverage.data(), width, height, width, color);
+}
+
+// (px, py) から線分 (x0, y0) - (x1, y1) までの距離
+static double DistanceToSegment(double px, double py, double x0, double y0, double x1, double y1) {
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    double lengthSq = dx * dx + dy * dy;
+    double t = lengthSq > 0.0 ? ((px - x0) * dx + (py - y0) * dy) / lengthSq : 0.0;
+    t = std::max(0.0, std::min(t, 1.0));
+    double ex = px - (x0 + t * dx);
+    double ey = py - (y0 + t * dy);
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+TabRaster::Mask* TabRaster::FindMask(int kind, const double* key, int width, int height, bool* isNew) {
+    for (Mask& mask : m_masks) {
+        if (mask.kind == kind && mask.width == width && mask.height == height &&
+            std::equal(key, key + 6, mask.key)) {
+            *isNew = false;
+            return &mask;
+        }
+    }
+    if ((int)m_masks.size() < RASTER_MASK_CACHE_SIZE) {
+        m_masks.push_back(Mask());
+        m_nextMask = (int)m_masks.size() - 1;
+    }
+    Mask& mask = m_masks[m_nextMask];
+    m_nextMask = (m_nextMask + 1) % RASTER_MASK_CACHE_SIZE;
+    mask.kind = kind;
+    std::copy(key, key + 6, mask.key);
+    mask.width = width;
+    mask.height = height;
+    mask.coverage.assign((size_t)width * height, 0);
+    *isNew = true;
+    return &mask;
+}
+
+void TabRaster::FillCross(double left, double top, double right, double bottom, double thickness, uint32_t color) {
+    double halfWidth = thickness / 2.0;
+    int x0 = (int)std::floor(left - halfWidth - 1.0);
+    int y0 = (int)std::floor(top - halfWidth - 1.0);
+    int width = (int)std::ceil(right + halfWidth + 1.0) - x0;
+    int height = (int)std::ceil(bottom + halfWidth + 1.0) - y0;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    double key[6] = { left - x0, top - y0, right - x0, bottom - y0, thickness, 0.0 };
+    bool isNew = false;
+    Mask* mask = FindMask(RASTER_MASK_CROSS, key, width, height, &isNew);
+    if (isNew) {
+        // ピクセルの中心から線までの距離でカバレッジを決める (幅 1 の箱フィルタの近似)
+        for (int y = 0; y < height; ++y) {
+            double py = y + 0.5;
+            for (int x = 0; x < width; ++x) {
+                double px = x + 0.5;
+                double distance = std::min(DistanceToSegment(px, py, key[0], key[1], key[2], key[3]),
+                    DistanceToSegment(px, py, key[0], key[3], key[2], key[1]));
+                double coverage = std::max(0.0, std::min(halfWidth + 0.5 - distance, 1.0));
+                mask->coverage[(size_t)y * width + x] = (uint8_t)(coverage * 255.0 + 0.5);
+            }
+        }
+    }
+    BlitMask(x0, y0, mask->coverage.data(), width, height, width, color);
+}
+
+void TabRaster::FillTriangle(double x0, double y0, double x1, double y1, double x2, double y2, uint32_t color) {
+    int left = (int)std::floor(std::min(x0, std::min(x1, x2)));
+    int top = (int)std::floor(std::min(y0, std::min(y1, y2)));
+    int width = (int)std::ceil(std::max(x0, std::max(x1, x2))) - left;
+    int height = (int)std::ceil(std::max(y0, std::max(y1, y2))) - top;
+    // 向きによらず内側を正にする
+    double area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+    if (area == 0.0 || width <= 0 || height <= 0) {
+        return;
+    }
+    double key[6] = { x0 - left, y0 - top, x1 - left, y1 - top, x2 - left, y2 - top };
+    bool isNew = false;
+    Mask* mask = FindMask(RASTER_MASK_TRIANGLE, key, width, height, &isNew);
+    if (isNew) {
+        double sign = area > 0.0 ? 1.0 : -1.0;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                int samples = 0;
+                for (int sy = 0; sy < RASTER_SAMPLES; ++sy) {
+                    double py = y + (sy + 0.5) / RASTER_SAMPLES;
+                    for (int sx = 0; sx < RASTER_SAMPLES; ++sx) {
+                        double px = x + (sx + 0.5) / RASTER_SAMPLES;
+                        double e0 = ((key[2] - key[0]) * (py - key[1]) - (key[3] - key[1]) * (px - key[0])) * sign;
+                        double e1 = ((key[4] - key[2]) * (py - key[3]) - (key[5] - key[3]) * (px - key[2])) * sign;
+                        double e2 = ((key[0] - key[4]) * (py - key[5]) - (key[1] - key[5]) * (px - key[4])) * sign;
+                        if (e0 >= 0.0 && e1 >= 0.0 && e2 >= 0.0) {
+                            samples++;
+                        }
+                    }
+                }
+                mask->coverage[(size_t)y * width + x] = SamplesToCoverage(samples);
+            }
+        }
+    }
+    BlitMask(left, top, mask->coverage.data(), width, height, width, color);
+}
+
+void TabRaster::BlitMask(int x, int y, const uint8_t* mask, int width, int height, int maskStride, uint32_t color) {
+    int top = std::max(y, m_clipTop);
+    int bottom = std::min(y + height, m_clipBottom);
+    for (int row = top; row < bottom; ++row) {
+        BlendRow(row, x, width, mask + (size_t)(row - y) * maskStride, color);
+    }
+}
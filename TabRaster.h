@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 乗算済みアルファの 32bpp の色。メモリ上は B, G, R, A の順 (32bpp の DIB と同じ)
+inline uint32_t TabRasterColor(int r, int g, int b, int a = 255) {
+    return ((uint32_t)a << 24) | ((uint32_t)((r * a + 127) / 255) << 16) |
+        ((uint32_t)((g * a + 127) / 255) << 8) | (uint32_t)((b * a + 127) / 255);
+}
+
+// スパン (1 行の連続したピクセル) 単位の塗りつぶしと合成。
+// SSE2 / AVX2 の有無はコンパイル時に決まり、どれを使っても結果は 1 ビットも変わらない
+void TabFillSpan(uint32_t* dst, int count, uint32_t color);
+void TabBlendSpan(uint32_t* dst, int count, uint32_t color);
+// coverage (0 - 255) の割合で color を重ねる
+void TabBlendSpanMask(uint32_t* dst, int count, uint32_t color, const uint8_t* coverage);
+// "avx2" / "sse2" / "scalar"
+const char* TabGetRasterSimdName();
+
+// 32bpp の乗算済みアルファのバッファに描くソフトウェアラスタライザ。
+// Windows API に依存しない。縁はカバレッジで塗ってアンチエイリアスする。
+// 座標はピクセル単位で、ピクセル (x, y) の中心は (x + 0.5, y + 0.5)
+class TabRaster {
+public:
+    TabRaster();
+
+    // 自分でバッファを持つ。大きくなるときだけ確保し直す。クリップは全体に戻る
+    void Resize(int width, int height);
+    // 外のバッファに描く。stride はピクセル単位
+    void Attach(uint32_t* pixels, int width, int height, int stride);
+    uint32_t* GetPixels() const;
+    int GetWidth() const;
+    int GetHeight() const;
+    int GetStride() const;
+
+    // バッファの範囲と交差させたものがクリップになる
+    void SetClip(int left, int top, int right, int bottom);
+    void IntersectClip(int left, int top, int right, int bottom);
+    void GetClip(int* left, int* top, int* right, int* bottom) const;
+    bool IsClipEmpty() const;
+
+    void FillRect(int left, int top, int right, int bottom, uint32_t color);
+    // 上の 2 つの角を丸めたタブ。diameter は TabShapeMask と同じく角の円の直径
+    void FillRoundedTab(int left, int top, int right, int bottom, int diameter, uint32_t color);
+    // 4 つの角を半径 radius で丸めた四角形。縦横の半分を半径にすれば円・楕円になる
+    void FillRoundRect(double left, double top, double right, double bottom, double radius, uint32_t color);
+    // (left, top) - (right, bottom) の 2 本の対角線 (閉じるボタンの ×)
+    void FillCross(double left, double top, double right, double bottom, double thickness, uint32_t color);
+    void FillTriangle(double x0, double y0, double x1, double y1, double x2, double y2, uint32_t color);
+    // 8 ビットのカバレッジのマスク (グリフなど) を (x, y) に color で重ねる
+    void BlitMask(int x, int y, const uint8_t* mask, int width, int height, int maskStride, uint32_t color);
+
+private:
+    // y 行目の [left, right) をクリップして塗る
+    void FillRow(int y, int left, int right, uint32_t color);
+    // y 行目の left から count 個のピクセルに coverage で重ねる
+    void BlendRow(int y, int left, int count, const uint8_t* coverage, uint32_t color);
+    void BuildCorner(int diameter);
+
+    // 作ったカバレッジのマスク。key は形の座標 (マスクの左上からの相対) と太さ
+    struct Mask {
+        int kind;
+        double key[6];
+        int width;
+        int height;
+        std::vector<uint8_t> coverage;
+    };
+    // 同じ形のマスクがあればそれを返す。なければ場所を空けて *isNew を true にする
+    Mask* FindMask(int kind, const double* key, int width, int height, bool* isNew);
+
+    std::vector<uint32_t> m_storage;
+    uint32_t* m_pixels;
+    int m_width;
+    int m_height;
+    int m_stride;
+    int m_clipLeft;
+    int m_clipTop;
+    int m_clipRight;
+    int m_clipBottom;
+    // FillRoundedTab の角のカバレッジ (m_cornerSize 四方)。直径が変わったときだけ作り直す
+    int m_cornerDiameter;
+    int m_cornerSize;
+    std::vector<uint8_t> m_cornerLeft;
+    std::vector<uint8_t> m_cornerRight;
+    std::vector<uint8_t> m_coverage; // 1 行分の作業領域
+    // × と三角形は DPI が同じならどのタブでも同じ形なので、マスクを使い回す
+    std::vector<Mask> m_masks;
+    int m_nextMask;
+};
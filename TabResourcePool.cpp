@@ -0,0 +1,121 @@
+﻿#include "TabResourcePool.h"
+#include <mutex>
+#include <vector>
+#include "TabLayoutEngine.h"
+
+namespace {
+
+struct PoolEntry {
+    TabThemeResources* resources;
+    int refCount;
+};
+
+// 関数内の static にして、初期化の順序とスレッドに依存しないようにする
+std::mutex& GetPoolMutex() {
+    static std::mutex s_mutex;
+    return s_mutex;
+}
+
+std::vector<PoolEntry>& GetPoolEntries() {
+    static std::vector<PoolEntry> s_entries;
+    return s_entries;
+}
+
+void GetThemeColors(bool isDarkMode, TabThemeColors* colors) {
+    if (isDarkMode) {
+        colors->bg = RGB(32, 32, 32);
+        colors->text = RGB(220, 220, 220);
+        colors->activeTab = RGB(50, 50, 50);
+        colors->separator = RGB(60, 60, 60);
+        colors->closeText = RGB(150, 150, 150);
+        colors->hoverBg = RGB(45, 45, 45);
+        colors->closeButtonHoverBg = RGB(96, 96, 96);
+        colors->scrollButtonHoverBg = RGB(60, 60, 60);
+        colors->tooltipBg = RGB(50, 50, 50);
+        colors->tooltipText = RGB(255, 255, 255);
+        colors->accent = RGB(76, 160, 255);
+    }
+    else {
+        colors->bg = RGB(220, 220, 220);
+        colors->text = RGB(32, 32, 32);
+        colors->activeTab = RGB(240, 240, 240);
+        colors->separator = RGB(200, 200, 200);
+        colors->closeText = RGB(100, 100, 100);
+        colors->hoverBg = RGB(230, 230, 230);
+        colors->closeButtonHoverBg = RGB(200, 200, 200);
+        colors->scrollButtonHoverBg = RGB(220, 220, 220);
+        colors->tooltipBg = RGB(250, 250, 250);
+        colors->tooltipText = RGB(32, 32, 32);
+        colors->accent = RGB(0, 103, 192);
+    }
+}
+
+TabThemeResources* CreateResources(int dpi, bool isDarkMode) {
+    TabThemeResources* resources = new TabThemeResources();
+    resources->dpi = dpi;
+    resources->isDarkMode = isDarkMode;
+    resources->hFont = CreateFontW(
+        -MulDiv(FONT_SIZE, dpi, 72), 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
+        DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+        CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_SWISS, L"Segoe UI"
+    );
+    GetThemeColors(isDarkMode, &resources->colors);
+
+    // 描画で使う色を先に作っておき、描画中はハンドルを借りるだけにする
+    const TabThemeColors& c = resources->colors;
+    const COLORREF brushColors[] = {
+        c.bg, c.text, c.activeTab, c.hoverBg,
+        c.closeButtonHoverBg, c.scrollButtonHoverBg, c.tooltipBg, RGB(96, 96, 96), c.accent
+    };
+    const COLORREF penColors[] = {
+        c.separator, c.text, c.closeText, RGB(255, 255, 255)
+    };
+    resources->gdiCache.Rebuild(brushColors, ARRAYSIZE(brushColors), penColors, ARRAYSIZE(penColors), dpi);
+    return resources;
+}
+
+}
+
+const TabThemeResources* TabResourcePool::Acquire(int dpi, bool isDarkMode) {
+    std::lock_guard<std::mutex> lock(GetPoolMutex());
+    std::vector<PoolEntry>& entries = GetPoolEntries();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].resources->dpi == dpi && entries[i].resources->isDarkMode == isDarkMode) {
+            entries[i].refCount++;
+            return entries[i].resources;
+        }
+    }
+    // GDI オブジェクトの作成もロックの中で行い、同じ組を 2 回作らない
+    PoolEntry entry = { CreateResources(dpi, isDarkMode), 1 };
+    entries.push_back(entry);
+    return entry.resources;
+}
+
+void TabResourcePool::Release(const TabThemeResources* resources) {
+    if (!resources) {
+        return;
+    }
+    TabThemeResources* released = NULL;
+    {
+        std::lock_guard<std::mutex> lock(GetPoolMutex());
+        std::vector<PoolEntry>& entries = GetPoolEntries();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].resources == resources) {
+                if (--entries[i].refCount == 0) {
+                    released = entries[i].resources;
+                    entries.erase(entries.begin() + i);
+                }
+                break;
+            }
+        }
+    }
+    if (released) {
+        DeleteObject(released->hFont);
+        delete released;
+    }
+}
+
+int TabResourcePool::GetEntryCount() {
+    std::lock_guard<std::mutex> lock(GetPoolMutex());
+    return (int)GetPoolEntries().size();
+}
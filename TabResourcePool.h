@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include "TabGdiCache.h"
+
+// テーマの配色
+struct TabThemeColors {
+    COLORREF bg;
+    COLORREF text;
+    COLORREF activeTab;
+    COLORREF separator;
+    COLORREF closeText;
+    COLORREF hoverBg;
+    COLORREF closeButtonHoverBg;
+    COLORREF scrollButtonHoverBg;
+    COLORREF tooltipBg;
+    COLORREF tooltipText;
+    COLORREF accent; // 進捗バーと未読数のバッジ
+};
+
+// (DPI, テーマ) ごとのフォントと配色のブラシ・ペン。
+// 作成後は変更しないので、どのスレッドのコントロールからも読むだけで共有できる
+struct TabThemeResources {
+    int dpi;
+    bool isDarkMode;
+    HFONT hFont;
+    TabThemeColors colors;
+    TabGdiCache gdiCache;
+};
+
+// プロセス全体で 1 つの共有リソースのプール。参照カウントが 0 になったら削除する。
+// Acquire / Release はどのスレッドから呼んでもよい
+class TabResourcePool {
+public:
+    static const TabThemeResources* Acquire(int dpi, bool isDarkMode);
+    static void Release(const TabThemeResources* resources);
+
+    // 現在プールにある (DPI, テーマ) の組の数
+    static int GetEntryCount();
+};
@@ -0,0 +1,209 @@
+﻿#include "TabSearchIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TAB_SEARCH_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// 部分一致の採点。あいまい一致より必ず高くなるようにする
+#define SCORE_SUBSTRING 100000
+#define SCORE_FUZZY 1000
+
+#ifdef TAB_SEARCH_SSE2
+static int CountTrailingZeros(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// text の中で needle が最初に現れる位置。なければ -1
+static int FindSubstring(const unsigned short* text, int textLength, const unsigned short* needle, int needleLength) {
+    if (needleLength == 0) {
+        return 0;
+    }
+    if (needleLength > textLength) {
+        return -1;
+    }
+    int last = textLength - needleLength;
+    int i = 0;
+#ifdef TAB_SEARCH_SSE2
+    // 先頭と末尾の文字が両方一致する位置を 8 文字ずつまとめて探し、候補だけ比較する
+    const __m128i first = _mm_set1_epi16((short)needle[0]);
+    const __m128i tail = _mm_set1_epi16((short)needle[needleLength - 1]);
+    for (; i + 8 <= last + 1; i += 8) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i blockTail = _mm_loadu_si128((const __m128i*)(text + i + needleLength - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi16(blockFirst, first), _mm_cmpeq_epi16(blockTail, tail));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+        while (mask != 0) {
+            int bit = CountTrailingZeros(mask);
+            int pos = i + bit / 2;
+            if (needleLength <= 2 || memcmp(text + pos + 1, needle + 1, (needleLength - 2) * sizeof(unsigned short)) == 0) {
+                return pos;
+            }
+            mask &= ~(3u << bit);
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        if (text[i] == needle[0] && memcmp(text + i, needle, needleLength * sizeof(unsigned short)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool IsWordStart(const unsigned short* text, int pos) {
+    if (pos == 0) {
+        return true;
+    }
+    unsigned short prev = text[pos - 1];
+    return prev == L' ' || prev == L'_' || prev == L'-' || prev == L'.' || prev == L'/' || prev == L'\\';
+}
+
+TabSearchIndex::TabSearchIndex()
+    : m_offsets(1, 0), m_hasLastQuery(false), m_scannedCount(0) {
+}
+
+void TabSearchIndex::Clear() {
+    m_text.clear();
+    m_offsets.assign(1, 0);
+    m_lastQuery.clear();
+    m_hasLastQuery = false;
+    m_candidates.clear();
+    m_results.clear();
+    m_scannedCount = 0;
+}
+
+void TabSearchIndex::Reserve(int count, size_t totalLength) {
+    m_offsets.reserve(count + 1);
+    m_text.reserve(totalLength);
+}
+
+void TabSearchIndex::AddTitle(const std::wstring& title) {
+    for (wchar_t c : title) {
+        m_text.push_back(FoldChar(c));
+    }
+    m_offsets.push_back((int)m_text.size());
+    m_hasLastQuery = false;
+}
+
+int TabSearchIndex::GetCount() const {
+    return (int)m_offsets.size() - 1;
+}
+
+const std::vector<int>& TabSearchIndex::Search(const std::wstring& query) {
+    std::vector<unsigned short> folded(query.size());
+    for (size_t i = 0; i < query.size(); ++i) {
+        folded[i] = FoldChar(query[i]);
+    }
+
+    int count = GetCount();
+    m_results.clear();
+    if (folded.empty()) {
+        m_results.resize(count);
+        for (int i = 0; i < count; ++i) {
+            m_results[i] = i;
+        }
+        m_candidates = m_results;
+        m_lastQuery.clear();
+        m_hasLastQuery = true;
+        m_scannedCount = 0;
+        return m_results;
+    }
+
+    // 前回のクエリを延長したものなら、一致する項目は前回の候補に含まれる
+    bool refine = m_hasLastQuery && m_lastQuery.size() <= folded.size() &&
+        std::equal(m_lastQuery.begin(), m_lastQuery.end(), folded.begin());
+
+    // スコアの降順・元の順番の昇順になるよう、(反転したスコア, 項目) を 64 ビットに詰めて並べる
+    std::vector<unsigned long long> scored;
+    std::vector<int> matched;
+    int queryLength = (int)folded.size();
+    m_scannedCount = refine ? (int)m_candidates.size() : count;
+    scored.reserve(m_scannedCount);
+    matched.reserve(m_scannedCount);
+    for (int n = 0; n < m_scannedCount; ++n) {
+        int item = refine ? m_candidates[n] : n;
+        int score = Score(item, folded.data(), queryLength);
+        if (score > 0) {
+            matched.push_back(item);
+            scored.push_back(((unsigned long long)(0x7FFFFFFF - score) << 32) | (unsigned int)item);
+        }
+    }
+    std::sort(scored.begin(), scored.end());
+
+    m_results.resize(scored.size());
+    for (size_t i = 0; i < scored.size(); ++i) {
+        m_results[i] = (int)(scored[i] & 0xFFFFFFFF);
+    }
+    m_candidates.swap(matched);
+    m_lastQuery.swap(folded);
+    m_hasLastQuery = true;
+    return m_results;
+}
+
+const std::vector<int>& TabSearchIndex::GetResults() const {
+    return m_results;
+}
+
+int TabSearchIndex::GetScannedCount() const {
+    return m_scannedCount;
+}
+
+unsigned short TabSearchIndex::FoldChar(wchar_t c) {
+    if (c < 0x80) {
+        return (unsigned short)(c >= L'A' && c <= L'Z' ? c + (L'a' - L'A') : c);
+    }
+    wchar_t lower = (wchar_t)towlower(c);
+    return lower > 0xFFFF ? 0xFFFF : (unsigned short)lower;
+}
+
+int TabSearchIndex::Score(int item, const unsigned short* query, int queryLength) const {
+    const unsigned short* text = m_text.data() + m_offsets[item];
+    int textLength = m_offsets[item + 1] - m_offsets[item];
+
+    int pos = FindSubstring(text, textLength, query, queryLength);
+    if (pos >= 0) {
+        // 前にあるほど、単語の先頭にあるほど高い
+        int score = SCORE_SUBSTRING - pos;
+        if (IsWordStart(text, pos)) {
+            score += SCORE_SUBSTRING / 2;
+        }
+        return score;
+    }
+
+    // あいまい一致: クエリの文字が順番どおりに現れれば一致とし、
+    // 連続しているほど、単語の先頭に当たるほど高くする
+    int score = SCORE_FUZZY;
+    int q = 0;
+    int prevMatch = -2;
+    for (int i = 0; i < textLength && q < queryLength; ++i) {
+        if (text[i] != query[q]) {
+            continue;
+        }
+        if (i == prevMatch + 1) {
+            score += 10;
+        }
+        else if (prevMatch >= 0) {
+            score -= std::min(i - prevMatch, 10);
+        }
+        if (IsWordStart(text, i)) {
+            score += 5;
+        }
+        prevMatch = i;
+        ++q;
+    }
+    return q == queryLength ? std::max(score, 1) : 0;
+}
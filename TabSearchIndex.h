@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+// オーバーフロー一覧の絞り込み検索。
+// タイトルを小文字化して 1 本の連続したバッファに詰め、大文字小文字を
+// 区別しない部分一致 (SSE2) と、一致しなければあいまい一致 (部分列) で採点する。
+// 前回のクエリを延長したクエリなら前回の候補だけを走査する。
+class TabSearchIndex {
+public:
+    TabSearchIndex();
+
+    void Clear();
+    void Reserve(int count, size_t totalLength);
+    // 追加した順番がそのまま結果のインデックスになる
+    void AddTitle(const std::wstring& title);
+    int GetCount() const;
+
+    // 一致した項目をスコアの高い順に返す。空のクエリなら全件を元の順番で返す
+    const std::vector<int>& Search(const std::wstring& query);
+    const std::vector<int>& GetResults() const;
+    // 直前の Search で走査した項目数
+    int GetScannedCount() const;
+
+private:
+    static unsigned short FoldChar(wchar_t c);
+    int Score(int item, const unsigned short* query, int queryLength) const;
+
+    std::vector<unsigned short> m_text; // 小文字化したタイトルを連結したもの
+    std::vector<int> m_offsets;         // 項目 i は [m_offsets[i], m_offsets[i + 1])
+    std::vector<unsigned short> m_lastQuery;
+    bool m_hasLastQuery;
+    std::vector<int> m_candidates;      // 前回のクエリに一致した項目 (元の順番)
+    std::vector<int> m_results;
+    int m_scannedCount;
+};
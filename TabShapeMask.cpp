@@ -0,0 +1,41 @@
+﻿#include "TabShapeMask.h"
+#include <cmath>
+
+TabShapeMask::TabShapeMask()
+    : m_diameter(-1) {
+}
+
+void TabShapeMask::Build(int diameter) {
+    if (diameter == m_diameter) {
+        return;
+    }
+    m_diameter = diameter;
+    m_insets.clear();
+    if (diameter <= 1) {
+        return;
+    }
+
+    // 画素の中心の高さで円と交わる位置を求め、四捨五入する
+    double r = diameter / 2.0;
+    for (int y = 0; y < diameter / 2; ++y) {
+        double dy = r - (y + 0.5);
+        double dx = std::sqrt(r * r - dy * dy);
+        int inset = (int)std::floor(r - dx + 0.5);
+        if (inset <= 0) {
+            break;
+        }
+        m_insets.push_back(inset);
+    }
+}
+
+int TabShapeMask::GetDiameter() const {
+    return m_diameter;
+}
+
+int TabShapeMask::GetRowCount() const {
+    return (int)m_insets.size();
+}
+
+int TabShapeMask::GetInset(int row) const {
+    return m_insets[row];
+}
@@ -0,0 +1,23 @@
+﻿#pragma once
+
+#include <vector>
+
+// 角の丸いタブの形状。上端の角の部分だけ、行ごとに左右をどれだけ
+// 削るかを持つ。形状はタブの高さや幅によらず角の直径だけで決まるので、
+// DPI が変わったときに作り直せば描画は行ごとの塗りつぶしで済む。
+class TabShapeMask {
+public:
+    TabShapeMask();
+
+    // diameter は CreateRoundRectRgn に渡す楕円の直径と同じ意味
+    void Build(int diameter);
+
+    int GetDiameter() const;
+    // 左右を削る必要がある行数 (これより下はタブの幅いっぱい)
+    int GetRowCount() const;
+    int GetInset(int row) const;
+
+private:
+    int m_diameter;
+    std::vector<int> m_insets;
+};
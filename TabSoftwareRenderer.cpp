@@ -0,0 +1,282 @@
+﻿#include "TabSoftwareRenderer.h"
+#include "TabAnimator.h"
+#include "TabAdornments.h"
+#include <algorithm>
+
+// value * numerator / denominator を四捨五入したもの (MulDiv と同じ)
+static int MulDivRound(int value, int numerator, int denominator) {
+    long long product = (long long)value * numerator;
+    long long half = denominator / 2;
+    return (int)((product >= 0 ? product + half : product - half) / denominator);
+}
+
+// from と to の間を step / steps の割合で混ぜる (どちらも不透明の色)
+static uint32_t BlendColor(uint32_t from, uint32_t to, int step, int steps) {
+    uint32_t result = 0xff000000;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int f = (int)((from >> shift) & 0xff);
+        int t = (int)((to >> shift) & 0xff);
+        result |= (uint32_t)(f + (t - f) * step / steps) << shift;
+    }
+    return result;
+}
+
+TabSoftwareRenderer::TabSoftwareRenderer()
+    : m_palette(), m_glyphs(nullptr), m_ellipsisMode(TAB_ELLIPSIS_END), m_lastTabCount(0) {
+}
+
+void TabSoftwareRenderer::SetPalette(const TabRenderPalette& palette) {
+    m_palette = palette;
+}
+
+void TabSoftwareRenderer::SetGlyphSource(ITabGlyphSource* glyphs) {
+    m_glyphs = glyphs;
+}
+
+void TabSoftwareRenderer::SetEllipsisMode(TabEllipsisMode mode) {
+    m_ellipsisMode = mode;
+}
+
+int TabSoftwareRenderer::GetLastTabCount() const {
+    return m_lastTabCount;
+}
+
+const std::vector<TabTitleFallback>& TabSoftwareRenderer::GetFallbackTitles() const {
+    return m_fallbackTitles;
+}
+
+void TabSoftwareRenderer::Render(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state) {
+    m_lastTabCount = 0;
+    m_fallbackTitles.clear();
+    if (raster.IsClipEmpty()) {
+        return;
+    }
+    int clipLeft, clipTop, clipRight, clipBottom;
+    raster.GetClip(&clipLeft, &clipTop, &clipRight, &clipBottom);
+    raster.FillRect(clipLeft, clipTop, clipRight, clipBottom, m_palette.bg);
+
+    // タブはスクロールボタンの下に描かない
+    raster.IntersectClip(0, 0, layout.GetViewWidth(), raster.GetHeight());
+    if (!raster.IsClipEmpty()) {
+        int left, top, right, bottom;
+        raster.GetClip(&left, &top, &right, &bottom);
+        if (layout.IsMultiRow()) {
+            int tabHeight = layout.GetTabHeight();
+            int lastRow = std::min((bottom - 1) / tabHeight, layout.GetRowCount() - 1);
+            for (int row = top / tabHeight; row <= lastRow; ++row) {
+                int first = 0;
+                int last = -1;
+                layout.GetRowRange(row, &first, &last);
+                for (int i = first; i <= last; ++i) {
+                    TabRect rect = layout.GetTabRect(i);
+                    if (rect.left >= right) {
+                        break;
+                    }
+                    if (rect.right > left) {
+                        DrawTab(raster, layout, state, i, rect);
+                    }
+                }
+            }
+        }
+        else {
+            int first = 0;
+            int last = -1;
+            layout.GetTabsInRange(left, right, &first, &last);
+            for (int i = first; i <= last; ++i) {
+                DrawTab(raster, layout, state, i, layout.GetTabRect(i));
+            }
+        }
+    }
+    raster.SetClip(clipLeft, clipTop, clipRight, clipBottom);
+
+    if (layout.HasScrollButtons() && clipRight > layout.GetViewWidth()) {
+        DrawScrollButtons(raster, layout, state);
+    }
+}
+
+void TabSoftwareRenderer::DrawTab(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state, int index, const TabRect& rect) {
+    m_lastTabCount++;
+    bool isActive = (index == state.selectedTab);
+    float hoverLevel = state.animator ? state.animator->GetHoverLevel(index) : 0.0f;
+    uint32_t bgColor = isActive ? m_palette.activeTab : m_palette.bg;
+    if (hoverLevel > 0.0f && !isActive) {
+        // ブラシを作らないので、フェードの段階は絞らない
+        bgColor = BlendColor(m_palette.bg, m_palette.hoverBg, (int)(hoverLevel * 255.0f + 0.5f), 255);
+    }
+
+    int radius = layout.Scale(TAB_ROUND_RADIUS);
+    raster.FillRoundedTab(rect.left, rect.top, rect.right, rect.bottom + (isActive ? 1 : 0), radius, bgColor);
+
+    const TabAdornment* adornment = state.adornments ? state.adornments->Find(layout.GetTabKey(index)) : nullptr;
+    if (adornment && adornment->progress >= 0) {
+        int barHeight = layout.Scale(ADORNMENT_BAR_HEIGHT);
+        int barLeft = rect.left + radius;
+        int barRight = barLeft + (rect.right - radius - barLeft) * std::min(adornment->progress, 100) / 100;
+        raster.FillRect(barLeft, rect.bottom - barHeight, barRight, rect.bottom, m_palette.accent);
+    }
+
+    if (!isActive) {
+        raster.FillRect(rect.left + radius, rect.top, rect.right - radius, rect.top + 1, m_palette.separator);
+        raster.FillRect(rect.right - 1, rect.top + radius, rect.right, rect.bottom, m_palette.separator);
+        raster.FillRect(rect.left, rect.top + radius, rect.left + 1, rect.bottom, m_palette.separator);
+    }
+
+    TabRect rcText = layout.GetTextRect(rect);
+    if (!DrawTitle(raster, layout.GetTitle(index), rcText, m_palette.text)) {
+        TabTitleFallback fallback = { index, rcText };
+        m_fallbackTitles.push_back(fallback);
+    }
+
+    TabRect rcClose = layout.GetCloseButtonRect(rect);
+    bool isCloseHovered = (index == state.hoveredCloseButtonTab);
+    bool isPressed = (index == state.pressedCloseButtonTab);
+    // ホバーしていないタブは閉じるボタンの代わりに状態を出す
+    bool hasStatus = adornment && (adornment->isBusy || adornment->unreadCount > 0 || adornment->isModified);
+    if (hasStatus && hoverLevel <= 0.0f && !isCloseHovered && !isPressed) {
+        DrawTabStatus(raster, layout, state, *adornment, rcClose, bgColor);
+        return;
+    }
+    if (isCloseHovered || isPressed) {
+        raster.FillRect(rcClose.left, rcClose.top, rcClose.right, rcClose.bottom, m_palette.closeButtonHoverBg);
+    }
+
+    // GDI の LineTo は終点を塗らないので、線はピクセルの中心を結ぶ
+    int crossPadding = layout.Scale(8);
+    raster.FillCross(rcClose.left + crossPadding + 0.5, rcClose.top + crossPadding + 0.5,
+        rcClose.right - crossPadding - 0.5, rcClose.bottom - crossPadding - 0.5,
+        std::max(1, layout.Scale(1)), (isCloseHovered || isPressed) ? m_palette.text : m_palette.closeText);
+}
+
+void TabSoftwareRenderer::DrawTabStatus(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state,
+    const TabAdornment& adornment, const TabRect& rect, uint32_t bgColor) {
+    int cx = (rect.left + rect.right) / 2;
+    int cy = (rect.top + rect.bottom) / 2;
+    if (adornment.isBusy) {
+        static const int s_directions[TAB_SPINNER_DOTS][2] = {
+            { 0, -1000 }, { 707, -707 }, { 1000, 0 }, { 707, 707 },
+            { 0, 1000 }, { -707, 707 }, { -1000, 0 }, { -707, -707 }
+        };
+        int radius = layout.Scale(ADORNMENT_SPINNER_RADIUS);
+        int dot = std::max(1, layout.Scale(ADORNMENT_SPINNER_DOT));
+        for (int i = 0; i < TAB_SPINNER_DOTS; ++i) {
+            int x = cx + MulDivRound(radius, s_directions[i][0], 1000);
+            int y = cy + MulDivRound(radius, s_directions[i][1], 1000);
+            int age = (state.spinnerHead - i + TAB_SPINNER_DOTS) % TAB_SPINNER_DOTS;
+            raster.FillRect(x - dot, y - dot, x + dot, y + dot, BlendColor(m_palette.text, bgColor, age, TAB_SPINNER_DOTS));
+        }
+        return;
+    }
+
+    if (adornment.unreadCount > 0) {
+        std::wstring text = adornment.unreadCount > 99 ? L"99+" : std::to_wstring(adornment.unreadCount);
+        int height = layout.Scale(ADORNMENT_BADGE_HEIGHT);
+        int textWidth = MeasureString(text);
+        int width = std::min(std::max(height, textWidth + height / 2), rect.right - rect.left);
+        TabRect rcBadge = { cx - width / 2, cy - height / 2, cx - width / 2 + width, cy - height / 2 + height };
+        raster.FillRoundRect(rcBadge.left, rcBadge.top, rcBadge.right, rcBadge.bottom, height / 2.0, m_palette.accent);
+        if (m_glyphs) {
+            int left, top, right, bottom;
+            raster.GetClip(&left, &top, &right, &bottom);
+            raster.IntersectClip(rcBadge.left, rcBadge.top, rcBadge.right, rcBadge.bottom);
+            int baseline = rcBadge.top + (height - m_glyphs->GetLineHeight()) / 2 + m_glyphs->GetAscent();
+            DrawString(raster, text, rcBadge.left + (width - textWidth) / 2, baseline, TabRasterColor(255, 255, 255));
+            raster.SetClip(left, top, right, bottom);
+        }
+    }
+    else if (adornment.isModified) {
+        int radius = layout.Scale(ADORNMENT_DOT_RADIUS);
+        raster.FillRoundRect(cx - radius, cy - radius, cx + radius + 1, cy + radius + 1, radius + 0.5, m_palette.text);
+    }
+}
+
+// 96 DPI でのボタン内の座標 (x0, y0, x1, y1, x2, y2) の三角形
+static void FillButtonTriangle(TabRaster& raster, const TabLayoutEngine& layout, const TabRect& rect, const int* points, uint32_t color) {
+    double x[3];
+    double y[3];
+    for (int i = 0; i < 3; ++i) {
+        x[i] = rect.left + layout.Scale(points[i * 2]) + 0.5;
+        y[i] = rect.top + layout.Scale(points[i * 2 + 1]) + 0.5;
+    }
+    raster.FillTriangle(x[0], y[0], x[1], y[1], x[2], y[2], color);
+}
+
+void TabSoftwareRenderer::DrawScrollButtons(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state) {
+    static const int s_triangleLeft[] = { 10, 15, 15, 10, 15, 20 };
+    static const int s_triangleRight[] = { 15, 20, 20, 15, 15, 10 };
+    static const int s_triangleDown[] = { 10, 13, 20, 13, 15, 18 };
+
+    TabRect rcLeft = layout.GetScrollLeftRect();
+    raster.FillRect(rcLeft.left, rcLeft.top, rcLeft.right, rcLeft.bottom,
+        state.isScrollLeftHovered ? m_palette.scrollButtonHoverBg : m_palette.bg);
+    FillButtonTriangle(raster, layout, rcLeft, s_triangleLeft, m_palette.text);
+
+    TabRect rcRight = layout.GetScrollRightRect();
+    raster.FillRect(rcRight.left, rcRight.top, rcRight.right, rcRight.bottom,
+        state.isScrollRightHovered ? m_palette.scrollButtonHoverBg : m_palette.bg);
+    FillButtonTriangle(raster, layout, rcRight, s_triangleRight, m_palette.text);
+
+    TabRect rcOverflow = layout.GetOverflowButtonRect();
+    raster.FillRect(rcOverflow.left, rcOverflow.top, rcOverflow.right, rcOverflow.bottom,
+        state.isOverflowHovered ? m_palette.scrollButtonHoverBg : m_palette.bg);
+    FillButtonTriangle(raster, layout, rcOverflow, s_triangleDown, m_palette.text);
+}
+
+bool TabSoftwareRenderer::DrawTitle(TabRaster& raster, const std::wstring& title, const TabRect& rect, uint32_t color) {
+    if (!m_glyphs || rect.left >= rect.right) {
+        return true;
+    }
+    // 状態表示だけを描き直すときはタイトルに触れない
+    int left, top, right, bottom;
+    raster.GetClip(&left, &top, &right, &bottom);
+    if (rect.right <= left || rect.left >= right || rect.bottom <= top || rect.top >= bottom) {
+        return true;
+    }
+
+    m_prefix.resize(title.length() + 1);
+    m_prefix[0] = 0;
+    for (size_t i = 0; i < title.length(); ++i) {
+        const TabGlyph* glyph = m_glyphs->GetGlyph(title[i]);
+        if (!glyph) {
+            return false;
+        }
+        m_prefix[i + 1] = m_prefix[i] + glyph->advance;
+    }
+    const std::wstring* text = &title;
+    int maxWidth = rect.right - rect.left;
+    if (m_prefix.back() > maxWidth) {
+        FitTitleToWidth(title, m_prefix.data(), GetAdvance(TAB_ELLIPSIS_CHAR), maxWidth, m_ellipsisMode, m_fitted);
+        text = &m_fitted;
+    }
+
+    raster.IntersectClip(rect.left, rect.top, rect.right, rect.bottom);
+    int baseline = rect.top + (rect.bottom - rect.top - m_glyphs->GetLineHeight()) / 2 + m_glyphs->GetAscent();
+    DrawString(raster, *text, rect.left, baseline, color);
+    raster.SetClip(left, top, right, bottom);
+    return true;
+}
+
+void TabSoftwareRenderer::DrawString(TabRaster& raster, const std::wstring& text, int x, int y, uint32_t color) {
+    for (wchar_t c : text) {
+        const TabGlyph* glyph = m_glyphs->GetGlyph(c);
+        if (!glyph) {
+            continue;
+        }
+        if (glyph->width > 0 && glyph->height > 0) {
+            raster.BlitMask(x + glyph->left, y - glyph->top, glyph->coverage.data(), glyph->width, glyph->height, glyph->width, color);
+        }
+        x += glyph->advance;
+    }
+}
+
+int TabSoftwareRenderer::GetAdvance(wchar_t c) {
+    const TabGlyph* glyph = m_glyphs ? m_glyphs->GetGlyph(c) : nullptr;
+    return glyph ? glyph->advance : 0;
+}
+
+int TabSoftwareRenderer::MeasureString(const std::wstring& text) {
+    int width = 0;
+    for (wchar_t c : text) {
+        width += GetAdvance(c);
+    }
+    return width;
+}
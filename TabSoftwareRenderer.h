@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TabRaster.h"
+#include "TabLayoutEngine.h"
+#include "TabEllipsis.h"
+
+class TabAnimator;
+class TabAdornments;
+struct TabAdornment;
+
+// 8 ビットのカバレッジで表したグリフ。ペンの位置はベースライン上
+struct TabGlyph {
+    int advance; // 次の文字までの送り幅
+    int left;    // ペンの位置から左端まで
+    int top;     // ベースラインから上端まで (上が正)
+    int width;
+    int height;
+    std::vector<uint8_t> coverage; // width * height
+};
+
+// ソフトウェア描画にグリフを渡すインターフェース。
+// Win32 では GDI のアウトライン、ベンチマークでは作ったグリフを差し込む
+class ITabGlyphSource {
+public:
+    virtual ~ITabGlyphSource() {}
+    // 描けない文字は nullptr。その文字を含むタイトルは描かずに GetFallbackTitles で返す。
+    // 返したグリフはフォントが変わるまで有効
+    virtual const TabGlyph* GetGlyph(wchar_t c) = 0;
+    virtual int GetAscent() = 0;
+    virtual int GetLineHeight() = 0;
+};
+
+// 乗算済みアルファの色 (TabRasterColor)
+struct TabRenderPalette {
+    uint32_t bg;
+    uint32_t text;
+    uint32_t activeTab;
+    uint32_t hoverBg;
+    uint32_t separator;
+    uint32_t closeText;
+    uint32_t closeButtonHoverBg;
+    uint32_t scrollButtonHoverBg;
+    uint32_t accent;
+};
+
+// グリフにできない文字を含むので、Render が描かなかったタイトル
+struct TabTitleFallback {
+    int index;
+    TabRect rect; // タイトルを描く範囲 (GetTextRect)
+};
+
+// 1 フレーム分の表示状態
+struct TabRenderState {
+    int selectedTab;
+    int hoveredCloseButtonTab;
+    int pressedCloseButtonTab;
+    bool isScrollLeftHovered;
+    bool isScrollRightHovered;
+    bool isOverflowHovered;
+    const TabAnimator* animator;     // ホバーのフェード。nullptr ならフェードしない
+    const TabAdornments* adornments; // nullptr なら状態表示を出さない
+    int spinnerHead;                 // TabAdornments::GetSpinnerHead の値
+};
+
+// タブ列を TabRaster に描く。Windows API に依存しないので、Linux でもベンチマークや
+// 画素単位の比較にそのまま使える。形と寸法は CustomTabControl の GDI の描画に合わせてある
+// (ドラッグ中の表示は GDI だけ)
+class TabSoftwareRenderer {
+public:
+    TabSoftwareRenderer();
+
+    void SetPalette(const TabRenderPalette& palette);
+    void SetGlyphSource(ITabGlyphSource* glyphs);
+    void SetEllipsisMode(TabEllipsisMode mode);
+
+    // raster のクリップの中だけを描き直す。座標はコントロールのクライアント座標
+    void Render(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state);
+    // 直前の Render で描いたタブの数
+    int GetLastTabCount() const;
+    // 直前の Render で描けなかったタイトル。呼び出し側が別の方法 (GDI) で重ねて描く
+    const std::vector<TabTitleFallback>& GetFallbackTitles() const;
+
+private:
+    void DrawTab(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state, int index, const TabRect& rect);
+    void DrawTabStatus(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state,
+        const TabAdornment& adornment, const TabRect& rect, uint32_t bgColor);
+    void DrawScrollButtons(TabRaster& raster, const TabLayoutEngine& layout, const TabRenderState& state);
+    // rect に収まるよう省略記号を入れて、上下の中央に描く。描けない文字があれば何もせず false
+    bool DrawTitle(TabRaster& raster, const std::wstring& title, const TabRect& rect, uint32_t color);
+    // y はベースライン
+    void DrawString(TabRaster& raster, const std::wstring& text, int x, int y, uint32_t color);
+    int GetAdvance(wchar_t c);
+    int MeasureString(const std::wstring& text);
+
+    TabRenderPalette m_palette;
+    ITabGlyphSource* m_glyphs;
+    TabEllipsisMode m_ellipsisMode;
+    std::vector<int> m_prefix; // DrawTitle の作業領域
+    std::wstring m_fitted;
+    int m_lastTabCount;
+    std::vector<TabTitleFallback> m_fallbackTitles;
+};
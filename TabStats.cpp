@@ -0,0 +1,94 @@
+﻿#include "TabStats.h"
+#include <chrono>
+#include <cstring>
+
+TabStats::TabStats()
+    : m_traceEnabled(false), m_eventHead(0), m_eventCount(0) {
+    Reset();
+}
+
+unsigned long long TabStats::Now() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TabStats::Reset() {
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_eventHead = 0;
+    m_eventCount = 0;
+}
+
+void TabStats::Record(TabStatCounter counter, unsigned long long startNs, unsigned long long endNs) {
+    unsigned long long duration = endNs - startNs;
+    TabHandlerStats& handler = m_stats.handlers[counter];
+    handler.calls++;
+    handler.totalNs += duration;
+    if (duration > handler.maxNs) {
+        handler.maxNs = duration;
+    }
+
+    if (m_traceEnabled) {
+        TabStatEvent& ev = m_events[m_eventHead];
+        ev.timestampNs = startNs;
+        ev.durationNs = duration;
+        ev.counter = counter;
+        m_eventHead = (m_eventHead + 1) % m_events.size();
+        if (m_eventCount < m_events.size()) {
+            m_eventCount++;
+        }
+    }
+}
+
+void TabStats::EndFrame(unsigned long long frameNs, unsigned int gdiObjectsCreated) {
+    m_stats.frames++;
+    if (frameNs > m_stats.worstFrameNs) {
+        m_stats.worstFrameNs = frameNs;
+    }
+    static const unsigned long long s_bucketLimitsMs[TAB_FRAME_HISTOGRAM_BUCKETS - 1] = { 1, 2, 4, 8, 16, 33, 66 };
+    int bucket = 0;
+    while (bucket < TAB_FRAME_HISTOGRAM_BUCKETS - 1 && frameNs >= s_bucketLimitsMs[bucket] * 1000000ULL) {
+        bucket++;
+    }
+    m_stats.frameHistogram[bucket]++;
+
+    m_stats.gdiObjectsCreated += gdiObjectsCreated;
+    m_stats.gdiObjectsCreatedLastFrame = gdiObjectsCreated;
+    if (gdiObjectsCreated > m_stats.maxGdiObjectsPerFrame) {
+        m_stats.maxGdiObjectsPerFrame = gdiObjectsCreated;
+    }
+}
+
+const TabControlStats& TabStats::Get() const {
+    return m_stats;
+}
+
+void TabStats::SetTraceEnabled(bool enabled) {
+    m_traceEnabled = enabled;
+    if (m_traceEnabled && m_events.empty()) {
+        m_events.resize(TAB_STATS_TRACE_CAPACITY);
+    }
+}
+
+bool TabStats::IsTraceEnabled() const {
+    return m_traceEnabled;
+}
+
+bool TabStats::DumpTrace(FILE* fp) const {
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "timestamp_ns,event,duration_ns\n");
+    size_t first = (m_eventHead + m_events.size() - m_eventCount) % (m_events.empty() ? 1 : m_events.size());
+    for (size_t i = 0; i < m_eventCount; ++i) {
+        const TabStatEvent& ev = m_events[(first + i) % m_events.size()];
+        fprintf(fp, "%llu,%s,%llu\n", ev.timestampNs, GetCounterName((TabStatCounter)ev.counter), ev.durationNs);
+    }
+    return ferror(fp) == 0;
+}
+
+const char* TabStats::GetCounterName(TabStatCounter counter) {
+    static const char* const s_names[TAB_STAT_COUNT] = {
+        "OnPaint", "DrawTab", "HitTest", "GetTabWidth", "OnMouseMove", "MeasureText"
+    };
+    return counter >= 0 && counter < TAB_STAT_COUNT ? s_names[counter] : "?";
+}
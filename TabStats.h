@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// 計測する処理
+enum TabStatCounter {
+    TAB_STAT_PAINT,
+    TAB_STAT_DRAW_TAB,
+    TAB_STAT_HIT_TEST,
+    TAB_STAT_GET_TAB_WIDTH,
+    TAB_STAT_MOUSE_MOVE,
+    TAB_STAT_MEASURE_TEXT,
+    TAB_STAT_COUNT
+};
+
+// フレーム時間のヒストグラムの区切り (ミリ秒)。最後の区間はそれ以上すべて
+#define TAB_FRAME_HISTOGRAM_BUCKETS 8
+#define TAB_STATS_TRACE_CAPACITY 4096
+
+struct TabHandlerStats {
+    unsigned long long calls;
+    unsigned long long totalNs;
+    unsigned long long maxNs;
+};
+
+struct TabControlStats {
+    TabHandlerStats handlers[TAB_STAT_COUNT];
+    unsigned long long frames;
+    unsigned long long worstFrameNs;
+    // [0] < 1ms, [1] < 2ms, [2] < 4ms, [3] < 8ms, [4] < 16ms, [5] < 33ms, [6] < 66ms, [7] それ以上
+    unsigned long long frameHistogram[TAB_FRAME_HISTOGRAM_BUCKETS];
+    unsigned long long gdiObjectsCreated;
+    unsigned int gdiObjectsCreatedLastFrame;
+    unsigned int maxGdiObjectsPerFrame;
+};
+
+struct TabStatEvent {
+    unsigned long long timestampNs;
+    unsigned long long durationNs;
+    int counter;
+};
+
+// 計測値の集計と、直近のイベントを残すリングバッファ。
+// TAB_STATS_DISABLED を定義するとコントロールからは使われなくなる。
+class TabStats {
+public:
+    TabStats();
+
+    static unsigned long long Now();
+
+    void Reset();
+    void Record(TabStatCounter counter, unsigned long long startNs, unsigned long long endNs);
+    void EndFrame(unsigned long long frameNs, unsigned int gdiObjectsCreated);
+    const TabControlStats& Get() const;
+
+    // リングバッファへの記録。既定ではオフ
+    void SetTraceEnabled(bool enabled);
+    bool IsTraceEnabled() const;
+    // 古い順に CSV (timestamp_ns,event,duration_ns) で書き出す
+    bool DumpTrace(FILE* fp) const;
+
+    static const char* GetCounterName(TabStatCounter counter);
+
+private:
+    TabControlStats m_stats;
+    bool m_traceEnabled;
+    std::vector<TabStatEvent> m_events;
+    size_t m_eventHead;
+    size_t m_eventCount;
+};
+
+// スコープの間の時間を計測する
+class TabStatScope {
+public:
+    TabStatScope(TabStats& stats, TabStatCounter counter)
+        : m_stats(stats), m_counter(counter), m_start(TabStats::Now()) {
+    }
+    ~TabStatScope() {
+        m_stats.Record(m_counter, m_start, TabStats::Now());
+    }
+
+private:
+    TabStatScope(const TabStatScope&);
+    TabStatScope& operator=(const TabStatScope&);
+
+    TabStats& m_stats;
+    TabStatCounter m_counter;
+    unsigned long long m_start;
+};
+
+#ifndef TAB_STATS_DISABLED
+#define TAB_STAT_CONCAT_(a, b) a##b
+#define TAB_STAT_CONCAT(a, b) TAB_STAT_CONCAT_(a, b)
+#define TAB_STAT_SCOPE(stats, counter) TabStatScope TAB_STAT_CONCAT(tabStatScope, __LINE__)(stats, counter)
+#else
+#define TAB_STAT_SCOPE(stats, counter) ((void)0)
+#endif
@@ -0,0 +1,145 @@
+﻿#include "TabTextCache.h"
+
+// 閉じたタブのエントリは残るので、この数を超えたら捨てて作り直す
+#define TEXT_CACHE_MAX_ENTRIES 1024
+
+TabTextCache::TabTextCache()
+    : m_generation(1), m_metricsGeneration(0), m_textHeight(0), m_ellipsisWidth(0),
+    m_ellipsisMode(TAB_ELLIPSIS_END), m_hits(0), m_misses(0) {
+}
+
+void TabTextCache::Invalidate() {
+    // 文字列やバッファの領域は再利用したいので、エントリは消さずに世代だけ進める
+    m_generation++;
+}
+
+void TabTextCache::Clear() {
+    m_entries.clear();
+    m_generation++;
+}
+
+void TabTextCache::SetEllipsisMode(TabEllipsisMode mode) {
+    if (mode == m_ellipsisMode) {
+        return;
+    }
+    m_ellipsisMode = mode;
+    // 累積送り幅はそのまま使えるので、幅を捨てて切り直させる
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        it->second.width = -1;
+    }
+}
+
+TabEllipsisMode TabTextCache::GetEllipsisMode() const {
+    return m_ellipsisMode;
+}
+
+void TabTextCache::Draw(HDC hdc, unsigned long long key, const std::wstring& title, const RECT& rect) {
+    int width = rect.right - rect.left;
+    if (width <= 0 || title.empty()) {
+        return;
+    }
+    if (m_entries.size() >= TEXT_CACHE_MAX_ENTRIES && m_entries.find(key) == m_entries.end()) {
+        m_entries.clear();
+    }
+    if (m_metricsGeneration != m_generation) {
+        UpdateFontMetrics(hdc);
+    }
+    Entry& entry = m_entries[key];
+    if (entry.generation != m_generation || entry.title != title) {
+        m_misses++;
+        Measure(hdc, entry, title);
+        Shape(hdc, entry, width);
+    }
+    else if (entry.width != width) {
+        m_misses++;
+        Shape(hdc, entry, width);
+    }
+    else {
+        m_hits++;
+    }
+
+    int y = rect.top + (rect.bottom - rect.top - m_textHeight) / 2;
+    if (entry.isGlyphRun) {
+        ExtTextOutW(hdc, rect.left, y, ETO_CLIPPED | ETO_GLYPH_INDEX, &rect,
+            entry.glyphs.data(), (UINT)entry.glyphs.size(), entry.advances.data());
+    }
+    else {
+        ExtTextOutW(hdc, rect.left, y, ETO_CLIPPED, &rect, entry.text.c_str(), (UINT)entry.text.length(), NULL);
+    }
+}
+
+unsigned long long TabTextCache::GetHitCount() const {
+    return m_hits;
+}
+
+unsigned long long TabTextCache::GetMissCount() const {
+    return m_misses;
+}
+
+void TabTextCache::UpdateFontMetrics(HDC hdc) {
+    TEXTMETRICW tm;
+    GetTextMetricsW(hdc, &tm);
+    m_textHeight = tm.tmHeight;
+    static const WCHAR s_szEllipsis[] = { TAB_ELLIPSIS_CHAR, 0 };
+    SIZE size;
+    GetTextExtentPoint32W(hdc, s_szEllipsis, 1, &size);
+    m_ellipsisWidth = size.cx;
+    m_metricsGeneration = m_generation;
+}
+
+void TabTextCache::Measure(HDC hdc, Entry& entry, const std::wstring& title) {
+    entry.title = title;
+    entry.generation = m_generation;
+    // lpnFit を渡さなければ全文字の累積幅が返る
+    int length = (int)title.length();
+    entry.prefix.resize(length + 1);
+    entry.prefix[0] = 0;
+    SIZE size;
+    GetTextExtentExPointW(hdc, title.c_str(), length, 0, NULL, entry.prefix.data() + 1, &size);
+}
+
+void TabTextCache::Shape(HDC hdc, Entry& entry, int width) {
+    entry.width = width;
+    FitTitleToWidth(entry.title, entry.prefix.data(), m_ellipsisWidth, width, m_ellipsisMode, entry.text);
+
+    // グリフ番号と送り幅を取っておく。グリフ番号で描けないものや失敗したときは文字列のまま描く
+    int textLength = (int)entry.text.length();
+    if (textLength == 0 || !CanDrawAsGlyphRun(hdc, entry.text)) {
+        entry.isGlyphRun = false;
+        return;
+    }
+    entry.glyphs.resize(textLength);
+    entry.advances.resize(textLength);
+    GCP_RESULTSW gcp = {};
+    gcp.lStructSize = sizeof(gcp);
+    gcp.lpDx = entry.advances.data();
+    gcp.lpGlyphs = entry.glyphs.data();
+    gcp.nGlyphs = (UINT)textLength;
+    DWORD flags = GetFontLanguageInfo(hdc) & FLI_MASK;
+    entry.isGlyphRun = GetCharacterPlacementW(hdc, entry.text.c_str(), textLength, 0, &gcp, flags) != 0;
+    if (entry.isGlyphRun) {
+        entry.glyphs.resize(gcp.nGlyphs);
+        entry.advances.resize(gcp.nGlyphs);
+    }
+}
+
+bool TabTextCache::CanDrawAsGlyphRun(HDC hdc, const std::wstring& text) {
+    for (size_t i = 0; i < text.length(); ++i) {
+        wchar_t c = text[i];
+        if ((c >= 0xD800 && c <= 0xDFFF) || IsComplexScriptChar(c)) {
+            return false;
+        }
+    }
+    // フォントにない文字は 0xFFFF になる。GDI の文字列描画ならフォントリンクで別のフォントから出せる
+    int length = (int)text.length();
+    m_glyphIndices.resize(length);
+    if (GetGlyphIndicesW(hdc, text.c_str(), length, m_glyphIndices.data(), GGI_MARK_NONEXISTING_GLYPHS) == GDI_ERROR) {
+        return false;
+    }
+    for (int i = 0; i < length; ++i) {
+        if (m_glyphIndices[i] == 0xFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "TabEllipsis.h"
+
+// 省略記号まで付けて整形済みのタイトルをタブごとに持つキャッシュ。
+// タイトル・幅・フォントが変わらない限り、描画はグリフ番号を ExtTextOutW に渡すだけになる。
+// グリフ番号で描くとフォントリンクも複雑な文字の整形も効かないので、選んだフォントにない文字
+// (日本語など) や整形の要る文字を含むタイトルは、省略後の文字列をそのまま ExtTextOutW で描く。
+class TabTextCache {
+public:
+    TabTextCache();
+
+    // フォントや DPI が変わったら呼ぶ。エントリは次の描画で整形し直す
+    void Invalidate();
+    void Clear();
+    void SetEllipsisMode(TabEllipsisMode mode);
+    TabEllipsisMode GetEllipsisMode() const;
+
+    // hdc には描画するフォントを選択しておくこと。
+    // key は通常モードならタブの ID、仮想モードならインデックスから作る
+    void Draw(HDC hdc, unsigned long long key, const std::wstring& title, const RECT& rect);
+
+    unsigned long long GetHitCount() const;
+    unsigned long long GetMissCount() const;
+
+private:
+    struct Entry {
+        std::wstring title;
+        int width;
+        unsigned int generation;
+        std::vector<int> prefix; // title の累積送り幅。幅が変わっても計り直さない
+        bool isGlyphRun;         // false なら text を文字列として描く
+        std::wstring text;       // 省略後の表示文字列
+        std::vector<WCHAR> glyphs;
+        std::vector<int> advances;
+    };
+
+    void UpdateFontMetrics(HDC hdc);
+    void Measure(HDC hdc, Entry& entry, const std::wstring& title);
+    void Shape(HDC hdc, Entry& entry, int width);
+    // 選んだフォントのグリフだけで、整形なしに描ける文字列か
+    bool CanDrawAsGlyphRun(HDC hdc, const std::wstring& text);
+
+    std::unordered_map<unsigned long long, Entry> m_entries;
+    std::vector<WORD> m_glyphIndices; // CanDrawAsGlyphRun の作業領域
+    unsigned int m_generation;
+    unsigned int m_metricsGeneration;
+    int m_textHeight;
+    int m_ellipsisWidth;
+    TabEllipsisMode m_ellipsisMode;
+    unsigned long long m_hits;
+    unsigned long long m_misses;
+};
@@ -0,0 +1,263 @@
+﻿#include "TabThumbnailCache.h"
+#include <algorithm>
+
+// 素早くホバーを移したときに古い依頼が溜まらないよう、新しいものだけ残す
+#define THUMBNAIL_MAX_PENDING 4
+#define THUMBNAIL_DEFAULT_BUDGET (8 * 1024 * 1024)
+
+TabThumbnailCache::TabThumbnailCache()
+    : m_usedBytes(0), m_budget(THUMBNAIL_DEFAULT_BUDGET), m_hNotifyWnd(NULL), m_notifyMessage(0),
+    m_provider(nullptr), m_generation(0), m_maxWidth(0), m_maxHeight(0), m_isStopping(false) {
+}
+
+TabThumbnailCache::~TabThumbnailCache() {
+    Stop();
+}
+
+void TabThumbnailCache::SetProvider(ITabThumbnailProvider* provider) {
+    Stop();
+    Clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_provider = provider;
+}
+
+ITabThumbnailProvider* TabThumbnailCache::GetProvider() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_provider;
+}
+
+void TabThumbnailCache::SetNotifyWindow(HWND hWnd, UINT message) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hNotifyWnd = hWnd;
+    m_notifyMessage = message;
+}
+
+void TabThumbnailCache::SetMaxSize(int width, int height) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (width == m_maxWidth && height == m_maxHeight) {
+            return;
+        }
+        m_maxWidth = width;
+        m_maxHeight = height;
+    }
+    Clear();
+}
+
+void TabThumbnailCache::SetBudget(size_t bytes) {
+    m_budget = bytes;
+    Evict();
+}
+
+size_t TabThumbnailCache::GetBudget() const {
+    return m_budget;
+}
+
+size_t TabThumbnailCache::GetUsedBytes() const {
+    return m_usedBytes;
+}
+
+const TabThumbnailImage* TabThumbnailCache::Request(unsigned long long key) {
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return &it->second->image;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_provider) {
+        return nullptr;
+    }
+    auto pending = std::find(m_pending.begin(), m_pending.end(), key);
+    if (pending != m_pending.end()) {
+        m_pending.erase(pending);
+    }
+    m_pending.push_front(key);
+    if (m_pending.size() > THUMBNAIL_MAX_PENDING) {
+        m_pending.pop_back();
+    }
+    if (!m_thread.joinable()) {
+        m_isStopping = false;
+        m_thread = std::thread(&TabThumbnailCache::WorkerMain, this);
+    }
+    m_condition.notify_one();
+    return nullptr;
+}
+
+const TabThumbnailImage* TabThumbnailCache::Find(unsigned long long key) const {
+    auto it = m_entries.find(key);
+    return it != m_entries.end() ? &it->second->image : nullptr;
+}
+
+void TabThumbnailCache::Invalidate(unsigned long long key) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+    m_usedBytes -= GetImageBytes(it->second->image);
+    m_lru.erase(it->second);
+    m_entries.erase(it);
+}
+
+void TabThumbnailCache::Clear() {
+    m_lru.clear();
+    m_entries.clear();
+    m_usedBytes = 0;
+    // 実行中の取得の結果も古い世代として捨てる
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.clear();
+    m_results.clear();
+    m_generation++;
+}
+
+void TabThumbnailCache::CollectResults() {
+    std::vector<Result> results;
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+        generation = m_generation;
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].generation == generation) {
+            Insert(results[i].key, results[i].image);
+        }
+    }
+}
+
+void TabThumbnailCache::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+        m_pending.clear();
+    }
+    m_condition.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void TabThumbnailCache::WorkerMain() {
+    TabThumbnailImage source;
+    for (;;) {
+        unsigned long long key;
+        unsigned int generation;
+        int maxWidth;
+        int maxHeight;
+        ITabThumbnailProvider* provider;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_isStopping || !m_pending.empty(); });
+            if (m_isStopping) {
+                return;
+            }
+            key = m_pending.front();
+            m_pending.pop_front();
+            generation = m_generation;
+            maxWidth = m_maxWidth;
+            maxHeight = m_maxHeight;
+            provider = m_provider;
+        }
+
+        source.width = 0;
+        source.height = 0;
+        source.pixels.clear();
+        if (!provider || !provider->GetTabThumbnail(key, source) ||
+            source.width <= 0 || source.height <= 0 || source.pixels.size() < (size_t)source.width * source.height) {
+            continue;
+        }
+        Result result;
+        result.key = key;
+        result.generation = generation;
+        Scale(source, maxWidth, maxHeight, result.image);
+
+        HWND hNotifyWnd;
+        UINT message;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (generation != m_generation) {
+                continue;
+            }
+            m_results.push_back(std::move(result));
+            hNotifyWnd = m_hNotifyWnd;
+            message = m_notifyMessage;
+        }
+        if (hNotifyWnd) {
+            PostMessageW(hNotifyWnd, message, 0, 0);
+        }
+    }
+}
+
+void TabThumbnailCache::Scale(const TabThumbnailImage& source, int maxWidth, int maxHeight, TabThumbnailImage& result) {
+    // 縦横比を保って収まる大きさにする。拡大はしない
+    int width = source.width;
+    int height = source.height;
+    if (maxWidth > 0 && maxHeight > 0 && (width > maxWidth || height > maxHeight)) {
+        if ((long long)width * maxHeight > (long long)height * maxWidth) {
+            height = std::max(1, (int)((long long)height * maxWidth / width));
+            width = maxWidth;
+        }
+        else {
+            width = std::max(1, (int)((long long)width * maxHeight / height));
+            height = maxHeight;
+        }
+    }
+    result.width = width;
+    result.height = height;
+    result.pixels.resize((size_t)width * height);
+    if (width == source.width && height == source.height) {
+        std::copy(source.pixels.begin(), source.pixels.begin() + (size_t)width * height, result.pixels.begin());
+        return;
+    }
+
+    // 出力 1 画素に対応する元画像の矩形を平均する
+    for (int y = 0; y < height; ++y) {
+        int sy0 = (int)((long long)y * source.height / height);
+        int sy1 = std::max(sy0 + 1, (int)((long long)(y + 1) * source.height / height));
+        for (int x = 0; x < width; ++x) {
+            int sx0 = (int)((long long)x * source.width / width);
+            int sx1 = std::max(sx0 + 1, (int)((long long)(x + 1) * source.width / width));
+            unsigned long long sum[4] = { 0, 0, 0, 0 };
+            for (int sy = sy0; sy < sy1; ++sy) {
+                const DWORD* row = &source.pixels[(size_t)sy * source.width];
+                for (int sx = sx0; sx < sx1; ++sx) {
+                    DWORD pixel = row[sx];
+                    sum[0] += pixel & 0xFF;
+                    sum[1] += (pixel >> 8) & 0xFF;
+                    sum[2] += (pixel >> 16) & 0xFF;
+                    sum[3] += pixel >> 24;
+                }
+            }
+            unsigned long long count = (unsigned long long)(sy1 - sy0) * (sx1 - sx0);
+            result.pixels[(size_t)y * width + x] = (DWORD)((sum[0] / count) | ((sum[1] / count) << 8) |
+                ((sum[2] / count) << 16) | ((sum[3] / count) << 24));
+        }
+    }
+}
+
+size_t TabThumbnailCache::GetImageBytes(const TabThumbnailImage& image) {
+    return image.pixels.size() * sizeof(DWORD);
+}
+
+void TabThumbnailCache::Insert(unsigned long long key, TabThumbnailImage& image) {
+    Invalidate(key);
+    CacheEntry entry;
+    entry.key = key;
+    entry.image.width = image.width;
+    entry.image.height = image.height;
+    entry.image.pixels.swap(image.pixels);
+    m_usedBytes += GetImageBytes(entry.image);
+    m_lru.push_front(std::move(entry));
+    m_entries[key] = m_lru.begin();
+    Evict();
+}
+
+void TabThumbnailCache::Evict() {
+    // 上限を超えたら古いものから捨てる。ただし直前に入れた 1 枚は残す
+    while (m_usedBytes > m_budget && m_lru.size() > 1) {
+        CacheEntry& entry = m_lru.back();
+        m_usedBytes -= GetImageBytes(entry.image);
+        m_entries.erase(entry.key);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 32bpp (BGRA) の上から下へ並んだ画像
+struct TabThumbnailImage {
+    int width;
+    int height;
+    std::vector<DWORD> pixels;
+};
+
+// ホバー時のポップアップに出すサムネイルを提供するインターフェース。
+// ワーカースレッドから呼ばれるので、スレッドセーフに実装すること。
+// key はタブの ID (仮想モードではインデックスの最上位ビットを立てた値)
+class ITabThumbnailProvider {
+public:
+    virtual ~ITabThumbnailProvider() {}
+    virtual bool GetTabThumbnail(unsigned long long key, TabThumbnailImage& image) = 0;
+};
+
+// サムネイルの取得と縮小をワーカースレッドで行い、完成した画像を
+// バイト数の上限つきの LRU で持つ。UI スレッドは出来上がった画像を転送するだけ。
+// 画像ができると通知先のウィンドウに message を PostMessage する
+class TabThumbnailCache {
+public:
+    TabThumbnailCache();
+    ~TabThumbnailCache();
+
+    // プロバイダを替えるときは実行中の取得が終わるのを待つ
+    void SetProvider(ITabThumbnailProvider* provider);
+    ITabThumbnailProvider* GetProvider() const;
+    void SetNotifyWindow(HWND hWnd, UINT message);
+    // 縮小後の最大サイズ。変わるとキャッシュを捨てる
+    void SetMaxSize(int width, int height);
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const;
+    size_t GetUsedBytes() const;
+
+    // キャッシュにあれば最近使ったものとして返す。なければ取得を依頼して nullptr
+    const TabThumbnailImage* Request(unsigned long long key);
+    // 順序を変えずに探す (描画用)
+    const TabThumbnailImage* Find(unsigned long long key) const;
+    void Invalidate(unsigned long long key);
+    void Clear();
+    // 通知を受けたら UI スレッドで呼ぶ。完成した画像をキャッシュに移す
+    void CollectResults();
+    void Stop();
+
+private:
+    struct CacheEntry {
+        unsigned long long key;
+        TabThumbnailImage image;
+    };
+    struct Result {
+        unsigned long long key;
+        unsigned int generation;
+        TabThumbnailImage image;
+    };
+
+    void WorkerMain();
+    static void Scale(const TabThumbnailImage& source, int maxWidth, int maxHeight, TabThumbnailImage& result);
+    static size_t GetImageBytes(const TabThumbnailImage& image);
+    void Insert(unsigned long long key, TabThumbnailImage& image);
+    void Evict();
+
+    // UI スレッドだけが触る
+    std::list<CacheEntry> m_lru; // 先頭が最近使ったもの
+    std::unordered_map<unsigned long long, std::list<CacheEntry>::iterator> m_entries;
+    size_t m_usedBytes;
+    size_t m_budget;
+    HWND m_hNotifyWnd;
+    UINT m_notifyMessage;
+
+    // ワーカースレッドと共有する
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<unsigned long long> m_pending; // 先頭が最新の依頼
+    std::vector<Result> m_results;
+    ITabThumbnailProvider* m_provider;
+    unsigned int m_generation;
+    int m_maxWidth;
+    int m_maxHeight;
+    bool m_isStopping;
+    std::thread m_thread;
+};
@@ -0,0 +1,109 @@
+﻿#include "TabUpdateQueue.h"
+
+TabUpdateQueue::TabUpdateQueue()
+    : m_head(nullptr), m_hNotifyWnd(NULL), m_notifyMessage(0), m_pushCount(0), m_coalescedCount(0) {
+}
+
+TabUpdateQueue::~TabUpdateQueue() {
+    Node* node = m_head.exchange(nullptr);
+    while (node) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+void TabUpdateQueue::SetNotifyWindow(HWND hWnd, UINT message) {
+    m_notifyMessage = message;
+    m_hNotifyWnd = hWnd;
+}
+
+void TabUpdateQueue::Push(TabUpdate&& update) {
+    Node* node = new Node{ std::move(update), nullptr };
+    Node* head = m_head.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!m_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    m_pushCount.fetch_add(1, std::memory_order_relaxed);
+
+    // 空だったときだけ起こす。以降は取り出されるまで積むだけ
+    if (!head) {
+        HWND hWnd = m_hNotifyWnd;
+        if (hWnd) {
+            PostMessageW(hWnd, m_notifyMessage, 0, 0);
+        }
+    }
+}
+
+void TabUpdateQueue::Drain(std::vector<TabUpdate>& updates) {
+    updates.clear();
+    Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+    if (!node) {
+        return;
+    }
+    // 新しい順につながっているので、逆にして積まれた順にする
+    Node* ordered = nullptr;
+    while (node) {
+        Node* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+
+    m_isDropped.clear();
+    for (int type = 0; type <= TAB_UPDATE_ADORNMENT; ++type) {
+        m_latest[type].clear();
+    }
+    while (ordered) {
+        TabUpdate& update = ordered->update;
+        if (update.type >= TAB_UPDATE_RENAME) {
+            std::unordered_map<unsigned long long, size_t>::iterator it = m_latest[update.type].find(update.id);
+            if (it != m_latest[update.type].end()) {
+                // 後から来たものが勝つ。位置は最初のもののまま
+                updates[it->second] = std::move(update);
+                m_coalescedCount++;
+            }
+            else {
+                m_latest[update.type][update.id] = updates.size();
+                updates.push_back(std::move(update));
+                m_isDropped.push_back(false);
+            }
+        }
+        else {
+            if (update.type == TAB_UPDATE_REMOVE) {
+                for (int type = TAB_UPDATE_RENAME; type <= TAB_UPDATE_ADORNMENT; ++type) {
+                    std::unordered_map<unsigned long long, size_t>::iterator it = m_latest[type].find(update.id);
+                    if (it != m_latest[type].end()) {
+                        m_isDropped[it->second] = true;
+                        m_latest[type].erase(it);
+                        m_coalescedCount++;
+                    }
+                }
+            }
+            updates.push_back(std::move(update));
+            m_isDropped.push_back(false);
+        }
+        Node* next = ordered->next;
+        delete ordered;
+        ordered = next;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < updates.size(); ++i) {
+        if (!m_isDropped[i]) {
+            if (count != i) {
+                updates[count] = std::move(updates[i]);
+            }
+            count++;
+        }
+    }
+    updates.resize(count);
+}
+
+unsigned long long TabUpdateQueue::GetPushCount() const {
+    return m_pushCount.load(std::memory_order_relaxed);
+}
+
+unsigned long long TabUpdateQueue::GetCoalescedCount() const {
+    return m_coalescedCount;
+}
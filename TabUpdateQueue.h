@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TabAdornments.h"
+
+enum TabUpdateType {
+    TAB_UPDATE_ADD,
+    TAB_UPDATE_REMOVE,
+    TAB_UPDATE_RENAME,
+    TAB_UPDATE_USER_DATA,
+    TAB_UPDATE_ADORNMENT,
+};
+
+// ワーカースレッドから送るタブの変更。ID で対象を指す (追加は積むときに取っておいた ID)
+struct TabUpdate {
+    TabUpdateType type;
+    unsigned long long id;
+    std::wstring title;
+    std::intptr_t userData;
+    TabAdornment adornment;
+};
+
+// 複数のワーカースレッドから積み、UI スレッドがフレームごとにまとめて取り出すキュー。
+// 積む側はロックを取らず、先頭ポインタの CAS だけで済む。
+// 空のキューに積んだときだけ通知先のウィンドウに message を PostMessage するので、
+// 何万件積んでもメッセージは取り出し 1 回につき 1 つ
+class TabUpdateQueue {
+public:
+    TabUpdateQueue();
+    ~TabUpdateQueue();
+
+    // 通知先の設定は UI スレッドから
+    void SetNotifyWindow(HWND hWnd, UINT message);
+    // どのスレッドから呼んでもよい
+    void Push(TabUpdate&& update);
+    // UI スレッドから。積まれた順に取り出し、同じタブへの同じ種類の変更は
+    // 最後のものだけを残す。削除されるタブへのそれより前の変更は捨てる
+    void Drain(std::vector<TabUpdate>& updates);
+
+    unsigned long long GetPushCount() const;
+    unsigned long long GetCoalescedCount() const;
+
+private:
+    struct Node {
+        TabUpdate update;
+        Node* next;
+    };
+
+    std::atomic<Node*> m_head; // 最後に積んだもの。次は 1 つ前に積んだもの
+    std::atomic<HWND> m_hNotifyWnd;
+    std::atomic<UINT> m_notifyMessage;
+    std::atomic<unsigned long long> m_pushCount;
+
+    // UI スレッドだけが触る
+    std::unordered_map<unsigned long long, size_t> m_latest[TAB_UPDATE_ADORNMENT + 1];
+    std::vector<bool> m_isDropped;
+    unsigned long long m_coalescedCount;
+};
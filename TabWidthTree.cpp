@@ -0,0 +1,329 @@
+﻿#include "TabWidthTree.h"
+#include <algorithm>
+
+TabWidthTree::TabWidthTree()
+    : m_root(-1), m_seed(2463534242u) {
+}
+
+void TabWidthTree::Assign(const std::vector<int>& widths) {
+    Clear();
+    m_root = Build(widths.data(), (int)widths.size());
+}
+
+void TabWidthTree::Clear() {
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_root = -1;
+}
+
+void TabWidthTree::PushBack(int width) {
+    Insert(Size(), width);
+}
+
+void TabWidthTree::Insert(int index, int width) {
+    InsertRange(index, &width, 1);
+}
+
+void TabWidthTree::Erase(int index) {
+    EraseRange(index, 1);
+}
+
+void TabWidthTree::InsertRange(int index, const int* widths, int count) {
+    if (count <= 0) {
+        return;
+    }
+    index = std::min(std::max(index, 0), Size());
+    int inserted = Build(widths, count);
+    int first, rest;
+    Split(m_root, index, &first, &rest);
+    m_root = Merge(Merge(first, inserted), rest);
+}
+
+void TabWidthTree::EraseRange(int index, int count) {
+    int n = Size();
+    if (index < 0 || index >= n || count <= 0) {
+        return;
+    }
+    count = std::min(count, n - index);
+    int first, rest, erased;
+    Split(m_root, index, &first, &rest);
+    Split(rest, count, &erased, &rest);
+    FreeTree(erased);
+    m_root = Merge(first, rest);
+}
+
+void TabWidthTree::Move(int from, int to) {
+    int n = Size();
+    if (from == to || from < 0 || to < 0 || from >= n || to >= n) {
+        return;
+    }
+    // from のノードを抜き出し、残りの to の位置に差し込む
+    int first, rest, moved;
+    Split(m_root, from, &first, &rest);
+    Split(rest, 1, &moved, &rest);
+    m_root = Merge(first, rest);
+    Split(m_root, to, &first, &rest);
+    m_root = Merge(Merge(first, moved), rest);
+}
+
+void TabWidthTree::Set(int index, int width) {
+    if (index < 0 || index >= Size()) {
+        return;
+    }
+    int delta = width - Get(index);
+    if (delta == 0) {
+        return;
+    }
+    // 根から index のノードまでの部分木の合計はすべて delta だけ変わる
+    int node = m_root;
+    while (node != -1) {
+        Node& current = m_nodes[node];
+        current.sum += delta;
+        int leftSize = SizeOf(current.left);
+        if (index < leftSize) {
+            node = current.left;
+        }
+        else if (index == leftSize) {
+            current.width = width;
+            return;
+        }
+        else {
+            index -= leftSize + 1;
+            node = current.right;
+        }
+    }
+}
+
+int TabWidthTree::Get(int index) const {
+    if (index < 0 || index >= Size()) {
+        return 0;
+    }
+    int node = m_root;
+    while (node != -1) {
+        const Node& current = m_nodes[node];
+        int leftSize = SizeOf(current.left);
+        if (index < leftSize) {
+            node = current.left;
+        }
+        else if (index == leftSize) {
+            return current.width;
+        }
+        else {
+            index -= leftSize + 1;
+            node = current.right;
+        }
+    }
+    return 0;
+}
+
+void TabWidthTree::GetRange(int index, int count, int* widths) const {
+    if (index < 0 || count <= 0 || index + count > Size()) {
+        return;
+    }
+    // index のノードまで降り、左へ進んだノード (後に来るもの) をスタックに積んでおく。
+    // あとは通りがけ順にたどる
+    std::vector<int>& stack = m_stack;
+    stack.clear();
+    int node = m_root;
+    while (node != -1) {
+        int leftSize = SizeOf(m_nodes[node].left);
+        if (index < leftSize) {
+            stack.push_back(node);
+            node = m_nodes[node].left;
+        }
+        else if (index == leftSize) {
+            stack.push_back(node);
+            break;
+        }
+        else {
+            index -= leftSize + 1;
+            node = m_nodes[node].right;
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        node = stack.back();
+        stack.pop_back();
+        widths[i] = m_nodes[node].width;
+        for (node = m_nodes[node].right; node != -1; node = m_nodes[node].left) {
+            stack.push_back(node);
+        }
+    }
+}
+
+void TabWidthTree::SetRange(int index, const int* widths, int count) {
+    if (index < 0 || count <= 0 || index + count > Size()) {
+        return;
+    }
+    // 範囲の木を丸ごと作り直して差し替える
+    int first, rest, replaced;
+    Split(m_root, index, &first, &rest);
+    Split(rest, count, &replaced, &rest);
+    FreeTree(replaced);
+    m_root = Merge(Merge(first, Build(widths, count)), rest);
+}
+
+int TabWidthTree::Size() const {
+    return SizeOf(m_root);
+}
+
+int TabWidthTree::Total() const {
+    return SumOf(m_root);
+}
+
+int TabWidthTree::PrefixSum(int count) const {
+    int sum = 0;
+    int node = m_root;
+    while (node != -1 && count > 0) {
+        const Node& current = m_nodes[node];
+        int leftSize = SizeOf(current.left);
+        if (count <= leftSize) {
+            node = current.left;
+        }
+        else {
+            sum += SumOf(current.left) + current.width;
+            count -= leftSize + 1;
+            node = current.right;
+        }
+    }
+    return sum;
+}
+
+int TabWidthTree::FindIndex(int offset) const {
+    if (offset < 0 || offset >= Total()) {
+        return -1;
+    }
+    // 幅 0 のタブは飛ばして、offset を含む幅のあるタブまで降りる
+    int index = 0;
+    int node = m_root;
+    while (node != -1) {
+        const Node& current = m_nodes[node];
+        int leftSum = SumOf(current.left);
+        if (offset < leftSum) {
+            node = current.left;
+        }
+        else if (offset < leftSum + current.width) {
+            return index + SizeOf(current.left);
+        }
+        else {
+            offset -= leftSum + current.width;
+            index += SizeOf(current.left) + 1;
+            node = current.right;
+        }
+    }
+    return -1;
+}
+
+int TabWidthTree::NewNode(int width) {
+    // xorshift32
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    Node node = { -1, -1, 1, width, width, m_seed };
+    if (!m_freeNodes.empty()) {
+        int index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+        m_nodes[index] = node;
+        return index;
+    }
+    m_nodes.push_back(node);
+    return (int)m_nodes.size() - 1;
+}
+
+int TabWidthTree::SizeOf(int node) const {
+    return node == -1 ? 0 : m_nodes[node].size;
+}
+
+int TabWidthTree::SumOf(int node) const {
+    return node == -1 ? 0 : m_nodes[node].sum;
+}
+
+void TabWidthTree::Update(int node) {
+    Node& current = m_nodes[node];
+    current.size = SizeOf(current.left) + 1 + SizeOf(current.right);
+    current.sum = SumOf(current.left) + current.width + SumOf(current.right);
+}
+
+void TabWidthTree::Split(int node, int count, int* first, int* rest) {
+    if (node == -1) {
+        *first = -1;
+        *rest = -1;
+        return;
+    }
+    int leftSize = SizeOf(m_nodes[node].left);
+    if (count <= leftSize) {
+        int left;
+        Split(m_nodes[node].left, count, first, &left);
+        m_nodes[node].left = left;
+        *rest = node;
+    }
+    else {
+        int right;
+        Split(m_nodes[node].right, count - leftSize - 1, &right, rest);
+        m_nodes[node].right = right;
+        *first = node;
+    }
+    Update(node);
+}
+
+int TabWidthTree::Merge(int first, int rest) {
+    if (first == -1) {
+        return rest;
+    }
+    if (rest == -1) {
+        return first;
+    }
+    if (m_nodes[first].priority > m_nodes[rest].priority) {
+        int right = Merge(m_nodes[first].right, rest);
+        m_nodes[first].right = right;
+        Update(first);
+        return first;
+    }
+    int left = Merge(first, m_nodes[rest].left);
+    m_nodes[rest].left = left;
+    Update(rest);
+    return rest;
+}
+
+int TabWidthTree::Build(const int* widths, int count) {
+    // 右端の枝をスタックに持ちながら左から順に足していく (Cartesian tree の作り方)。
+    // スタックから外れたノードは部分木が確定しているので、そこで合計を求める
+    m_stack.clear();
+    for (int i = 0; i < count; ++i) {
+        int node = NewNode(widths[i]);
+        int last = -1;
+        while (!m_stack.empty() && m_nodes[m_stack.back()].priority < m_nodes[node].priority) {
+            last = m_stack.back();
+            m_stack.pop_back();
+            Update(last);
+        }
+        m_nodes[node].left = last;
+        if (!m_stack.empty()) {
+            m_nodes[m_stack.back()].right = node;
+        }
+        m_stack.push_back(node);
+    }
+    int root = m_stack.empty() ? -1 : m_stack.front();
+    while (!m_stack.empty()) {
+        Update(m_stack.back());
+        m_stack.pop_back();
+    }
+    return root;
+}
+
+void TabWidthTree::FreeTree(int node) {
+    m_stack.clear();
+    if (node != -1) {
+        m_stack.push_back(node);
+    }
+    while (!m_stack.empty()) {
+        int current = m_stack.back();
+        m_stack.pop_back();
+        if (m_nodes[current].left != -1) {
+            m_stack.push_back(m_nodes[current].left);
+        }
+        if (m_nodes[current].right != -1) {
+            m_stack.push_back(m_nodes[current].right);
+        }
+        m_freeNodes.push_back(current);
+    }
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <vector>
+
+// タブ幅の暗黙の treap (並び順を鍵にした、乱数の優先度でつり合いを取る二分木)。
+// 各ノードが部分木のタブ数と幅の合計を持つので、この木の上では累積幅・x 座標からのタブ検索・
+// 1 つの挿入・削除・移動・幅の変更はどれも O(log n)、複数の追加・削除は O(count + log n)。
+// ただしタブの追加・削除・移動全体の計算量は TabLayoutEngine の m_tabs と ID の表で決まり、
+// 途中への挿入・削除・移動は O(n) のまま (TabLayoutEngine.h を参照)。
+// ノードは配列に置き、削除したものは使い回す。
+// 幅は 0 以上であること (FindIndex の降下が前提としている)。
+class TabWidthTree {
+public:
+    TabWidthTree();
+
+    void Assign(const std::vector<int>& widths);
+    void Clear();
+    void PushBack(int width);
+    void Insert(int index, int width);
+    void Erase(int index);
+    void InsertRange(int index, const int* widths, int count);
+    void EraseRange(int index, int count);
+    void Move(int from, int to);
+    void Set(int index, int width);
+
+    int Get(int index) const;
+    // 並んだ幅を O(count + log n) でまとめて読み書きする (Get や Set を count 回呼ぶと O(count log n))
+    void GetRange(int index, int count, int* widths) const;
+    void SetRange(int index, const int* widths, int count);
+    int Size() const;
+    int Total() const;
+    // [0, count) の幅の合計
+    int PrefixSum(int count) const;
+    // PrefixSum(i) <= offset < PrefixSum(i + 1) となる i。範囲外なら -1
+    int FindIndex(int offset) const;
+
+private:
+    struct Node {
+        int left;  // なければ -1
+        int right;
+        int size;  // 部分木のタブ数
+        int width;
+        int sum;   // 部分木の幅の合計
+        unsigned int priority; // 親は子より大きい
+    };
+
+    int NewNode(int width);
+    int SizeOf(int node) const;
+    int SumOf(int node) const;
+    void Update(int node);
+    // node の木を先頭 count 個の木 *first と残りの木 *rest に分ける
+    void Split(int node, int count, int* first, int* rest);
+    int Merge(int first, int rest);
+    // 並びどおりの木を O(count) で作る
+    int Build(const int* widths, int count);
+    void FreeTree(int node);
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_freeNodes;
+    mutable std::vector<int> m_stack; // Build・FreeTree・GetRange の作業領域
+    int m_root;
+    unsigned int m_seed;
+};